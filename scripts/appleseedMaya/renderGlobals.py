@@ -744,6 +744,57 @@ class AppleseedRenderGlobalsMainTab(AppleseedRenderGlobalsTab):
 
                         pm.separator(height=2)
 
+                with pm.frameLayout("xgenFrameLayout", label="XGen Level of Detail", collapsable=True, collapse=True):
+                    with pm.columnLayout("xgenColumnLayout", adjustableColumn=True, width=g_subColumnWidth,
+                                         rowSpacing=2):
+
+                        pm.separator(height=2)
+
+                        self._addControl(
+                            ui=pm.checkBoxGrp(
+                                label="Frustum Culling",
+                                columnAttach=(1, "right", 4),
+                                height=18),
+                            attrName="xgenFrustumCulling")
+
+                        self._addFieldSliderControl(
+                            label="Frustum Margin",
+                            sliderStep=0.01,
+                            precision=2,
+                            columnWidth=(3, 160),
+                            columnAttach=(1, "right", 4),
+                            minValue=0.0,
+                            fieldMinValue=0.0,
+                            maxValue=1.0,
+                            fieldMaxValue=10.0,
+                            attrName="xgenFrustumMargin")
+
+                        self._addFieldSliderControl(
+                            label="Full Density Size In Pixels",
+                            sliderStep=1.0,
+                            precision=1,
+                            columnWidth=(3, 160),
+                            columnAttach=(1, "right", 4),
+                            minValue=0.0,
+                            fieldMinValue=0.0,
+                            maxValue=100.0,
+                            fieldMaxValue=100000.0,
+                            attrName="xgenFullDensityPixels")
+
+                        self._addFieldSliderControl(
+                            label="Minimum Density",
+                            sliderStep=0.01,
+                            precision=3,
+                            columnWidth=(3, 160),
+                            columnAttach=(1, "right", 4),
+                            minValue=0.0,
+                            fieldMinValue=0.0,
+                            maxValue=1.0,
+                            fieldMaxValue=1.0,
+                            attrName="xgenMinDensity")
+
+                        pm.separator(height=2)
+
         pm.setUITemplate("renderGlobalsTemplate", popTemplate=True)
         pm.setUITemplate("attributeEditorTemplate", popTemplate=True)
         pm.formLayout(
@@ -1549,6 +1600,20 @@ class AppleseedRenderGlobalsSystemTab(AppleseedRenderGlobalsTab):
         if path:
             mc.setAttr("appleseedRenderGlobals.logFilename", path, type="string")
 
+    def __chooseExportTraceFilename(self):
+        logger.debug("Choose export trace filename called!")
+        path = pm.fileDialog2(filemode=0, fileFilter="JSON (*.json)")
+
+        if path:
+            mc.setAttr("appleseedRenderGlobals.exportTraceFilename", path[0], type="string")
+
+    def __chooseTextureCacheDirectory(self):
+        logger.debug("Choose texture cache directory called!")
+        path = pm.fileDialog2(fileMode=3)
+
+        if path:
+            mc.setAttr("appleseedRenderGlobals.textureCacheDirectory", path[0], type="string")
+
     def create(self):
         # Create default render globals node if needed
         createGlobalNodes()
@@ -1600,6 +1665,17 @@ class AppleseedRenderGlobalsSystemTab(AppleseedRenderGlobalsTab):
 
                         pm.separator(height=2)
 
+                        self._addControl(
+                            ui=pm.textFieldButtonGrp(
+                                label="Export Trace Filename",
+                                buttonLabel="...",
+                                height=22,
+                                columnAttach=(1, "right", 4),
+                                buttonCommand=self.__chooseExportTraceFilename),
+                            attrName="exportTraceFilename")
+
+                        pm.separator(height=2)
+
                 with pm.frameLayout("systemFrameLayout", label="System", collapsable=True, collapse=False):
                     with pm.columnLayout("systemColumnLayout", adjustableColumn=True, width=g_columnWidth):
 
@@ -1619,6 +1695,22 @@ class AppleseedRenderGlobalsSystemTab(AppleseedRenderGlobalsTab):
                                 numberOfFields=1),
                             attrName="maxTexCacheSize")
 
+                        self._addControl(
+                            ui=pm.checkBoxGrp(
+                                label="Prepare Textures",
+                                columnAttach=(1, "right", 4),
+                                height=24),
+                            attrName="prepareTextures")
+
+                        self._addControl(
+                            ui=pm.textFieldButtonGrp(
+                                label="Texture Cache Directory",
+                                buttonLabel="...",
+                                height=22,
+                                columnAttach=(1, "right", 4),
+                                buttonCommand=self.__chooseTextureCacheDirectory),
+                            attrName="textureCacheDirectory")
+
                         pm.separator(height=2)
 
                 with pm.frameLayout("experimentalFrameLayout", label="Experimental", collapsable=True, collapse=False):
@@ -1631,6 +1723,13 @@ class AppleseedRenderGlobalsSystemTab(AppleseedRenderGlobalsTab):
                                 height=24),
                             attrName="useEmbree")
 
+                        self._addControl(
+                            ui=pm.checkBoxGrp(
+                                label="Incremental Batch Render",
+                                columnAttach=(1, "right", 4),
+                                height=24),
+                            attrName="incrementalBatchRender")
+
         logger.debug("Created appleseed render global diagnostics tab.")
 
         pm.setUITemplate("renderGlobalsTemplate", popTemplate=True)
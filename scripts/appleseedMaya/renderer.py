@@ -107,7 +107,10 @@ def createRenderMelProcedures():
     mel.eval('''
         global proc appleseedPauseIprRenderProcedure(string $editor, int $pause)
         {
-            appleseedProgressiveRender -action "pause";
+            if ($pause)
+                appleseedProgressiveRender -action "pause";
+            else
+                appleseedProgressiveRender -action "resume";
         }
         '''
              )
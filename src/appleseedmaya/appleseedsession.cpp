@@ -31,20 +31,28 @@
 
 // appleseed-maya headers.
 #include "appleseedmaya/attributeutils.h"
+#include "appleseedmaya/config.h"
 #include "appleseedmaya/exceptions.h"
 #include "appleseedmaya/exporters/alphamapexporter.h"
 #include "appleseedmaya/exporters/dagnodeexporter.h"
+#include "appleseedmaya/exporters/envlightexporter.h"
 #include "appleseedmaya/exporters/exporterfactory.h"
 #include "appleseedmaya/exporters/instanceexporter.h"
+#include "appleseedmaya/exporters/meshexporter.h"
 #include "appleseedmaya/exporters/shadingengineexporter.h"
 #include "appleseedmaya/exporters/shadingnetworkexporter.h"
 #include "appleseedmaya/exporters/shapeexporter.h"
+#include "appleseedmaya/exporttracer.h"
 #include "appleseedmaya/idlejobqueue.h"
 #include "appleseedmaya/logger.h"
+#include "appleseedmaya/murmurhash.h"
 #include "appleseedmaya/pythonbridge.h"
 #include "appleseedmaya/renderercontroller.h"
 #include "appleseedmaya/renderglobalsnode.h"
 #include "appleseedmaya/renderviewtilecallback.h"
+#include "appleseedmaya/shadingnoderegistry.h"
+#include "appleseedmaya/skydomelightnode.h"
+#include "appleseedmaya/texturecache.h"
 
 // Build options header.
 #include "foundation/core/buildoptions.h"
@@ -61,6 +69,7 @@
 #include "renderer/api/utility.h"
 
 // appleseed.foundation headers.
+#include "foundation/core/appleseed.h"
 #include "foundation/log/log.h"
 #include "foundation/math/scalar.h"
 #include "foundation/memory/autoreleaseptr.h"
@@ -73,17 +82,24 @@
 // Maya headers.
 #include "appleseedmaya/_beginmayaheaders.h"
 #include <maya/MAnimControl.h>
+#include <maya/MCallbackIdArray.h>
 #include <maya/MCommonRenderSettingsData.h>
+#include <maya/MDagMessage.h>
 #include <maya/MDagPath.h>
+#include <maya/MDGMessage.h>
 #include <maya/MFnDagNode.h>
 #include <maya/MFnDependencyNode.h>
 #include <maya/MFnRenderLayer.h>
 #include <maya/MGlobal.h>
 #include <maya/MItDag.h>
+#include <maya/MItDependencyGraph.h>
+#include <maya/MMessage.h>
+#include <maya/MNodeMessage.h>
 #include <maya/MSelectionList.h>
 #include <maya/MObject.h>
 #include <maya/MObjectArray.h>
 #include <maya/MRenderUtil.h>
+#include <maya/MRenderView.h>
 #include "appleseedmaya/_endmayaheaders.h"
 
 // Boost headers.
@@ -94,8 +110,12 @@
 // Standard headers.
 #include <array>
 #include <cassert>
+#include <cstdint>
+#include <cstdlib>
 #include <fstream>
 #include <memory>
+#include <set>
+#include <string>
 #include <thread>
 #include <vector>
 
@@ -115,11 +135,13 @@ Options::Options()
   , m_ymin(-1)
   , m_xmax(-1)
   , m_ymax(-1)
+  , m_incrementalBatchRender(false)
   , m_sequence(false)
   , m_firstFrame(1)
   , m_lastFrame(1)
   , m_frameStep(1)
   , m_writeBoundingBox(false)
+  , m_staticArchive(false)
 {
 }
 
@@ -217,6 +239,14 @@ namespace
     struct SessionImpl
       : public asf::NonCopyable
     {
+        typedef std::map<MString, DagNodeExporterPtr, MStringCompareLess>           DagExporterMap;
+        typedef std::map<MString, ShadingEngineExporterPtr, MStringCompareLess>     ShadingEngineExporterMap;
+        typedef std::map<MString, ShadingNetworkExporterPtr, MStringCompareLess>    ShadingNetworkExporterMap;
+        typedef std::array<ShadingNetworkExporterMap, NumShadingNetworkContexts>    ShadingNetworkExporterMapArray;
+        typedef std::map<MString, AlphaMapExporterPtr, MStringCompareLess>          AlphaMapExporterMap;
+        typedef std::map<MString, MCallbackIdArray, MStringCompareLess>             CallbackIdMap;
+        typedef std::set<MString, MStringCompareLess>                               NameSet;
+
         class ExporterFactory
           : public AppleseedSession::IExporterFactory
         {
@@ -242,6 +272,11 @@ namespace
                         *m_self.mainAssembly(),
                         m_self.m_sessionMode));
                 m_self.m_shadingEngineExporters[depNodeFn.name()] = exporter;
+
+                // Exporters created while applying scene edits or updating
+                // the animated nodes of a sequence are not flushed yet.
+                m_self.m_newShadingEngineExporters[depNodeFn.name()] = exporter;
+
                 return exporter;
             }
 
@@ -265,6 +300,9 @@ namespace
                         *m_self.mainAssembly(),
                         m_self.m_sessionMode));
                 m_self.m_shadingNetworkExporters[context][depNodeFn.name()] = exporter;
+
+                m_self.m_newShadingNetworkExporters[context][depNodeFn.name()] = exporter;
+
                 return exporter;
             }
 
@@ -285,8 +323,12 @@ namespace
                         m_self.m_sessionMode));
 
                 if (exporter)
+                {
                     m_self.m_alphaMapExporters[depNodeFn.name()] = exporter;
 
+                    m_self.m_newAlphaMapExporters[depNodeFn.name()] = exporter;
+                }
+
                 return exporter;
             }
 
@@ -302,6 +344,10 @@ namespace
           , m_options(options)
           , m_computation(computation)
           , m_exporter_factory(*this)
+          , m_paused(false)
+          , m_updateScheduled(false)
+          , m_needsRestart(false)
+          , m_dagHierarchyChanged(false)
         {
             createProject();
         }
@@ -316,6 +362,10 @@ namespace
           , m_computation(computation)
           , m_exporter_factory(*this)
           , m_fileName(fileName)
+          , m_paused(false)
+          , m_updateScheduled(false)
+          , m_needsRestart(false)
+          , m_dagHierarchyChanged(false)
         {
             m_projectPath = bfs::path(fileName.asChar()).parent_path();
 
@@ -339,6 +389,7 @@ namespace
 
         ~SessionImpl()
         {
+            removeProgressiveRenderCallbacks();
             PythonBridge::clearCurrentProject();
             abortRender();
         }
@@ -413,6 +464,9 @@ namespace
 
         void exportProject()
         {
+            ScopedExportTrace trace(exportTraceFilename());
+            ScopedTraceEvent event("exportProject");
+
             exportDefaultRenderGlobals();
             MObject globalsNode = exportAppleseedRenderGlobals();
 
@@ -425,21 +479,7 @@ namespace
                 motionBlurSampleTimes.initializeToCurrentFrame();
 
             exportScene(motionBlurSampleTimes);
-
-            // Set the shutter open and close times in all cameras.
-            asr::CameraContainer& cameras = m_project->get_scene()->cameras();
-
-            const float shutterOpenTime = motionBlurSampleTimes.normalizedFrame(motionBlurSampleTimes.m_shutterOpenTime);
-            const float shutterCloseTime = motionBlurSampleTimes.normalizedFrame(motionBlurSampleTimes.m_shutterCloseTime);
-
-            for (size_t i = 0, e = cameras.size(); i < e; ++i)
-            {
-                cameras.get_by_index(i)->get_parameters()
-                    .insert("shutter_open_begin_time", shutterOpenTime)
-                    .insert("shutter_open_end_time", shutterOpenTime)
-                    .insert("shutter_close_begin_time", shutterCloseTime)
-                    .insert("shutter_close_end_time", shutterCloseTime);
-            }
+            setCamerasShutterTimes(motionBlurSampleTimes);
 
             asr::ParamArray params = m_project->get_frame()->get_parameters();
 
@@ -505,32 +545,7 @@ namespace
                 }
             }
 
-            MFnDependencyNode fnDepNode(globalsNode);
-
-            // Apply the scene scale factor.
-            float sceneScale;
-            if (AttributeUtils::get(fnDepNode, "sceneScale", sceneScale))
-            {
-                if (sceneScale != 1.0f)
-                {
-                    asr::TransformSequence scaleTransformSeq;
-                    scaleTransformSeq.set_transform(0.0, asf::Transformd::from_local_to_parent(
-                        asf::Matrix4d::make_scaling(asf::Vector3d(sceneScale))));
-
-                    // Scale the main assembly instance.
-                    asr::Scene* scene = m_project->get_scene();
-                    asr::AssemblyInstance* assemblyInstance =
-                        scene->assembly_instances().get_by_name("assembly_inst");
-                    assemblyInstance->transform_sequence() = scaleTransformSeq;
-
-                    // Apply the scale to all cameras.
-                    for (size_t i = 0, e = scene->cameras().size(); i < e; ++i)
-                    {
-                        asr::Camera* camera = scene->cameras().get_by_index(i);
-                        camera->transform_sequence() = camera->transform_sequence() * scaleTransformSeq;
-                    }
-                }
-            }
+            applySceneScale(globalsNode);
 
             // Set the resolution.
             params.insert("resolution", asf::Vector2i(m_options.m_width, m_options.m_height));
@@ -549,6 +564,173 @@ namespace
             }
         }
 
+        void updateProject()
+        {
+            // Export again only what can change from one frame to the next.
+            // The frame, AOVs and post processing stages are kept as they are.
+            ScopedExportTrace trace(exportTraceFilename());
+            ScopedTraceEvent event("updateProject");
+
+            AppleseedSession::MotionBlurSampleTimes motionBlurSampleTimes;
+
+            MObject globalsNode;
+            if (getDependencyNodeByName("appleseedRenderGlobals", globalsNode))
+            {
+                // The frame keeps its own copy of the AOVs,
+                // the session's set is only refreshed here.
+                m_aovs.clear();
+                RenderGlobalsNode::applyGlobalsToProject(
+                    globalsNode,
+                    m_sessionMode,
+                    *m_project,
+                    m_aovs);
+
+                RenderGlobalsNode::collectMotionBlurSampleTimes(globalsNode, motionBlurSampleTimes);
+            }
+            else
+                motionBlurSampleTimes.initializeToCurrentFrame();
+
+            updateScene(motionBlurSampleTimes);
+            setCamerasShutterTimes(motionBlurSampleTimes);
+            applySceneScale(globalsNode);
+        }
+
+        void writeStaticArchive()
+        {
+            assert(m_sessionMode == AppleseedSession::ExportSession);
+
+            // Write everything but the animated dag nodes to the archive.
+            DagExporterMap dagExporters;
+            removeTimeDependentDagNodes(dagExporters);
+            writeProject();
+
+            // The static dag nodes are now in the archive, remove them
+            // from the main assembly. Environment lights live in the scene
+            // and are kept.
+            for (auto it = m_dagExporters.begin(), e = m_dagExporters.end(); it != e; ++it)
+            {
+                if (dynamic_cast<EnvLightExporter*>(it->second.get()) == nullptr)
+                    it->second->removeEntities();
+            }
+
+            // Reference the archive from the scene.
+            const std::string archiveName = bfs::path(m_fileName.asChar()).filename().string();
+            RENDERER_LOG_DEBUG("Referencing static archive %s", archiveName.c_str());
+
+            const asr::AssemblyFactoryRegistrar& assemblyFactories =
+                m_project->get_factory_registrar<asr::Assembly>();
+
+            const auto factory = assemblyFactories.lookup("archive_assembly");
+            assert(factory);
+
+            asr::Scene* scene = m_project->get_scene();
+            scene->assemblies().insert(
+                factory->create(
+                    "static_archive",
+                    asr::ParamArray().insert("filename", archiveName.c_str())));
+            scene->assembly_instances().insert(
+                asr::AssemblyInstanceFactory::create(
+                    "static_archive_inst",
+                    asr::ParamArray(),
+                    "static_archive"));
+
+            // Export the animated dag nodes for the current frame.
+            AppleseedSession::MotionBlurSampleTimes motionBlurSampleTimes;
+
+            MObject globalsNode;
+            if (getDependencyNodeByName("appleseedRenderGlobals", globalsNode))
+                RenderGlobalsNode::collectMotionBlurSampleTimes(globalsNode, motionBlurSampleTimes);
+            else
+                motionBlurSampleTimes.initializeToCurrentFrame();
+
+            exportTimeDependentDagNodes(dagExporters, motionBlurSampleTimes);
+            setCamerasShutterTimes(motionBlurSampleTimes);
+            applySceneScale(globalsNode);
+        }
+
+        std::string exportTraceFilename() const
+        {
+            MString globalsFilename;
+            MObject globalsNode;
+            if (getDependencyNodeByName("appleseedRenderGlobals", globalsNode))
+                globalsFilename = RenderGlobalsNode::exportTraceFilename(globalsNode);
+
+            std::string filename = ExportTracer::traceFilename(globalsFilename);
+
+            // Write one trace per frame when exporting sequences.
+            if (filename.find('#') != std::string::npos)
+            {
+                const double frame = MAnimControl::currentTime().value();
+                filename = asf::get_numbered_string(filename, static_cast<size_t>(frame));
+            }
+
+            return filename;
+        }
+
+        void setCamerasShutterTimes(const AppleseedSession::MotionBlurSampleTimes& motionBlurSampleTimes)
+        {
+            // Set the shutter open and close times in all cameras.
+            asr::CameraContainer& cameras = m_project->get_scene()->cameras();
+
+            const float shutterOpenTime = motionBlurSampleTimes.normalizedFrame(motionBlurSampleTimes.m_shutterOpenTime);
+            const float shutterCloseTime = motionBlurSampleTimes.normalizedFrame(motionBlurSampleTimes.m_shutterCloseTime);
+
+            for (size_t i = 0, e = cameras.size(); i < e; ++i)
+            {
+                cameras.get_by_index(i)->get_parameters()
+                    .insert("shutter_open_begin_time", shutterOpenTime)
+                    .insert("shutter_open_end_time", shutterOpenTime)
+                    .insert("shutter_close_begin_time", shutterCloseTime)
+                    .insert("shutter_close_end_time", shutterCloseTime);
+            }
+        }
+
+        bool sceneScaleTransform(const MObject& globalsNode, asr::TransformSequence& scaleTransformSeq) const
+        {
+            MFnDependencyNode fnDepNode(globalsNode);
+
+            float sceneScale;
+            if (!AttributeUtils::get(fnDepNode, "sceneScale", sceneScale) || sceneScale == 1.0f)
+                return false;
+
+            scaleTransformSeq.set_transform(0.0, asf::Transformd::from_local_to_parent(
+                asf::Matrix4d::make_scaling(asf::Vector3d(sceneScale))));
+            return true;
+        }
+
+        void applySceneScale(const MObject& globalsNode)
+        {
+            // Apply the scene scale factor.
+            asr::TransformSequence scaleTransformSeq;
+            if (sceneScaleTransform(globalsNode, scaleTransformSeq))
+            {
+                // Scale the main assembly instance and the static archive instance.
+                asr::Scene* scene = m_project->get_scene();
+                asr::AssemblyInstance* assemblyInstance =
+                    scene->assembly_instances().get_by_name("assembly_inst");
+                assemblyInstance->transform_sequence() = scaleTransformSeq;
+
+                asr::AssemblyInstance* archiveInstance =
+                    scene->assembly_instances().get_by_name("static_archive_inst");
+                if (archiveInstance)
+                    archiveInstance->transform_sequence() = scaleTransformSeq;
+
+                // Apply the scale to all cameras.
+                for (size_t i = 0, e = scene->cameras().size(); i < e; ++i)
+                {
+                    asr::Camera* camera = scene->cameras().get_by_index(i);
+                    camera->transform_sequence() = camera->transform_sequence() * scaleTransformSeq;
+                }
+            }
+        }
+
+        bool incrementalExport() const
+        {
+            // True if the animated parts of the scene are
+            // exported again on each frame of a sequence.
+            return m_options.m_incrementalBatchRender || m_options.m_staticArchive;
+        }
+
         bool autoInstancingEnabled() const
         {
             // When doing interactive rendering, we disable auto-instancing.
@@ -560,176 +742,384 @@ namespace
 
         void exportScene(const AppleseedSession::MotionBlurSampleTimes& motionBlurSampleTimes)
         {
-            createExporters();
+            {
+                ScopedTraceEvent event("createExporters");
+                createExporters();
+            }
+
             throwIfUserAborted();
 
-            RENDERER_LOG_DEBUG("Creating alpha map entities");
-            for (auto it = m_alphaMapExporters.begin(), e = m_alphaMapExporters.end(); it != e; ++it)
-                it->second->createEntities();
+            {
+                ScopedTraceEvent event("prepareTextures");
+                prepareTextures();
+            }
 
             throwIfUserAborted();
 
-            RENDERER_LOG_DEBUG("Creating shading network entities");
-            for (size_t i = 0; i < NumShadingNetworkContexts; ++i)
             {
-                for (auto it = m_shadingNetworkExporters[i].begin(), e = m_shadingNetworkExporters[i].end(); it != e; ++it)
+                RENDERER_LOG_DEBUG("Creating alpha map entities");
+                ScopedTraceEvent event("createEntities (alpha maps)");
+                for (auto it = m_alphaMapExporters.begin(), e = m_alphaMapExporters.end(); it != e; ++it)
                     it->second->createEntities();
             }
 
-            RENDERER_LOG_DEBUG("Creating shading engine entities");
-            for (auto it = m_shadingEngineExporters.begin(), e = m_shadingEngineExporters.end(); it != e; ++it)
-                it->second->createEntities(m_options);
-
             throwIfUserAborted();
 
-            RENDERER_LOG_DEBUG("Creating dag entities");
-            for (auto it = m_dagExporters.begin(), e = m_dagExporters.end(); it != e; ++it)
-                it->second->createEntities(m_options, motionBlurSampleTimes);
-
-            RENDERER_LOG_DEBUG("Exporting motion steps");
-            auto frameIt(motionBlurSampleTimes.m_allTimes.begin());
-            auto frameEnd(motionBlurSampleTimes.m_allTimes.end());
-            for (; frameIt != frameEnd; ++frameIt)
             {
-                const float now = static_cast<float>(MAnimControl::currentTime().value());
-
-                if (*frameIt != now)
+                RENDERER_LOG_DEBUG("Creating shading network entities");
+                ScopedTraceEvent event("createEntities (shading networks)");
+                for (size_t i = 0; i < NumShadingNetworkContexts; ++i)
                 {
-                    RENDERER_LOG_DEBUG("Setting frame to %f", *frameIt);
-                    MGlobal::viewFrame(*frameIt);
+                    for (auto it = m_shadingNetworkExporters[i].begin(), e = m_shadingNetworkExporters[i].end(); it != e; ++it)
+                        it->second->createEntities();
                 }
+            }
 
-                const float frame = motionBlurSampleTimes.normalizedFrame(*frameIt);
+            {
+                RENDERER_LOG_DEBUG("Creating shading engine entities");
+                ScopedTraceEvent event("createEntities (shading engines)");
+                for (auto it = m_shadingEngineExporters.begin(), e = m_shadingEngineExporters.end(); it != e; ++it)
+                    it->second->createEntities(m_options);
+            }
 
-                for (auto it = m_dagExporters.begin(), e = m_dagExporters.end(); it != e; ++it)
-                {
-                    if (it->second->supportsMotionBlur())
-                    {
-                        if (motionBlurSampleTimes.m_cameraTimes.count(*frameIt))
-                            it->second->exportCameraMotionStep(frame);
+            if (m_sessionMode != AppleseedSession::ProgressiveRenderSession)
+            {
+                RENDERER_LOG_DEBUG("Sharing identical materials");
+                ScopedTraceEvent event("shareIdenticalMaterials");
+                shareIdenticalMaterials();
+                remapShapeMaterials(m_dagExporters);
+            }
 
-                        if (motionBlurSampleTimes.m_transformTimes.count(*frameIt))
-                            it->second->exportTransformMotionStep(frame);
+            if (m_options.m_staticArchive)
+                collectAnimatedMaterials();
 
-                        if (motionBlurSampleTimes.m_deformTimes.count(*frameIt))
-                            it->second->exportShapeMotionStep(frame);
-                    }
+            throwIfUserAborted();
 
-                    throwIfUserAborted();
-                }
+            {
+                RENDERER_LOG_DEBUG("Creating dag entities");
+                ScopedTraceEvent event("createEntities (dag nodes)");
+                createDagEntities(m_dagExporters, motionBlurSampleTimes);
             }
 
+            RENDERER_LOG_DEBUG("Exporting motion steps");
+            exportMotionSteps(m_dagExporters, motionBlurSampleTimes);
+
+            RENDERER_LOG_DEBUG("Converting dag entities");
+            convertDagEntities(m_dagExporters);
+
+            throwIfUserAborted();
+
             if (autoInstancingEnabled())
             {
                 RENDERER_LOG_DEBUG("Converting objects to instances");
+                ScopedTraceEvent event("convertObjectsToInstances");
                 convertObjectsToInstances();
             }
 
             throwIfUserAborted();
 
-            RENDERER_LOG_DEBUG("Flushing alpha map entities");
-            for (auto it = m_alphaMapExporters.begin(), e = m_alphaMapExporters.end(); it != e; ++it)
-                it->second->flushEntities();
+            {
+                RENDERER_LOG_DEBUG("Flushing alpha map entities");
+                ScopedTraceEvent event("flushEntities (alpha maps)");
+                for (auto it = m_alphaMapExporters.begin(), e = m_alphaMapExporters.end(); it != e; ++it)
+                    it->second->flushEntities();
+            }
 
             throwIfUserAborted();
 
-            RENDERER_LOG_DEBUG("Flushing shading network entities");
-            for (size_t i = 0; i < NumShadingNetworkContexts; ++i)
             {
-                for (auto it = m_shadingNetworkExporters[i].begin(), e = m_shadingNetworkExporters[i].end(); it != e; ++it)
-                    it->second->flushEntities();
+                RENDERER_LOG_DEBUG("Flushing shading network entities");
+                ScopedTraceEvent event("flushEntities (shading networks)");
+                for (size_t i = 0; i < NumShadingNetworkContexts; ++i)
+                {
+                    for (auto it = m_shadingNetworkExporters[i].begin(), e = m_shadingNetworkExporters[i].end(); it != e; ++it)
+                        it->second->flushEntities();
+                }
             }
 
             throwIfUserAborted();
 
-            RENDERER_LOG_DEBUG("Flushing shading engines entities");
-            for (auto it = m_shadingEngineExporters.begin(), e = m_shadingEngineExporters.end(); it != e; ++it)
-                it->second->flushEntities();
+            {
+                RENDERER_LOG_DEBUG("Flushing shading engines entities");
+                ScopedTraceEvent event("flushEntities (shading engines)");
+                for (auto it = m_shadingEngineExporters.begin(), e = m_shadingEngineExporters.end(); it != e; ++it)
+                    it->second->flushEntities();
+            }
 
             throwIfUserAborted();
 
             RENDERER_LOG_DEBUG("Flushing dag entities");
-            for (auto it = m_dagExporters.begin(), e = m_dagExporters.end(); it != e; ++it)
-                it->second->flushEntities();
+            flushDagEntities(m_dagExporters);
+
+            // All the exporters created so far are flushed.
+            clearNewExporters();
         }
 
-        void exportDefaultRenderGlobals()
+        void updateScene(const AppleseedSession::MotionBlurSampleTimes& motionBlurSampleTimes)
         {
-            RENDERER_LOG_DEBUG("Exporting default render globals");
-
-            MObject defaultRenderGlobalsNode;
-            if (getDependencyNodeByName("defaultRenderGlobals", defaultRenderGlobalsNode))
+            RENDERER_LOG_DEBUG("Updating animated shading network entities");
+            for (size_t i = 0; i < NumShadingNetworkContexts; ++i)
             {
-                // TODO: export Maya render globals if needed...
+                for (auto it = m_shadingNetworkExporters[i].begin(), e = m_shadingNetworkExporters[i].end(); it != e; ++it)
+                {
+                    if (it->second->isAnimated())
+                    {
+                        it->second->removeEntities();
+                        it->second->createEntities();
+                        it->second->flushEntities();
+                    }
+                }
             }
+
+            throwIfUserAborted();
+
+            DagExporterMap dagExporters;
+            removeTimeDependentDagNodes(dagExporters);
+            exportTimeDependentDagNodes(dagExporters, motionBlurSampleTimes);
         }
 
-        MObject exportAppleseedRenderGlobals()
+        bool isTimeDependent(const DagNodeExporter& exporter) const
         {
-            RENDERER_LOG_DEBUG("Exporting appleseed render globals");
+            if (exporter.isTimeDependent())
+                return true;
 
-            MObject appleseedRenderGlobalsNode;
-            if (getDependencyNodeByName("appleseedRenderGlobals", appleseedRenderGlobalsNode))
+            // Shapes using animated materials are kept out of the static archive.
+            if (!m_animatedMaterials.empty())
             {
-                RenderGlobalsNode::applyGlobalsToProject(
-                    appleseedRenderGlobalsNode,
-                    m_sessionMode,
-                    *m_project,
-                    m_aovs);
+                const ShapeExporter* shape = dynamic_cast<const ShapeExporter*>(&exporter);
+                return shape && shape->usesMaterial(m_animatedMaterials);
             }
 
-            return appleseedRenderGlobalsNode;
+            return false;
         }
 
-        void createExporters()
+        void collectAnimatedMaterials()
         {
-            if (m_options.m_selectionOnly)
-            {
-                // Create exporters only for the selected nodes in the scene.
-                MStatus status;
-                MSelectionList sel;
-                status = MGlobal::getActiveSelectionList(sel);
+            m_animatedMaterials.clear();
 
-                MDagPath rootPath, path;
-                MItDag it(MItDag::kBreadthFirst);
-
-                for (int i = 0, e = sel.length(); i < e; ++i)
-                {
-                    status = sel.getDagPath(i, rootPath);
-                    if (status)
-                    {
-                        for (it.reset(rootPath); !it.isDone(); it.next())
-                        {
-                            status = it.getPath(path);
-                            if (status)
-                                createDagNodeExporter(path);
-                        }
-                    }
-                }
+            for (auto it = m_shadingEngineExporters.begin(), e = m_shadingEngineExporters.end(); it != e; ++it)
+            {
+                if (it->second->isAnimated())
+                    m_animatedMaterials.insert(it->second->materialName().asChar());
             }
-            else
+        }
+
+        void removeTimeDependentDagNodes(DagExporterMap& dagExporters)
+        {
+            // Remove the entities of the animated dag nodes and
+            // create new exporters for them in dagExporters.
+            RENDERER_LOG_DEBUG("Creating animated dag node exporters");
+            for (auto it = m_dagExporters.begin(); it != m_dagExporters.end();)
             {
-                // Create exporters for all the dag nodes in the scene.
-                RENDERER_LOG_DEBUG("Creating dag node exporters");
-                MDagPath path;
-                for (MItDag it(MItDag::kDepthFirst); !it.isDone(); it.next())
+                if (!isTimeDependent(*it->second))
                 {
-                    it.getPath(path);
-                    createDagNodeExporter(path);
+                    ++it;
+                    continue;
                 }
-            }
 
-            createExtraExporters();
+                const MDagPath path = it->second->dagPath();
+                it->second->removeEntities();
+
+                DagNodeExporterPtr exporter(
+                    NodeExporterFactory::createDagNodeExporter(
+                        path,
+                        *m_project,
+                        m_sessionMode));
+
+                if (exporter)
+                    dagExporters[it->first] = exporter;
+
+                it = m_dagExporters.erase(it);
+            }
         }
 
-        void createExtraExporters()
+        void exportTimeDependentDagNodes(
+            DagExporterMap&                                 dagExporters,
+            const AppleseedSession::MotionBlurSampleTimes&  motionBlurSampleTimes)
         {
-            // Create dag extra exporters.
-            RENDERER_LOG_DEBUG("Creating dag extra exporters");
-            for (auto it = m_dagExporters.begin(), e = m_dagExporters.end(); it != e; ++it)
-                it->second->createExporters(m_exporter_factory);
+            RENDERER_LOG_DEBUG(
+                "Updating %s animated dag nodes",
+                asf::pretty_uint(dagExporters.size()).c_str());
 
-            throwIfUserAborted();
+            {
+                ScopedTraceEvent event("createExporters");
+                for (auto it = dagExporters.begin(), e = dagExporters.end(); it != e; ++it)
+                    it->second->createExporters(m_exporter_factory);
+
+                // The animated nodes can be assigned shading engines not exported yet.
+                for (auto it = m_newShadingEngineExporters.begin(), e = m_newShadingEngineExporters.end(); it != e; ++it)
+                    it->second->createExporters(m_exporter_factory);
+            }
+
+            remapShapeMaterials(dagExporters);
+
+            throwIfUserAborted();
+
+            {
+                ScopedTraceEvent event("createEntities (shading)");
+                for (auto it = m_newAlphaMapExporters.begin(), e = m_newAlphaMapExporters.end(); it != e; ++it)
+                    it->second->createEntities();
+
+                for (size_t i = 0; i < NumShadingNetworkContexts; ++i)
+                {
+                    for (auto it = m_newShadingNetworkExporters[i].begin(), e = m_newShadingNetworkExporters[i].end(); it != e; ++it)
+                        it->second->createEntities();
+                }
+
+                for (auto it = m_newShadingEngineExporters.begin(), e = m_newShadingEngineExporters.end(); it != e; ++it)
+                    it->second->createEntities(m_options);
+            }
+
+            {
+                ScopedTraceEvent event("createEntities (dag nodes)");
+                createDagEntities(dagExporters, motionBlurSampleTimes);
+            }
+
+            exportMotionSteps(dagExporters, motionBlurSampleTimes);
+            convertDagEntities(dagExporters);
+
+            throwIfUserAborted();
+
+            {
+                ScopedTraceEvent event("flushEntities (shading)");
+                for (auto it = m_newAlphaMapExporters.begin(), e = m_newAlphaMapExporters.end(); it != e; ++it)
+                    it->second->flushEntities();
+
+                for (size_t i = 0; i < NumShadingNetworkContexts; ++i)
+                {
+                    for (auto it = m_newShadingNetworkExporters[i].begin(), e = m_newShadingNetworkExporters[i].end(); it != e; ++it)
+                        it->second->flushEntities();
+                }
+
+                for (auto it = m_newShadingEngineExporters.begin(), e = m_newShadingEngineExporters.end(); it != e; ++it)
+                    it->second->flushEntities();
+            }
+
+            flushDagEntities(dagExporters);
+            clearNewExporters();
+
+            for (auto it = dagExporters.begin(), e = dagExporters.end(); it != e; ++it)
+                m_dagExporters[it->first] = it->second;
+
+            mainAssembly()->bump_version_id();
+            m_project->get_scene()->bump_version_id();
+        }
+
+        void exportMotionSteps(
+            DagExporterMap&                                 dagExporters,
+            const AppleseedSession::MotionBlurSampleTimes&  motionBlurSampleTimes)
+        {
+            auto frameIt(motionBlurSampleTimes.m_allTimes.begin());
+            auto frameEnd(motionBlurSampleTimes.m_allTimes.end());
+            for (; frameIt != frameEnd; ++frameIt)
+            {
+                // Evaluate the motion step through a DG context at the sample time.
+                // Only the animated plugs read by the exporters are evaluated and
+                // the current time of the scene is left unchanged.
+                RENDERER_LOG_DEBUG("Evaluating motion step at frame %f", *frameIt);
+                ScopedEvaluationTime evaluationTime(*frameIt);
+                ScopedTraceEvent event("exportMotionStep");
+
+                const float frame = motionBlurSampleTimes.normalizedFrame(*frameIt);
+
+                for (auto it = dagExporters.begin(), e = dagExporters.end(); it != e; ++it)
+                {
+                    if (it->second->supportsMotionBlur())
+                    {
+                        ScopedTraceEvent exporterEvent = traceDagExporter(*it->second, "exportMotionStep");
+
+                        if (motionBlurSampleTimes.m_cameraTimes.count(*frameIt))
+                            it->second->exportCameraMotionStep(frame);
+
+                        if (motionBlurSampleTimes.m_transformTimes.count(*frameIt))
+                            it->second->exportTransformMotionStep(frame);
+
+                        if (motionBlurSampleTimes.m_deformTimes.count(*frameIt))
+                            it->second->exportShapeMotionStep(frame);
+                    }
+
+                    throwIfUserAborted();
+                }
+            }
+        }
+
+        void exportDefaultRenderGlobals()
+        {
+            RENDERER_LOG_DEBUG("Exporting default render globals");
+
+            MObject defaultRenderGlobalsNode;
+            if (getDependencyNodeByName("defaultRenderGlobals", defaultRenderGlobalsNode))
+            {
+                // TODO: export Maya render globals if needed...
+            }
+        }
+
+        MObject exportAppleseedRenderGlobals()
+        {
+            RENDERER_LOG_DEBUG("Exporting appleseed render globals");
+
+            MObject appleseedRenderGlobalsNode;
+            if (getDependencyNodeByName("appleseedRenderGlobals", appleseedRenderGlobalsNode))
+            {
+                RenderGlobalsNode::applyGlobalsToProject(
+                    appleseedRenderGlobalsNode,
+                    m_sessionMode,
+                    *m_project,
+                    m_aovs);
+            }
+
+            return appleseedRenderGlobalsNode;
+        }
+
+        void createExporters()
+        {
+            if (m_options.m_selectionOnly)
+            {
+                // Create exporters only for the selected nodes in the scene.
+                MStatus status;
+                MSelectionList sel;
+                status = MGlobal::getActiveSelectionList(sel);
+
+                MDagPath rootPath, path;
+                MItDag it(MItDag::kBreadthFirst);
+
+                for (int i = 0, e = sel.length(); i < e; ++i)
+                {
+                    status = sel.getDagPath(i, rootPath);
+                    if (status)
+                    {
+                        for (it.reset(rootPath); !it.isDone(); it.next())
+                        {
+                            status = it.getPath(path);
+                            if (status)
+                                createDagNodeExporter(path, m_dagExporters);
+                        }
+                    }
+                }
+            }
+            else
+            {
+                // Create exporters for all the dag nodes in the scene.
+                RENDERER_LOG_DEBUG("Creating dag node exporters");
+                MDagPath path;
+                for (MItDag it(MItDag::kDepthFirst); !it.isDone(); it.next())
+                {
+                    it.getPath(path);
+                    createDagNodeExporter(path, m_dagExporters);
+                }
+            }
+
+            createExtraExporters();
+        }
+
+        void createExtraExporters()
+        {
+            // Create dag extra exporters.
+            RENDERER_LOG_DEBUG("Creating dag extra exporters");
+            for (auto it = m_dagExporters.begin(), e = m_dagExporters.end(); it != e; ++it)
+                it->second->createExporters(m_exporter_factory);
+
+            throwIfUserAborted();
 
             // Create shading engine extra exporters.
             RENDERER_LOG_DEBUG("Creating shading engines extra exporters");
@@ -737,11 +1127,11 @@ namespace
                 it->second->createExporters(m_exporter_factory);
         }
 
-        void createDagNodeExporter(const MDagPath& path)
+        void createDagNodeExporter(const MDagPath& path, DagExporterMap& dagExporters)
         {
             throwIfUserAborted();
 
-            if (m_dagExporters.count(path.fullPathName()) != 0)
+            if (dagExporters.count(path.fullPathName()) != 0)
                 return;
 
             MFnDagNode dagNodeFn(path);
@@ -774,13 +1164,87 @@ namespace
 
             if (exporter)
             {
-                m_dagExporters[path.fullPathName()] = exporter;
+                dagExporters[path.fullPathName()] = exporter;
                 RENDERER_LOG_DEBUG(
                     "Created dag exporter for node %s",
                     dagNodeFn.name().asChar());
             }
         }
 
+        void convertDagEntities(DagExporterMap& dagExporters)
+        {
+            // All the Maya data was collected by now in the main thread.
+            // The conversion to appleseed entities does not need Maya
+            // and can run in parallel.
+            std::vector<DagNodeExporter*> exporters;
+            exporters.reserve(dagExporters.size());
+
+            for (auto it = dagExporters.begin(), e = dagExporters.end(); it != e; ++it)
+                exporters.push_back(it->second.get());
+
+            // Node names can't be queried from the worker threads.
+            std::vector<MString> nodeTypes, nodeNames;
+            if (ExportTracer::enabled())
+            {
+                nodeTypes.reserve(exporters.size());
+                nodeNames.reserve(exporters.size());
+
+                for (size_t i = 0, e = exporters.size(); i < e; ++i)
+                {
+                    nodeTypes.push_back(MFnDependencyNode(exporters[i]->node()).typeName());
+                    nodeNames.push_back(exporters[i]->dagPath().partialPathName());
+                }
+            }
+
+            // Mesh file writes are only shared by the threads of this pass.
+            MeshExporter::resetMeshFiles();
+
+            ScopedTraceEvent event("convertEntities");
+            parallelFor(
+                exporters.size(),
+                [&](const size_t i)
+                {
+                    ScopedTraceEvent exporterEvent;
+                    if (!nodeNames.empty())
+                        exporterEvent = ScopedTraceEvent(nodeTypes[i], nodeNames[i], "convertEntities");
+
+                    exporters[i]->convertEntities();
+                });
+        }
+
+        void createDagEntities(
+            DagExporterMap&                                 dagExporters,
+            const AppleseedSession::MotionBlurSampleTimes&  motionBlurSampleTimes)
+        {
+            for (auto it = dagExporters.begin(), e = dagExporters.end(); it != e; ++it)
+            {
+                ScopedTraceEvent event = traceDagExporter(*it->second, "createEntities");
+                it->second->createEntities(m_options, motionBlurSampleTimes);
+            }
+        }
+
+        void flushDagEntities(DagExporterMap& dagExporters)
+        {
+            ScopedTraceEvent event("flushEntities (dag nodes)");
+            for (auto it = dagExporters.begin(), e = dagExporters.end(); it != e; ++it)
+            {
+                ScopedTraceEvent exporterEvent = traceDagExporter(*it->second, "flushEntities");
+                it->second->flushEntities();
+            }
+        }
+
+        static ScopedTraceEvent traceDagExporter(const DagNodeExporter& exporter, const char* phase)
+        {
+            // Trace the time spent by an exporter, by node type and name.
+            if (!ExportTracer::enabled())
+                return ScopedTraceEvent();
+
+            return ScopedTraceEvent(
+                MFnDependencyNode(exporter.node()).typeName(),
+                exporter.dagPath().partialPathName(),
+                phase);
+        }
+
         void convertObjectsToInstances()
         {
             std::map<MurmurHash, ShapeExporterPtr> shapesMap;
@@ -790,6 +1254,10 @@ namespace
                 ShapeExporter* shape = dynamic_cast<ShapeExporter*>(it->second.get());
                 if (shape && shape->supportsInstancing())
                 {
+                    // Shapes exported again on each frame cannot be shared.
+                    if (incrementalExport() && isTimeDependent(*shape))
+                        continue;
+
                     // Compute the object hash.
                     MurmurHash hash = shape->hash();
                     RENDERER_LOG_DEBUG(
@@ -810,124 +1278,856 @@ namespace
                                 *m_project,
                                 shape->transformSequence()));
 
-                        // Replace the shape exporter by an instance exporter.
-                        m_dagExporters[it->first] = instanceExporter;
-                    }
-                    else
-                        shapesMap[hash] = std::dynamic_pointer_cast<ShapeExporter>(it->second);
-                }
+                        // Replace the shape exporter by an instance exporter.
+                        m_dagExporters[it->first] = instanceExporter;
+                    }
+                    else
+                        shapesMap[hash] = std::dynamic_pointer_cast<ShapeExporter>(it->second);
+                }
+            }
+        }
+
+        void prepareTextures()
+        {
+            TextureCache::clear();
+
+            MObject globalsNode;
+            if (!getDependencyNodeByName("appleseedRenderGlobals", globalsNode) ||
+                !RenderGlobalsNode::prepareTextures(globalsNode))
+                return;
+
+            // Collect the image files used by the exported file textures,
+            // alpha maps and sky dome lights. Shading node exporters are not
+            // created yet, so we look for file textures upstream of the
+            // exported shading networks.
+            std::vector<std::string> filenames;
+            std::set<std::string> visitedFileNodes;
+
+            for (size_t i = 0; i < NumShadingNetworkContexts; ++i)
+            {
+                for (auto it = m_shadingNetworkExporters[i].begin(), e = m_shadingNetworkExporters[i].end(); it != e; ++it)
+                {
+                    MObject networkNode;
+                    if (!getDependencyNodeByName(it->first, networkNode))
+                        continue;
+
+                    MStatus status;
+                    MItDependencyGraph graphIt(
+                        networkNode,
+                        MFn::kFileTexture,
+                        MItDependencyGraph::kUpstream,
+                        MItDependencyGraph::kDepthFirst,
+                        MItDependencyGraph::kNodeLevel,
+                        &status);
+
+                    if (!status)
+                        continue;
+
+                    for (; !graphIt.isDone(); graphIt.next())
+                    {
+                        const MObject fileNode = graphIt.currentItem();
+                        if (!visitedFileNodes.insert(MFnDependencyNode(fileNode).name().asChar()).second)
+                            continue;
+
+                        const MString filename = MRenderUtil::exactFileTextureName(fileNode, &status);
+                        if (status)
+                            filenames.push_back(filename.asChar());
+                    }
+                }
+            }
+
+            for (auto it = m_alphaMapExporters.begin(), e = m_alphaMapExporters.end(); it != e; ++it)
+            {
+                MObject alphaMapNode;
+                MString filename;
+                if (getDependencyNodeByName(it->first, alphaMapNode) &&
+                    AttributeUtils::get(alphaMapNode, "map", filename))
+                    filenames.push_back(filename.asChar());
+            }
+
+            for (auto it = m_dagExporters.begin(), e = m_dagExporters.end(); it != e; ++it)
+            {
+                const MObject node = it->second->node();
+                MString filename;
+                if (MFnDependencyNode(node).typeName() == SkyDomeLightNode::nodeName &&
+                    AttributeUtils::get(node, "map", filename))
+                    filenames.push_back(filename.asChar());
+            }
+
+            TextureCache::prepareTextures(
+                filenames,
+                RenderGlobalsNode::textureCacheDirectory(globalsNode));
+        }
+
+        void shareIdenticalMaterials()
+        {
+            // Shading engines pointing at distinct but identical shading networks,
+            // for example when the same material file is referenced many times,
+            // share a single shader group and material.
+            m_materialAliases.clear();
+
+            std::map<MurmurHash, ShadingNetworkExporter*> networksMap;
+            size_t numSharedNetworks = 0;
+
+            const ShadingNetworkExporterMap& networks = m_shadingNetworkExporters[SurfaceNetworkContext];
+            for (auto it = networks.begin(), e = networks.end(); it != e; ++it)
+            {
+                // Networks exported again on each frame cannot be shared.
+                if (incrementalExport() && it->second->isAnimated())
+                    continue;
+
+                const MurmurHash hash = it->second->hash();
+                auto masterIt = networksMap.find(hash);
+                if (masterIt != networksMap.end())
+                {
+                    it->second->useSharedShaderGroup(*masterIt->second);
+                    ++numSharedNetworks;
+                }
+                else
+                    networksMap[hash] = it->second.get();
+            }
+
+            std::map<MurmurHash, ShadingEngineExporter*> materialsMap;
+
+            for (auto it = m_shadingEngineExporters.begin(), e = m_shadingEngineExporters.end(); it != e; ++it)
+            {
+                ShadingEngineExporter* shadingEngine = it->second.get();
+
+                if (incrementalExport() && shadingEngine->isAnimated())
+                    continue;
+
+                const MurmurHash hash = shadingEngine->hash();
+                auto masterIt = materialsMap.find(hash);
+                if (masterIt != materialsMap.end())
+                {
+                    const MString materialName = shadingEngine->materialName();
+                    shadingEngine->useSharedMaterial(*masterIt->second);
+                    m_materialAliases.insert(
+                        materialName.asChar(),
+                        masterIt->second->materialName().asChar());
+                }
+                else
+                    materialsMap[hash] = shadingEngine;
+            }
+
+            const size_t numShadingEngines = m_shadingEngineExporters.size();
+            const size_t numMaterials = numShadingEngines - m_materialAliases.size();
+
+            RENDERER_LOG_INFO(
+                "Exported %s shading engines as %s unique materials (%s shared), "
+                "%s shading networks shared.",
+                asf::pretty_uint(numShadingEngines).c_str(),
+                asf::pretty_uint(numMaterials).c_str(),
+                asf::pretty_percent(m_materialAliases.size(), numShadingEngines).c_str(),
+                asf::pretty_uint(numSharedNetworks).c_str());
+        }
+
+        void remapShapeMaterials(DagExporterMap& dagExporters)
+        {
+            if (m_materialAliases.empty())
+                return;
+
+            for (auto it = dagExporters.begin(), e = dagExporters.end(); it != e; ++it)
+                it->second->remapMaterials(m_materialAliases);
+        }
+
+        void initFileLogging(MObject& globals, ScopedLogTarget& logTarget) const
+        {
+            const MString logFilename = RenderGlobalsNode::logFilename(globals);
+
+            if (logFilename.length() != 0)
+            {
+                // Create the file log target and make sure it's open.
+                asf::auto_release_ptr<asf::ILogTarget> l(
+                    Logger::createAsyncFileLogTarget(logFilename.asChar()));
+
+                if (l.get() == nullptr)
+                {
+                    RENDERER_LOG_ERROR("Could not open log file %s", logFilename.asChar());
+                    return;
+                }
+
+                logTarget.setLogTarget(l);
+            }
+        }
+
+        void finalRender()
+        {
+            assert(MGlobal::mayaState() == MGlobal::kInteractive);
+            assert(m_computation);
+
+            // Get the appleseed globals node.
+            MObject appleseedRenderGlobalsNode;
+            getDependencyNodeByName("appleseedRenderGlobals", appleseedRenderGlobalsNode);
+            MFnDependencyNode depNodeFn(appleseedRenderGlobalsNode);
+
+            // Init logging.
+            asr::global_logger().set_verbosity_level(
+                RenderGlobalsNode::logLevel(appleseedRenderGlobalsNode));
+
+            // Start the idle job queue for render view updates.
+            IdleJobQueue::start();
+
+            // Reset the renderer controller.
+            m_rendererController.set_status(asr::IRendererController::ContinueRendering);
+
+            // Create a tile callback to render to Maya's render view.
+            m_tileCallbackFactory.reset(
+                new RenderViewTileCallbackFactory(m_rendererController, m_computation));
+            m_tileCallbackFactory->renderViewStart(*m_project->get_frame());
+
+            // Create the master renderer.
+            asr::Configuration* cfg = m_project->configurations().get_by_name("final");
+            const asr::ParamArray& params = cfg->get_parameters();
+            m_renderer.reset(
+                new asr::MasterRenderer(
+                    *m_project,
+                    params,
+                    g_resourceSearchPaths,
+                    static_cast<asr::ITileCallbackFactory*>(m_tileCallbackFactory.get())));
+
+            // Render in a thread (non blocking).
+            std::thread thread(&SessionImpl::renderFunc, this);
+            m_renderThread.swap(thread);
+        }
+
+        void batchRender()
+        {
+            // Get the appleseed globals node.
+            MObject appleseedRenderGlobalsNode;
+            getDependencyNodeByName("appleseedRenderGlobals", appleseedRenderGlobalsNode);
+            MFnDependencyNode depNodeFn(appleseedRenderGlobalsNode);
+
+            // Init logging.
+            ScopedSetLoggerVerbosity logLevel(RenderGlobalsNode::logLevel(appleseedRenderGlobalsNode));
+
+            ScopedLogTarget logTarget;
+            initFileLogging(appleseedRenderGlobalsNode, logTarget);
+
+            // Reset the renderer controller.
+            m_rendererController.set_status(asr::IRendererController::ContinueRendering);
+
+            // Create the master renderer.
+            asr::Configuration* cfg = m_project->configurations().get_by_name("final");
+            const asr::ParamArray& params = cfg->get_parameters();
+            m_renderer.reset(
+                new asr::MasterRenderer(
+                    *m_project,
+                    params,
+                    g_resourceSearchPaths,
+                    static_cast<asr::ITileCallbackFactory*>(nullptr)));
+
+            // Render in the main thread (blocking).
+            m_renderer->render(m_rendererController);
+        }
+
+        void progressiveRender()
+        {
+            assert(MGlobal::mayaState() == MGlobal::kInteractive);
+
+            // Get the appleseed globals node.
+            MObject appleseedRenderGlobalsNode;
+            getDependencyNodeByName("appleseedRenderGlobals", appleseedRenderGlobalsNode);
+
+            // Init logging.
+            asr::global_logger().set_verbosity_level(
+                RenderGlobalsNode::logLevel(appleseedRenderGlobalsNode));
+
+            // The session stays alive while the scene is edited.
+            // User interrupts are only checked during the initial export.
+            m_computation.reset();
+
+            // The exporters created by the initial export are already flushed.
+            clearNewExporters();
+
+            // Start the idle job queue for render view updates and scene edits.
+            IdleJobQueue::start();
+
+            addProgressiveRenderCallbacks();
+            startProgressiveRender();
+        }
+
+        void startProgressiveRender()
+        {
+            assert(!m_renderThread.joinable());
+
+            // Reset the renderer controller.
+            m_rendererController.set_status(asr::IRendererController::ContinueRendering);
+
+            // Create a tile callback to render to Maya's render view.
+            m_tileCallbackFactory.reset(
+                new RenderViewTileCallbackFactory(m_rendererController, m_computation));
+            m_tileCallbackFactory->renderViewStart(*m_project->get_frame());
+
+            // Create the master renderer.
+            asr::Configuration* cfg = m_project->configurations().get_by_name("interactive");
+            const asr::ParamArray& params = cfg->get_parameters();
+            m_renderer.reset(
+                new asr::MasterRenderer(
+                    *m_project,
+                    params,
+                    g_resourceSearchPaths,
+                    static_cast<asr::ITileCallbackFactory*>(m_tileCallbackFactory.get())));
+
+            // Render in a thread (non blocking).
+            std::thread thread(&SessionImpl::progressiveRenderFunc, this);
+            m_renderThread.swap(thread);
+        }
+
+        void stopProgressiveRender()
+        {
+            abortRender();
+
+            // The renderer references the tile callback factory.
+            m_renderer.reset();
+            m_tileCallbackFactory.reset();
+        }
+
+        void progressiveRenderFunc()
+        {
+            // Unlike final renders, the session is kept alive
+            // when rendering ends. Scene edits start a new render.
+            m_renderer->render(m_rendererController);
+        }
+
+        void refreshProgressiveRender()
+        {
+            stopProgressiveRender();
+
+            if (!m_paused)
+                startProgressiveRender();
+        }
+
+        void pauseProgressiveRender(const bool pause)
+        {
+            if (pause == m_paused)
+                return;
+
+            m_paused = pause;
+
+            if (m_paused)
+                stopProgressiveRender();
+            else
+                startProgressiveRender();
+        }
+
+        void updateProgressiveRenderRegion()
+        {
+            unsigned int left, right, bottom, top;
+            MStatus status = MRenderView::getRenderRegion(left, right, bottom, top);
+
+            stopProgressiveRender();
+
+            // Keep the region in the options, in case the session is restarted.
+            m_options.m_renderRegion = status == MS::kSuccess;
+            if (m_options.m_renderRegion)
+            {
+                m_options.m_xmin = static_cast<int>(left);
+                m_options.m_xmax = static_cast<int>(right);
+                m_options.m_ymin = static_cast<int>(bottom);
+                m_options.m_ymax = static_cast<int>(top);
+
+                // Flip the render region vertically (Maya is Y up).
+                flip_pixel_interval(m_options.m_height, m_options.m_ymin, m_options.m_ymax);
+
+                m_project->get_frame()->set_crop_window(
+                    asf::AABB2u(
+                        asf::Vector2u(m_options.m_xmin, m_options.m_ymin),
+                        asf::Vector2u(m_options.m_xmax, m_options.m_ymax)));
+            }
+            else
+                m_project->get_frame()->reset_crop_window();
+
+            if (!m_paused)
+                startProgressiveRender();
+        }
+
+        void applySceneEdits()
+        {
+            assert(m_sessionMode == AppleseedSession::ProgressiveRenderSession);
+
+            m_updateScheduled = false;
+
+            // Entities can't be edited while rendering.
+            stopProgressiveRender();
+
+            ScopedExportTrace trace(exportTraceFilename());
+            ScopedTraceEvent event("applySceneEdits");
+
+            AppleseedSession::MotionBlurSampleTimes motionBlurSampleTimes;
+            motionBlurSampleTimes.initializeToCurrentFrame();
+
+            RENDERER_LOG_DEBUG(
+                "Applying scene edits: %s dag nodes, %s moved dag nodes, %s shading engines, %s shading networks",
+                asf::pretty_uint(m_dirtyDagNodes.size()).c_str(),
+                asf::pretty_uint(m_movedDagNodes.size()).c_str(),
+                asf::pretty_uint(m_dirtyShadingEngines.size()).c_str(),
+                asf::pretty_uint(m_dirtyShadingNetworks.size()).c_str());
+
+            // Shading networks are edited in place, their shader group names do not change.
+            for (auto it = m_dirtyShadingNetworks.begin(), e = m_dirtyShadingNetworks.end(); it != e; ++it)
+            {
+                for (size_t i = 0; i < NumShadingNetworkContexts; ++i)
+                {
+                    auto networkIt = m_shadingNetworkExporters[i].find(*it);
+                    if (networkIt != m_shadingNetworkExporters[i].end())
+                    {
+                        networkIt->second->removeEntities();
+                        networkIt->second->createEntities();
+                        networkIt->second->flushEntities();
+                    }
+                }
+            }
+
+            // Shading engines are also edited in place,
+            // they may connect to new shading networks.
+            std::vector<ShadingEngineExporter*> shadingEngines;
+            for (auto it = m_dirtyShadingEngines.begin(), e = m_dirtyShadingEngines.end(); it != e; ++it)
+            {
+                auto engineIt = m_shadingEngineExporters.find(*it);
+                if (engineIt != m_shadingEngineExporters.end())
+                {
+                    engineIt->second->removeEntities();
+                    engineIt->second->createExporters(m_exporter_factory);
+                    shadingEngines.push_back(engineIt->second.get());
+                }
+            }
+
+            // Dag nodes are exported again from scratch.
+            // The old exporters remove their entities when destroyed.
+            DagExporterMap dagExporters;
+
+            if (m_dagHierarchyChanged)
+                updateDagHierarchy(dagExporters);
+
+            // Moved nodes only get new transforms when their exporters support it.
+            for (auto it = m_movedDagNodes.begin(), e = m_movedDagNodes.end(); it != e; ++it)
+            {
+                if (m_dirtyDagNodes.count(*it) != 0)
+                    continue;
+
+                auto exporterIt = m_dagExporters.find(*it);
+                if (exporterIt == m_dagExporters.end())
+                    continue;
+
+                if (!exporterIt->second->updateTransformEntities())
+                    m_dirtyDagNodes.insert(*it);
+            }
+
+            for (auto it = m_dirtyDagNodes.begin(), e = m_dirtyDagNodes.end(); it != e; ++it)
+            {
+                auto exporterIt = m_dagExporters.find(*it);
+                if (exporterIt == m_dagExporters.end())
+                    continue;
+
+                const MDagPath path = exporterIt->second->dagPath();
+                removeCallbacks(m_dagNodeCallbacks, exporterIt->first);
+                m_dagExporters.erase(exporterIt);
+
+                if (path.isValid())
+                    createDagNodeExporter(path, dagExporters);
+            }
+
+            for (auto it = dagExporters.begin(), e = dagExporters.end(); it != e; ++it)
+                it->second->createExporters(m_exporter_factory);
+
+            // Create the entities of the exporters created by the edited nodes.
+            for (auto it = m_newShadingEngineExporters.begin(), e = m_newShadingEngineExporters.end(); it != e; ++it)
+            {
+                it->second->createExporters(m_exporter_factory);
+                shadingEngines.push_back(it->second.get());
+            }
+
+            for (auto it = m_newAlphaMapExporters.begin(), e = m_newAlphaMapExporters.end(); it != e; ++it)
+                it->second->createEntities();
+
+            for (size_t i = 0; i < NumShadingNetworkContexts; ++i)
+            {
+                for (auto it = m_newShadingNetworkExporters[i].begin(), e = m_newShadingNetworkExporters[i].end(); it != e; ++it)
+                    it->second->createEntities();
+            }
+
+            for (auto it = shadingEngines.begin(), e = shadingEngines.end(); it != e; ++it)
+                (*it)->createEntities(m_options);
+
+            createDagEntities(dagExporters, motionBlurSampleTimes);
+            exportMotionSteps(dagExporters, motionBlurSampleTimes);
+            convertDagEntities(dagExporters);
+
+            for (auto it = m_newAlphaMapExporters.begin(), e = m_newAlphaMapExporters.end(); it != e; ++it)
+                it->second->flushEntities();
+
+            for (size_t i = 0; i < NumShadingNetworkContexts; ++i)
+            {
+                for (auto it = m_newShadingNetworkExporters[i].begin(), e = m_newShadingNetworkExporters[i].end(); it != e; ++it)
+                    it->second->flushEntities();
+            }
+
+            for (auto it = shadingEngines.begin(), e = shadingEngines.end(); it != e; ++it)
+                (*it)->flushEntities();
+
+            flushDagEntities(dagExporters);
+
+            // Apply the scene scale to the new cameras.
+            MObject globalsNode;
+            asr::TransformSequence scaleTransformSeq;
+            if (getDependencyNodeByName("appleseedRenderGlobals", globalsNode) &&
+                sceneScaleTransform(globalsNode, scaleTransformSeq))
+            {
+                for (auto it = dagExporters.begin(), e = dagExporters.end(); it != e; ++it)
+                {
+                    asr::Camera* camera =
+                        m_project->get_scene()->cameras().get_by_name(it->second->appleseedName().asChar());
+
+                    if (camera)
+                        camera->transform_sequence() = camera->transform_sequence() * scaleTransformSeq;
+                }
+            }
+
+            // Track the edits of the new and updated nodes.
+            for (auto it = dagExporters.begin(), e = dagExporters.end(); it != e; ++it)
+            {
+                m_dagExporters[it->first] = it->second;
+                addDagNodeCallbacks(it->first, *it->second);
+            }
+
+            for (auto it = m_newShadingEngineExporters.begin(), e = m_newShadingEngineExporters.end(); it != e; ++it)
+                addShadingEngineCallbacks(it->first, *it->second);
+
+            for (size_t i = 0; i < NumShadingNetworkContexts; ++i)
+            {
+                for (auto it = m_newShadingNetworkExporters[i].begin(), e = m_newShadingNetworkExporters[i].end(); it != e; ++it)
+                    m_dirtyShadingNetworks.insert(it->first);
+            }
+
+            for (auto it = m_dirtyShadingNetworks.begin(), e = m_dirtyShadingNetworks.end(); it != e; ++it)
+                addShadingNetworkCallbacks(*it);
+
+            m_dirtyDagNodes.clear();
+            m_movedDagNodes.clear();
+            m_dirtyShadingEngines.clear();
+            m_dirtyShadingNetworks.clear();
+            m_dagHierarchyChanged = false;
+            clearNewExporters();
+
+            mainAssembly()->bump_version_id();
+            m_project->get_scene()->bump_version_id();
+
+            if (!m_paused)
+                startProgressiveRender();
+        }
+
+        void updateDagHierarchy(DagExporterMap& dagExporters)
+        {
+            // Create exporters for the new dag paths
+            // and remove the ones no longer in the scene.
+            NameSet scenePaths;
+
+            MDagPath path;
+            for (MItDag it(MItDag::kDepthFirst); !it.isDone(); it.next())
+            {
+                it.getPath(path);
+                scenePaths.insert(path.fullPathName());
+
+                if (m_dagExporters.count(path.fullPathName()) == 0)
+                    createDagNodeExporter(path, dagExporters);
+            }
+
+            for (auto it = m_dagExporters.begin(); it != m_dagExporters.end();)
+            {
+                if (scenePaths.count(it->first) != 0)
+                {
+                    ++it;
+                    continue;
+                }
+
+                RENDERER_LOG_DEBUG("Removing dag exporter for %s", it->first.asChar());
+                removeCallbacks(m_dagNodeCallbacks, it->first);
+                it = m_dagExporters.erase(it);
+            }
+        }
+
+        void clearNewExporters()
+        {
+            m_newShadingEngineExporters.clear();
+            m_newAlphaMapExporters.clear();
+
+            for (size_t i = 0; i < NumShadingNetworkContexts; ++i)
+                m_newShadingNetworkExporters[i].clear();
+        }
+
+        void addProgressiveRenderCallbacks()
+        {
+            MStatus status;
+
+            // Dag nodes added, removed or reparented.
+            MCallbackId id = MDGMessage::addNodeAddedCallback(
+                &SessionImpl::dagNodeAddedOrRemovedCallback, "dagNode", nullptr, &status);
+            if (status)
+                m_sceneCallbacks.append(id);
+
+            id = MDGMessage::addNodeRemovedCallback(
+                &SessionImpl::dagNodeAddedOrRemovedCallback, "dagNode", nullptr, &status);
+            if (status)
+                m_sceneCallbacks.append(id);
+
+            id = MDagMessage::addAllDagChangesCallback(
+                &SessionImpl::dagChangedCallback, nullptr, &status);
+            if (status)
+                m_sceneCallbacks.append(id);
+
+            // Render settings.
+            MObject globalsNode;
+            if (getDependencyNodeByName("appleseedRenderGlobals", globalsNode))
+            {
+                id = MNodeMessage::addAttributeChangedCallback(
+                    globalsNode, &SessionImpl::renderGlobalsChangedCallback, nullptr, &status);
+                if (status)
+                    m_sceneCallbacks.append(id);
+            }
+
+            for (auto it = m_dagExporters.begin(), e = m_dagExporters.end(); it != e; ++it)
+                addDagNodeCallbacks(it->first, *it->second);
+
+            for (auto it = m_shadingEngineExporters.begin(), e = m_shadingEngineExporters.end(); it != e; ++it)
+                addShadingEngineCallbacks(it->first, *it->second);
+
+            for (size_t i = 0; i < NumShadingNetworkContexts; ++i)
+            {
+                for (auto it = m_shadingNetworkExporters[i].begin(), e = m_shadingNetworkExporters[i].end(); it != e; ++it)
+                    addShadingNetworkCallbacks(it->first);
             }
         }
 
-        void initFileLogging(MObject& globals, ScopedLogTarget& logTarget) const
+        void addDagNodeCallbacks(const MString& key, DagNodeExporter& exporter)
         {
-            const MString logFilename = RenderGlobalsNode::logFilename(globals);
+            removeCallbacks(m_dagNodeCallbacks, key);
+
+            // The callbacks get the exporter key, map keys have stable addresses.
+            auto it = m_dagNodeCallbacks.insert(std::make_pair(key, MCallbackIdArray())).first;
+            void* clientData = const_cast<MString*>(&it->first);
+
+            MStatus status;
+            MObject node = exporter.node();
+            MCallbackId id = MNodeMessage::addAttributeChangedCallback(
+                node, &SessionImpl::dagNodeAttributeChangedCallback, clientData, &status);
+            if (status)
+                it->second.append(id);
+
+            MDagPath path = exporter.dagPath();
+            id = MDagMessage::addWorldMatrixModifiedCallback(
+                path, &SessionImpl::dagNodeWorldMatrixModifiedCallback, clientData, &status);
+            if (status)
+                it->second.append(id);
+        }
 
-            if (logFilename.length() != 0)
+        void addShadingEngineCallbacks(const MString& key, ShadingEngineExporter& exporter)
+        {
+            removeCallbacks(m_shadingEngineCallbacks, key);
+
+            auto it = m_shadingEngineCallbacks.insert(std::make_pair(key, MCallbackIdArray())).first;
+            void* clientData = const_cast<MString*>(&it->first);
+
+            MStatus status;
+            MObject node = exporter.node();
+            MCallbackId id = MNodeMessage::addAttributeChangedCallback(
+                node, &SessionImpl::shadingEngineAttributeChangedCallback, clientData, &status);
+            if (status)
+                it->second.append(id);
+        }
+
+        void addShadingNetworkCallbacks(const MString& key)
+        {
+            removeCallbacks(m_shadingNetworkCallbacks, key);
+
+            auto it = m_shadingNetworkCallbacks.insert(std::make_pair(key, MCallbackIdArray())).first;
+            void* clientData = const_cast<MString*>(&it->first);
+
+            // Networks with the same root node in different contexts share the callbacks.
+            MObjectArray nodes;
+            for (size_t i = 0; i < NumShadingNetworkContexts; ++i)
             {
-                // Create the file log target and make sure it's open.
-                asf::auto_release_ptr<asf::FileLogTarget> l(asf::create_file_log_target());
-                l->open(logFilename.asChar());
+                auto networkIt = m_shadingNetworkExporters[i].find(key);
+                if (networkIt == m_shadingNetworkExporters[i].end())
+                    continue;
 
-                if(!l->is_open())
+                networkIt->second->getNodes(nodes);
+
+                for (unsigned int j = 0, je = nodes.length(); j < je; ++j)
                 {
-                    RENDERER_LOG_ERROR("Could not open log file %s", logFilename.asChar());
-                    return;
+                    MStatus status;
+                    MCallbackId id = MNodeMessage::addAttributeChangedCallback(
+                        nodes[j], &SessionImpl::shadingNetworkAttributeChangedCallback, clientData, &status);
+                    if (status)
+                        it->second.append(id);
                 }
+            }
+        }
 
-                logTarget.setLogTarget( asf::auto_release_ptr<asf::ILogTarget>(l.release()));
+        static void removeCallbacks(CallbackIdMap& callbacks, const MString& key)
+        {
+            auto it = callbacks.find(key);
+            if (it != callbacks.end())
+            {
+                MMessage::removeCallbacks(it->second);
+                callbacks.erase(it);
             }
         }
 
-        void finalRender()
+        static void removeCallbacks(CallbackIdMap& callbacks)
         {
-            assert(MGlobal::mayaState() == MGlobal::kInteractive);
-            assert(m_computation);
+            for (auto it = callbacks.begin(), e = callbacks.end(); it != e; ++it)
+                MMessage::removeCallbacks(it->second);
 
-            // Get the appleseed globals node.
-            MObject appleseedRenderGlobalsNode;
-            getDependencyNodeByName("appleseedRenderGlobals", appleseedRenderGlobalsNode);
-            MFnDependencyNode depNodeFn(appleseedRenderGlobalsNode);
+            callbacks.clear();
+        }
 
-            // Init logging.
-            asr::global_logger().set_verbosity_level(
-                RenderGlobalsNode::logLevel(appleseedRenderGlobalsNode));
+        void removeProgressiveRenderCallbacks()
+        {
+            if (m_sceneCallbacks.length() != 0)
+            {
+                MMessage::removeCallbacks(m_sceneCallbacks);
+                m_sceneCallbacks.clear();
+            }
 
-            // Start the idle job queue for render view updates.
-            IdleJobQueue::start();
+            removeCallbacks(m_dagNodeCallbacks);
+            removeCallbacks(m_shadingEngineCallbacks);
+            removeCallbacks(m_shadingNetworkCallbacks);
+        }
 
-            // Reset the renderer controller.
-            m_rendererController.set_status(asr::IRendererController::ContinueRendering);
+        void scheduleSceneEdits()
+        {
+            // Edits are coalesced and applied once, when Maya is idle.
+            if (!m_updateScheduled)
+            {
+                m_updateScheduled = true;
+                IdleJobQueue::pushJob(&SessionImpl::applySceneEditsJob);
+            }
+        }
 
-            // Create a tile callback to render to Maya's render view.
-            m_tileCallbackFactory.reset(
-                new RenderViewTileCallbackFactory(m_rendererController, m_computation));
-            m_tileCallbackFactory->renderViewStart(*m_project->get_frame());
+        static void applySceneEditsJob()
+        {
+            // The session may have ended before the job runs.
+            if (!g_globalSession || g_globalSession->m_sessionMode != AppleseedSession::ProgressiveRenderSession)
+                return;
 
-            // Create the master renderer.
-            asr::Configuration* cfg = m_project->configurations().get_by_name("final");
-            const asr::ParamArray& params = cfg->get_parameters();
-            m_renderer.reset(
-                new asr::MasterRenderer(
-                    *m_project,
-                    params,
-                    g_resourceSearchPaths,
-                    static_cast<asr::ITileCallbackFactory*>(m_tileCallbackFactory.get())));
+            // Restarting or ending the session stops the idle job queue,
+            // which can't be done from one of its jobs.
+            if (g_globalSession->m_needsRestart)
+            {
+                IdleJobQueue::pushDeferredAction(&SessionImpl::restartProgressiveRender);
+                return;
+            }
 
-            // Render in a thread (non blocking).
-            std::thread thread(&SessionImpl::renderFunc, this);
-            m_renderThread.swap(thread);
+            try
+            {
+                g_globalSession->applySceneEdits();
+            }
+            catch (const AppleseedMayaException&)
+            {
+                RENDERER_LOG_ERROR("Could not apply scene edits, stopping interactive render.");
+                IdleJobQueue::pushDeferredAction(&AppleseedSession::endSession);
+            }
         }
 
-        void batchRender()
+        static void restartProgressiveRender()
         {
-            // Get the appleseed globals node.
-            MObject appleseedRenderGlobalsNode;
-            getDependencyNodeByName("appleseedRenderGlobals", appleseedRenderGlobalsNode);
-            MFnDependencyNode depNodeFn(appleseedRenderGlobalsNode);
+            if (!g_globalSession || g_globalSession->m_sessionMode != AppleseedSession::ProgressiveRenderSession)
+                return;
 
-            // Init logging.
-            ScopedSetLoggerVerbosity logLevel(RenderGlobalsNode::logLevel(appleseedRenderGlobalsNode));
+            // The render settings changed, export the scene again.
+            RENDERER_LOG_INFO("Render settings changed, restarting interactive render.");
+            const AppleseedSession::Options options = g_globalSession->m_options;
+            AppleseedSession::progressiveRender(options);
+        }
 
-            ScopedLogTarget logTarget;
-            initFileLogging(appleseedRenderGlobalsNode, logTarget);
+        static bool isSceneEdit(const MNodeMessage::AttributeMessage msg)
+        {
+            return (msg & (
+                MNodeMessage::kAttributeSet |
+                MNodeMessage::kConnectionMade |
+                MNodeMessage::kConnectionBroken |
+                MNodeMessage::kAttributeArrayAdded |
+                MNodeMessage::kAttributeArrayRemoved)) != 0;
+        }
 
-            // Reset the renderer controller.
-            m_rendererController.set_status(asr::IRendererController::ContinueRendering);
+        static void markDirty(NameSet& dirtyNames, void* clientData)
+        {
+            dirtyNames.insert(*static_cast<const MString*>(clientData));
+            g_globalSession->scheduleSceneEdits();
+        }
 
-            // Create the master renderer.
-            asr::Configuration* cfg = m_project->configurations().get_by_name("final");
-            const asr::ParamArray& params = cfg->get_parameters();
-            m_renderer.reset(
-                new asr::MasterRenderer(
-                    *m_project,
-                    params,
-                    g_resourceSearchPaths,
-                    static_cast<asr::ITileCallbackFactory*>(nullptr)));
+        static void dagNodeAttributeChangedCallback(
+            MNodeMessage::AttributeMessage  msg,
+            MPlug&                          plug,
+            MPlug&                          otherPlug,
+            void*                           clientData)
+        {
+            if (isSceneEdit(msg))
+                markDirty(g_globalSession->m_dirtyDagNodes, clientData);
+        }
 
-            // Render in the main thread (blocking).
-            m_renderer->render(m_rendererController);
+        static void dagNodeWorldMatrixModifiedCallback(
+            MObject&                        transformNode,
+            MDagMessage::MatrixModifiedFlags& modified,
+            void*                           clientData)
+        {
+            markDirty(g_globalSession->m_movedDagNodes, clientData);
         }
 
-        void progressiveRender()
+        static void shadingEngineAttributeChangedCallback(
+            MNodeMessage::AttributeMessage  msg,
+            MPlug&                          plug,
+            MPlug&                          otherPlug,
+            void*                           clientData)
         {
-            /*
-            // Reset the renderer controller.
-            m_rendererController->set_status(asr::IRendererController::ContinueRendering);
+            if (isSceneEdit(msg))
+                markDirty(g_globalSession->m_dirtyShadingEngines, clientData);
+        }
 
-            // Create the master renderer.
-            asr::Configuration* cfg = m_project->configurations().get_by_name("interactive");
-            const asr::ParamArray &params = cfg->get_parameters();
+        static void shadingNetworkAttributeChangedCallback(
+            MNodeMessage::AttributeMessage  msg,
+            MPlug&                          plug,
+            MPlug&                          otherPlug,
+            void*                           clientData)
+        {
+            if (isSceneEdit(msg))
+                markDirty(g_globalSession->m_dirtyShadingNetworks, clientData);
+        }
 
-            RenderViewTileCallbackFactory tileCallbackFactory;
-            m_renderer.reset( new asr::MasterRenderer(*m_project, params, m_rendererController, &tileCallbackFactory));
-            */
+        static void renderGlobalsChangedCallback(
+            MNodeMessage::AttributeMessage  msg,
+            MPlug&                          plug,
+            MPlug&                          otherPlug,
+            void*                           clientData)
+        {
+            if (isSceneEdit(msg))
+            {
+                g_globalSession->m_needsRestart = true;
+                g_globalSession->scheduleSceneEdits();
+            }
+        }
+
+        static void dagNodeAddedOrRemovedCallback(MObject& node, void* clientData)
+        {
+            g_globalSession->m_dagHierarchyChanged = true;
+            g_globalSession->scheduleSceneEdits();
+        }
+
+        static void dagChangedCallback(
+            MDagMessage::DagMessage         msgType,
+            MDagPath&                       child,
+            MDagPath&                       parent,
+            void*                           clientData)
+        {
+            g_globalSession->m_dagHierarchyChanged = true;
+            g_globalSession->scheduleSceneEdits();
         }
 
         void renderFunc()
         {
             m_renderer->render(m_rendererController);
-            IdleJobQueue::pushJob(&AppleseedSession::endSession);
+            IdleJobQueue::pushDeferredAction(&AppleseedSession::endSession);
         }
 
         void abortRender()
@@ -1003,12 +2203,6 @@ namespace
                 m_computation->thowIfInterruptRequested();
         }
 
-        typedef std::map<MString, DagNodeExporterPtr, MStringCompareLess>           DagExporterMap;
-        typedef std::map<MString, ShadingEngineExporterPtr, MStringCompareLess>     ShadingEngineExporterMap;
-        typedef std::map<MString, ShadingNetworkExporterPtr, MStringCompareLess>    ShadingNetworkExporterMap;
-        typedef std::array<ShadingNetworkExporterMap, NumShadingNetworkContexts>    ShadingNetworkExporterMapArray;
-        typedef std::map<MString, AlphaMapExporterPtr, MStringCompareLess>          AlphaMapExporterMap;
-
         AppleseedSession::SessionMode                           m_sessionMode;
         AppleseedSession::Options                               m_options;
         ComputationPtr                                          m_computation;
@@ -1025,12 +2219,31 @@ namespace
         ShadingEngineExporterMap                                m_shadingEngineExporters;
         ShadingNetworkExporterMapArray                          m_shadingNetworkExporters;
         AlphaMapExporterMap                                     m_alphaMapExporters;
+        asf::StringDictionary                                   m_materialAliases;
+        std::set<std::string>                                   m_animatedMaterials;
 
         std::unique_ptr<asr::MasterRenderer>                    m_renderer;
         RendererController                                      m_rendererController;
         asf::auto_release_ptr<RenderViewTileCallbackFactory>    m_tileCallbackFactory;
 
         std::thread                                             m_renderThread;
+
+        // Interactive rendering.
+        bool                                                    m_paused;
+        bool                                                    m_updateScheduled;
+        bool                                                    m_needsRestart;
+        bool                                                    m_dagHierarchyChanged;
+        NameSet                                                 m_dirtyDagNodes;
+        NameSet                                                 m_movedDagNodes;
+        NameSet                                                 m_dirtyShadingEngines;
+        NameSet                                                 m_dirtyShadingNetworks;
+        ShadingEngineExporterMap                                m_newShadingEngineExporters;
+        ShadingNetworkExporterMapArray                          m_newShadingNetworkExporters;
+        AlphaMapExporterMap                                     m_newAlphaMapExporters;
+        MCallbackIdArray                                        m_sceneCallbacks;
+        CallbackIdMap                                           m_dagNodeCallbacks;
+        CallbackIdMap                                           m_shadingEngineCallbacks;
+        CallbackIdMap                                           m_shadingNetworkCallbacks;
     };
 }
 
@@ -1040,15 +2253,43 @@ namespace AppleseedSession
 MStatus initialize(const MString& pluginPath)
 {
     g_pluginPath = pluginPath.asChar();
+
+    // Look for the shaders where the shading node registry found them.
+    g_resourceSearchPaths = asf::SearchPaths();
+
+    const bfs::path shadersPath = g_pluginPath.parent_path() / ".." / "shaders";
+    g_resourceSearchPaths.push_back_explicit_path(shadersPath.string().c_str());
+
+    if (const char* envSearchPath = getenv("APPLESEED_SEARCHPATH"))
+    {
+        const char pathSep = asf::SearchPaths::environment_path_separator();
+        std::vector<std::string> paths;
+        asf::split(
+            envSearchPath,
+            std::string(&pathSep, 1),
+            paths);
+
+        for (size_t i = 0, e = paths.size(); i < e; ++i)
+            g_resourceSearchPaths.push_back_explicit_path(paths[i].c_str());
+    }
+
+    TextureCache::initialize(pluginPath);
+
     return MS::kSuccess;
 }
 
 MStatus uninitialize()
 {
     g_globalSession.reset();
+    g_resourceSearchPaths = asf::SearchPaths();
     return MS::kSuccess;
 }
 
+const asf::SearchPaths& resourceSearchPaths()
+{
+    return g_resourceSearchPaths;
+}
+
 namespace
 {
     void beginSession(
@@ -1066,6 +2307,15 @@ namespace
     {
         g_globalSession.reset(new SessionImpl(fileName, options, computation));
     }
+
+    std::string staticArchiveFileName(const std::string& fileNameTemplate)
+    {
+        // Replace the frame placeholders by "static".
+        std::string fileName = fileNameTemplate;
+        const size_t first = fileName.find('#');
+        const size_t last = fileName.find_last_of('#');
+        return fileName.replace(first, last - first + 1, "static");
+    }
 }
 
 MStatus projectExport(const MString& fileName, const Options& options)
@@ -1088,6 +2338,14 @@ MStatus projectExport(const MString& fileName, const Options& options)
             return MS::kFailure;
         }
 
+        const bool staticArchive =
+            options.m_staticArchive && !asf::ends_with(fname_template, ".appleseedz");
+
+        if (options.m_staticArchive && !staticArchive)
+            RENDERER_LOG_WARNING("Static archives are not supported by packed projects.");
+
+        const std::string archiveFileName = staticArchiveFileName(fname_template);
+
         for (int frame = options.m_firstFrame; frame <= options.m_lastFrame; frame += options.m_frameStep)
         {
             // Check if the user wants to abort the export.
@@ -1101,9 +2359,26 @@ MStatus projectExport(const MString& fileName, const Options& options)
             const std::string fname = asf::get_numbered_string(fname_template, frame);
             try
             {
-                beginSession(fname.c_str(), options, computation);
-                g_globalSession->exportProject();
-                g_globalSession->writeProject();
+                if (!staticArchive)
+                {
+                    beginSession(fname.c_str(), options, computation);
+                    g_globalSession->exportProject();
+                    g_globalSession->writeProject();
+                }
+                else if (frame == options.m_firstFrame)
+                {
+                    // Write the static part of the scene once and
+                    // only the animated parts in each frame file.
+                    beginSession(archiveFileName.c_str(), options, computation);
+                    g_globalSession->exportProject();
+                    g_globalSession->writeStaticArchive();
+                    g_globalSession->writeProject(fname.c_str());
+                }
+                else
+                {
+                    g_globalSession->updateProject();
+                    g_globalSession->writeProject(fname.c_str());
+                }
             }
             catch (const AbortRequested&)
             {
@@ -1174,6 +2449,63 @@ MStatus render(const Options& options)
     return MS::kSuccess;
 }
 
+MStatus progressiveRender(const Options& options)
+{
+    // In case we were rendering.
+    endSession();
+
+    ComputationPtr computation = Computation::create();
+
+    g_savedTime = MAnimControl::currentTime();
+    g_savedLogLevel = asr::global_logger().get_verbosity_level();
+
+    try
+    {
+        beginSession(ProgressiveRenderSession, options, computation);
+        g_globalSession->exportProject();
+
+        if (computation->isInterruptRequested())
+        {
+            RENDERER_LOG_INFO("Render aborted.");
+            endSession();
+            return MS::kSuccess;
+        }
+
+        g_globalSession->progressiveRender();
+    }
+    catch (const AbortRequested&)
+    {
+        RENDERER_LOG_INFO("Render aborted.");
+        endSession();
+        return MS::kSuccess;
+    }
+    catch (const AppleseedMayaException&)
+    {
+        endSession();
+        return MS::kFailure;
+    }
+
+    return MS::kSuccess;
+}
+
+void refreshProgressiveRender()
+{
+    if (sessionMode() == ProgressiveRenderSession)
+        g_globalSession->refreshProgressiveRender();
+}
+
+void pauseProgressiveRender(const bool pause)
+{
+    if (sessionMode() == ProgressiveRenderSession)
+        g_globalSession->pauseProgressiveRender(pause);
+}
+
+void updateProgressiveRenderRegion()
+{
+    if (sessionMode() == ProgressiveRenderSession)
+        g_globalSession->updateProgressiveRenderRegion();
+}
+
 namespace
 {
     MString batchRenderFileName(
@@ -1214,6 +2546,26 @@ namespace
 
         return MS::kSuccess;
     }
+
+    MStatus batchRenderNextFrame(const bool firstFrame, const MString& outputFilename)
+    {
+        try
+        {
+            if (firstFrame)
+                g_globalSession->exportProject();
+            else
+                g_globalSession->updateProject();
+
+            g_globalSession->batchRender();
+            g_globalSession->WriteImages(outputFilename.asChar());
+        }
+        catch (...)
+        {
+            return MS::kFailure;
+        }
+
+        return MS::kSuccess;
+    }
 }
 
 MStatus batchRender(Options options)
@@ -1267,6 +2619,10 @@ MStatus batchRender(Options options)
         }
     }
 
+    MObject appleseedRenderGlobalsNode;
+    if (getDependencyNodeByName("appleseedRenderGlobals", appleseedRenderGlobalsNode))
+        options.m_incrementalBatchRender = RenderGlobalsNode::incrementalBatchRender(appleseedRenderGlobalsNode);
+
     MObject renderLayer = MFnRenderLayer::currentLayer(&status);
 
     MCommonRenderSettingsData renderSettings;
@@ -1281,6 +2637,11 @@ MStatus batchRender(Options options)
         const double frameEnd = renderSettings.frameEnd.value();
         const double frameBy = renderSettings.frameBy;
 
+        // In incremental mode, the session is kept alive between frames
+        // and only the animated parts of the scene are exported again.
+        ScopedEndSession session;
+        bool firstFrame = true;
+
         for (double frame = frameStart; frame <= frameEnd; frame += frameBy)
         {
             MGlobal::viewFrame(frame);
@@ -1295,7 +2656,18 @@ MStatus batchRender(Options options)
 
             RENDERER_LOG_DEBUG("Batch render: rendering frame %f, filename = %s", frame, outputFileName.asChar());
 
-            status = batchRenderFrame(options, outputFileName);
+            if (options.m_incrementalBatchRender)
+            {
+                if (firstFrame)
+                    beginSession(BatchRenderSession, options, ComputationPtr());
+
+                status = batchRenderNextFrame(firstFrame, outputFileName);
+
+                // Start from scratch on the next frame if something went wrong.
+                firstFrame = !status;
+            }
+            else
+                status = batchRenderFrame(options, outputFileName);
 
             RENDERER_LOG_DEBUG("Status = %s", status.errorString().asChar());
             RENDERER_LOG_DEBUG("=================================");
@@ -1327,11 +2699,65 @@ MStatus batchRender(Options options)
 namespace
 {
 
+// Hash the size and modification time of the files referenced by string parameters,
+// so that swatches are rendered again when a texture is modified.
+void hashReferencedFiles(const asr::ParamArray& params, MurmurHash& hash)
+{
+    for (auto it = params.strings().begin(), e = params.strings().end(); it != e; ++it)
+    {
+        const std::string value = it.value();
+
+        if (value.compare(0, 7, "string ") != 0)
+            continue;
+
+        const bfs::path path(value.substr(7));
+
+        boost::system::error_code ec;
+        if (!bfs::is_regular_file(path, ec))
+            continue;
+
+        const std::uint64_t size = bfs::file_size(path, ec);
+        const std::int64_t lastWriteTime = bfs::last_write_time(path, ec);
+
+        hash.append(size);
+        hash.append(lastWriteTime);
+    }
+}
+
+// Hash the shaders, parameter values and connections of a shader group.
+// The hash also covers the plugin and appleseed versions, the contents
+// of the .oso files and the files referenced by the parameters, as swatch
+// cache keys outlive Maya sessions.
+void hashShaderGroup(const asr::ShaderGroup& shaderGroup, MurmurHash& hash)
+{
+    hash.append(APPLESEED_MAYA_VERSION_STRING);
+    hash.append(asf::Appleseed::get_lib_version());
+
+    for (auto it = shaderGroup.shaders().begin(), e = shaderGroup.shaders().end(); it != e; ++it)
+    {
+        hash.append(it->get_type());
+        hash.append(it->get_shader());
+        hash.append(ShadingNodeRegistry::getShaderFileHash(it->get_shader()));
+        hash.append(it->get_layer());
+        hash.append(it->get_parameters());
+        hashReferencedFiles(it->get_parameters(), hash);
+    }
+
+    for (auto it = shaderGroup.shader_connections().begin(), e = shaderGroup.shader_connections().end(); it != e; ++it)
+    {
+        hash.append(it->get_src_layer());
+        hash.append(it->get_src_param());
+        hash.append(it->get_dst_layer());
+        hash.append(it->get_dst_param());
+    }
+}
+
 bool doExportSwatch(
     asr::Project&               project,
     const MObject&              node,
     const MPlug&                outputPlug,
-    const ShadingNetworkContext context)
+    const ShadingNetworkContext context,
+    MurmurHash&                 hash)
 {
     asr::Scene* scene = project.get_scene();
     assert(scene);
@@ -1355,12 +2781,20 @@ bool doExportSwatch(
     assert(material);
 
     material->get_parameters().insert("osl_surface", exporter->shaderGroupName().asChar());
+
+    const asr::ShaderGroup* shaderGroup =
+        ass->shader_groups().get_by_name(exporter->shaderGroupName().asChar());
+    assert(shaderGroup);
+
+    hash = MurmurHash();
+    hash.append(static_cast<int>(context));
+    hashShaderGroup(*shaderGroup, hash);
     return true;
 }
 
 }
 
-bool exportMaterialSwatch(asr::Project& project, const MObject& node)
+bool exportMaterialSwatch(asr::Project& project, const MObject& node, MurmurHash& hash)
 {
     MFnDependencyNode depNodeFn(node);
     MPlug outputPlug = depNodeFn.findPlug("outColor", /*wantNetworkedPlug=*/ false);
@@ -1372,10 +2806,11 @@ bool exportMaterialSwatch(asr::Project& project, const MObject& node)
         project,
         node,
         outputPlug,
-        SurfaceSwatchNetworkContext);
+        SurfaceSwatchNetworkContext,
+        hash);
 }
 
-bool exportTextureSwatch(asr::Project& project, const MObject& node)
+bool exportTextureSwatch(asr::Project& project, const MObject& node, MurmurHash& hash)
 {
     MFnDependencyNode depNodeFn(node);
 
@@ -1394,16 +2829,20 @@ bool exportTextureSwatch(asr::Project& project, const MObject& node)
         project,
         node,
         outputPlug,
-        TextureSwatchNetworkContext);
+        TextureSwatchNetworkContext,
+        hash);
 }
 
 void endSession()
 {
     if (g_globalSession.get())
     {
+        // Interactive renders follow the current time, keep it.
+        const bool restoreTime = g_globalSession->m_sessionMode != ProgressiveRenderSession;
+
         g_globalSession.reset();
 
-        if (g_savedTime != MAnimControl::currentTime())
+        if (restoreTime && g_savedTime != MAnimControl::currentTime())
             MGlobal::viewFrame(g_savedTime);
 
         asr::global_logger().set_verbosity_level(g_savedLogLevel);
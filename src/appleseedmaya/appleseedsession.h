@@ -52,7 +52,9 @@
 #include <set>
 
 // Forward declarations.
+namespace foundation { class SearchPaths; }
 namespace renderer { class Project; }
+class MurmurHash;
 
 namespace AppleseedSession
 {
@@ -60,6 +62,9 @@ namespace AppleseedSession
 MStatus initialize(const MString& pluginPath);
 MStatus uninitialize();
 
+// Return the paths where renderers look for shaders and other resources.
+const foundation::SearchPaths& resourceSearchPaths();
+
 enum SessionMode
 {
     NoSession,
@@ -89,6 +94,9 @@ struct Options
     // Final render options.
     // ...
 
+    // Batch render options.
+    bool        m_incrementalBatchRender;
+
     // IPR options.
     // ...
 
@@ -98,6 +106,7 @@ struct Options
     int         m_lastFrame;
     int         m_frameStep;
     bool        m_writeBoundingBox;
+    bool        m_staticArchive;
 };
 
 struct MotionBlurSampleTimes
@@ -158,9 +167,23 @@ MStatus render(const Options& options);
 // Export and batch render the current scene.
 MStatus batchRender(Options options);
 
+// Export and interactively render the current scene to Maya's render view.
+// Scene changes are tracked and applied to the live project until the session ends.
+MStatus progressiveRender(const Options& options);
+
+// Restart the interactive render.
+void refreshProgressiveRender();
+
+// Pause or resume the interactive render.
+void pauseProgressiveRender(const bool pause);
+
+// Restart the interactive render using the current render view region.
+void updateProgressiveRenderRegion();
+
 // Swatch rendering.
-bool exportMaterialSwatch(renderer::Project& project, const MObject& node);
-bool exportTextureSwatch(renderer::Project& project, const MObject& node);
+// On success, hash is set to a hash of the exported shading network.
+bool exportMaterialSwatch(renderer::Project& project, const MObject& node, MurmurHash& hash);
+bool exportTextureSwatch(renderer::Project& project, const MObject& node, MurmurHash& hash);
 
 // Stop rendering and free resources.
 void endSession();
@@ -95,6 +95,8 @@ void parseOptions(
                 options.m_lastFrame = atoi(optNameValue[1].c_str());
             else if (optNameValue[0] == "stepFrame")
                 options.m_frameStep = atoi(optNameValue[1].c_str());
+            else if (optNameValue[0] == "staticArchive")
+                options.m_staticArchive = (optNameValue[1] == "true");
             else
             {
                 RENDERER_LOG_WARNING(
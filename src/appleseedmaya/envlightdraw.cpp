@@ -46,6 +46,7 @@
 
 // Standard headers.
 #include <cmath>
+#include <vector>
 
 namespace asf = foundation;
 
@@ -63,11 +64,21 @@ namespace
 
     MBoundingBox g_boundingBox;
 
+    // Sphere and logo as pairs of line end points.
+    MPointArray g_lineVertices;
+    std::vector<float> g_lineCoords;
+
     inline unsigned int vertexIndex(const unsigned int j, const unsigned int i)
     {
         return j * NumSubdivisions + i;
     }
 
+    void addLine(const MPoint& p0, const MPoint& p1)
+    {
+        g_lineVertices.append(p0);
+        g_lineVertices.append(p1);
+    }
+
     void initializeGeom()
     {
         if (g_initialized)
@@ -185,6 +196,50 @@ namespace
             }
         }
 
+        // Lines.
+        {
+            // Parallels.
+            for (unsigned int j = 0; j < NumSubdivisions; ++j)
+            {
+                for (unsigned int i = 0; i < NumSubdivisions; ++i)
+                {
+                    addLine(
+                        g_sphereVertices[vertexIndex(j, i)],
+                        g_sphereVertices[vertexIndex(j, (i + 1) % NumSubdivisions)]);
+                }
+            }
+
+            // Meridians.
+            for (unsigned int j = 0; j < NumSubdivisions; ++j)
+            {
+                for (unsigned int i = 0; i + 1 < NumSubdivisions; ++i)
+                {
+                    addLine(
+                        g_sphereVertices[vertexIndex(i, j)],
+                        g_sphereVertices[vertexIndex(i + 1, j)]);
+                }
+            }
+
+            // Logo.
+            unsigned int index = 0;
+            for (unsigned int j = 0, je = g_logoStripSizes.length(); j < je; ++j)
+            {
+                const unsigned int stripSize = static_cast<unsigned int>(g_logoStripSizes[j]);
+                for (unsigned int i = 0; i + 1 < stripSize; ++i)
+                    addLine(g_logoVertices[index + i], g_logoVertices[index + i + 1]);
+
+                index += stripSize;
+            }
+
+            g_lineCoords.reserve(g_lineVertices.length() * 3);
+            for (unsigned int i = 0, e = g_lineVertices.length(); i < e; ++i)
+            {
+                g_lineCoords.push_back(static_cast<float>(g_lineVertices[i].x));
+                g_lineCoords.push_back(static_cast<float>(g_lineVertices[i].y));
+                g_lineCoords.push_back(static_cast<float>(g_lineVertices[i].z));
+            }
+        }
+
         // Bounding box.
         {
             g_boundingBox.clear();
@@ -207,56 +262,33 @@ MBoundingBox sphereAndLogoBoundingBox(float size)
     return MBoundingBox(g_boundingBox.min() * size, g_boundingBox.max() * size);
 }
 
-void drawSphereWireframe(const float scale)
+void sphereAndLogoLines(const float scale, MPointArray& lines)
 {
     initializeGeom();
 
-    for (unsigned int j = 0; j < NumSubdivisions; ++j)
-    {
-        glBegin(GL_LINE_LOOP);
-        for (unsigned int i = 0; i < NumSubdivisions; ++i)
-        {
-            const unsigned int index = vertexIndex(j, i);
-            glVertex3f(
-                static_cast<float>(g_sphereVertices[index].x) * scale,
-                static_cast<float>(g_sphereVertices[index].y) * scale,
-                static_cast<float>(g_sphereVertices[index].z) * scale);
-        }
-        glEnd();
-    }
-
-    for (unsigned int j = 0; j < NumSubdivisions; ++j)
+    lines.setLength(g_lineVertices.length());
+    for (unsigned int i = 0, e = g_lineVertices.length(); i < e; ++i)
     {
-        glBegin(GL_LINE_STRIP);
-        for (unsigned int i = 0; i < NumSubdivisions; ++i)
-        {
-            const unsigned int index = vertexIndex(i, j);
-            glVertex3f(
-                static_cast<float>(g_sphereVertices[index].x) * scale,
-                static_cast<float>(g_sphereVertices[index].y) * scale,
-                static_cast<float>(g_sphereVertices[index].z) * scale);
-        }
-        glEnd();
+        lines[i].x = g_lineVertices[i].x * scale;
+        lines[i].y = g_lineVertices[i].y * scale;
+        lines[i].z = g_lineVertices[i].z * scale;
+        lines[i].w = 1.0;
     }
 }
 
-void drawAppleseedLogo(const float scale)
+void drawSphereAndLogo(const float scale)
 {
     initializeGeom();
 
-    unsigned int index = 0;
-    for (unsigned int j = 0, je = g_logoStripSizes.length(); j < je; ++j)
-    {
-        glBegin(GL_LINE_STRIP);
-        const int stripSize = g_logoStripSizes[j];
-        for (int i = 0; i < stripSize; ++i)
-        {
-            glVertex3f(
-                static_cast<float>(g_logoVertices[index].x) * scale,
-                static_cast<float>(g_logoVertices[index].y) * scale,
-                static_cast<float>(g_logoVertices[index].z) * scale);
-            ++index;
-        }
-        glEnd();
-    }
+    glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
+    glMatrixMode(GL_MODELVIEW);
+    glPushMatrix();
+    glScalef(scale, scale, scale);
+
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glVertexPointer(3, GL_FLOAT, 0, g_lineCoords.data());
+    glDrawArrays(GL_LINES, 0, static_cast<GLsizei>(g_lineVertices.length()));
+
+    glPopMatrix();
+    glPopClientAttrib();
 }
@@ -31,10 +31,14 @@
 // Maya headers.
 #include "appleseedmaya/_beginmayaheaders.h"
 #include <maya/MBoundingBox.h>
+#include <maya/MPointArray.h>
 #include "appleseedmaya/_endmayaheaders.h"
 
 MBoundingBox sphereAndLogoBoundingBox(float size);
 
-void drawSphereWireframe(const float scale);
-void drawAppleseedLogo(const float scale);
+// Return the sphere wireframe and the logo as pairs of line end points, for Viewport 2.0.
+void sphereAndLogoLines(const float scale, MPointArray& lines);
+
+// Draw the sphere wireframe and the logo in the legacy viewport.
+void drawSphereAndLogo(const float scale);
 
@@ -31,6 +31,7 @@
 
 // appleseed-maya headers.
 #include "appleseedmaya/attributeutils.h"
+#include "appleseedmaya/texturecache.h"
 
 // Build options header.
 #include "foundation/core/buildoptions.h"
@@ -93,7 +94,7 @@ void AlphaMapExporter::createEntities()
     m_texture = asr::DiskTexture2dFactory().create(
         textureName.asChar(),
         asr::ParamArray()
-            .insert("filename", map.asChar())
+            .insert("filename", TextureCache::preparedFilename(map).asChar())
             .insert("color_space", "linear_rgb"),
         m_project.search_paths());
 
@@ -163,6 +163,14 @@ void AreaLightExporter::flushEntities()
     mainAssembly().object_instances().insert(m_objectInstance.release());
 }
 
+void AreaLightExporter::removeEntities()
+{
+    mainAssembly().materials().remove(m_material.get());
+    mainAssembly().materials().remove(m_backMaterial.get());
+    mainAssembly().objects().remove(m_lightMesh.get());
+    mainAssembly().object_instances().remove(m_objectInstance.get());
+}
+
 asf::AABB3d AreaLightExporter::boundingBox() const
 {
     asf::AABB3d bbox = objectSpaceBoundingBox(dagPath());
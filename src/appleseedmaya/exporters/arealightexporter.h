@@ -69,6 +69,8 @@ class AreaLightExporter
 
     void flushEntities() override;
 
+    void removeEntities() override;
+
     // Bounds.
     foundation::AABB3d boundingBox() const override;
 
@@ -202,8 +202,9 @@ void CameraExporter::createEntities(
 
 void CameraExporter::exportCameraMotionStep(float time)
 {
-    asf::Matrix4d m = convert(dagPath().inclusiveMatrix());
-    asf::Matrix4d invM = convert(dagPath().inclusiveMatrixInverse());
+    const MMatrix worldMat = worldMatrix(dagPath());
+    asf::Matrix4d m = convert(worldMat);
+    asf::Matrix4d invM = convert(worldMat.inverse());
     asf::Transformd xform(m, invM);
     m_camera->transform_sequence().set_transform(time, xform);
 }
@@ -214,6 +215,18 @@ void CameraExporter::flushEntities()
     scene().cameras().insert(m_camera.release());
 }
 
+bool CameraExporter::isTimeDependent() const
+{
+    // Cameras are cheap to export and the session applies
+    // the scene scale to them, always export them again.
+    return true;
+}
+
+void CameraExporter::removeEntities()
+{
+    scene().cameras().remove(m_camera.get());
+}
+
 bool CameraExporter::isRenderable(const MDagPath& path)
 {
     bool isRenderable = false;
@@ -58,6 +58,10 @@ class CameraExporter
 
     void flushEntities() override;
 
+    bool isTimeDependent() const override;
+
+    void removeEntities() override;
+
   private:
     CameraExporter(
       const MDagPath&                                   path,
@@ -114,6 +114,28 @@ void DagNodeExporter::exportShapeMotionStep(float time)
 {
 }
 
+void DagNodeExporter::convertEntities()
+{
+}
+
+void DagNodeExporter::remapMaterials(const asf::StringDictionary& aliases)
+{
+}
+
+bool DagNodeExporter::updateTransformEntities()
+{
+    return false;
+}
+
+bool DagNodeExporter::isTimeDependent() const
+{
+    return isAnimated(node(), true);
+}
+
+void DagNodeExporter::removeEntities()
+{
+}
+
 asf::AABB3d DagNodeExporter::boundingBox() const
 {
     return asf::AABB3d();
@@ -97,9 +97,28 @@ class DagNodeExporter
     virtual void exportTransformMotionStep(float time);
     virtual void exportShapeMotionStep(float time);
 
+    // Convert the data collected from Maya to appleseed entities.
+    // Called from worker threads, concurrently with other exporters.
+    // Implementations must not call the Maya API and report errors by
+    // throwing an AppleseedMayaException, rethrown in the main thread.
+    virtual void convertEntities();
+
     // Flush entities to the renderer.
     virtual void flushEntities() = 0;
 
+    // Return true if the entities created by this exporter can change from frame to frame.
+    virtual bool isTimeDependent() const;
+
+    // Remove the flushed entities from the project.
+    virtual void removeEntities();
+
+    // Replace the material names found in aliases by the names they map to.
+    virtual void remapMaterials(const foundation::StringDictionary& aliases);
+
+    // Update the transforms of the flushed entities after the node moved.
+    // Return false if the entities have to be created again instead.
+    virtual bool updateTransformEntities();
+
     // Bounds.
     virtual foundation::AABB3d boundingBox() const;
 
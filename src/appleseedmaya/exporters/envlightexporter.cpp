@@ -34,6 +34,7 @@
 #include "appleseedmaya/exporters/exporterfactory.h"
 #include "appleseedmaya/physicalskylightnode.h"
 #include "appleseedmaya/skydomelightnode.h"
+#include "appleseedmaya/texturecache.h"
 
 // Build options header.
 #include "foundation/core/buildoptions.h"
@@ -94,6 +95,15 @@ void EnvLightExporter::flushEntities()
         scene().environment_shaders().insert(m_envShader.release());
 }
 
+void EnvLightExporter::removeEntities()
+{
+    if (m_envShader.get())
+        scene().environment_shaders().remove(m_envShader.get());
+
+    if (m_envLight.get())
+        scene().environment_edfs().remove(m_envLight.get());
+}
+
 void PhysicalSkyLightExporter::registerExporter()
 {
     NodeExporterFactory::registerDagNodeExporter(
@@ -202,6 +212,14 @@ void PhysicalSkyLightExporter::flushEntities()
         mainAssembly().lights().insert(m_sunLight.release());
 }
 
+void PhysicalSkyLightExporter::removeEntities()
+{
+    if (m_sunLight.get())
+        mainAssembly().lights().remove(m_sunLight.get());
+
+    EnvLightExporter::removeEntities();
+}
+
 void SkyDomeLightExporter::registerExporter()
 {
     NodeExporterFactory::registerDagNodeExporter(
@@ -255,7 +273,7 @@ void SkyDomeLightExporter::createEntities(
     m_mapTexture = asr::DiskTexture2dFactory().create(
         textureName.asChar(),
         asr::ParamArray()
-            .insert("filename", map.asChar())
+            .insert("filename", TextureCache::preparedFilename(map).asChar())
             .insert("color_space", "linear_rgb"),
         project().search_paths());
 
@@ -287,7 +305,7 @@ void SkyDomeLightExporter::createEntities(
 
 void SkyDomeLightExporter::exportTransformMotionStep(float time)
 {
-    asf::Matrix4d m = convert(dagPath().inclusiveMatrix());
+    asf::Matrix4d m = convert(worldMatrix(dagPath()));
 
     // Keep only the rotation components of the matrix.
     asf::Vector3d s, t;
@@ -309,3 +327,14 @@ void SkyDomeLightExporter::flushEntities()
 
     EnvLightExporter::flushEntities();
 }
+
+void SkyDomeLightExporter::removeEntities()
+{
+    if (m_mapTexture.get())
+        scene().textures().remove(m_mapTexture.get());
+
+    if (m_mapTextureInstance.get())
+        scene().texture_instances().remove(m_mapTextureInstance.get());
+
+    EnvLightExporter::removeEntities();
+}
@@ -46,6 +46,7 @@ class EnvLightExporter
   public:
     ~EnvLightExporter() override;
     void flushEntities() override;
+    void removeEntities() override;
 
   protected:
     EnvLightExporter(
@@ -80,6 +81,8 @@ class PhysicalSkyLightExporter
 
     void flushEntities() override;
 
+    void removeEntities() override;
+
   private:
     PhysicalSkyLightExporter(
       const MDagPath&                                   path,
@@ -110,6 +113,8 @@ class SkyDomeLightExporter
 
     void flushEntities() override;
 
+    void removeEntities() override;
+
     private:
       SkyDomeLightExporter(
         const MDagPath&                                 path,
@@ -32,7 +32,9 @@
 // appleseed-maya headers.
 #include "appleseedmaya/attributeutils.h"
 #include "appleseedmaya/exporters/exporterfactory.h"
+#include "appleseedmaya/shaderparamencoder.h"
 #include "appleseedmaya/shadingnodemetadata.h"
+#include "appleseedmaya/texturecache.h"
 
 // Build options header.
 #include "foundation/core/buildoptions.h"
@@ -80,11 +82,12 @@ void FileExporter::exportParameterValue(
     if (paramInfo.paramName == "in_fileTextureName")
     {
         MStatus status;
-        const MString textureFileName =
-            MRenderUtil::exactFileTextureName(node(), &status);
+        const MString textureFileName = TextureCache::preparedFilename(
+            MRenderUtil::exactFileTextureName(node(), &status));
 
-        const MString value = MString("string ") + textureFileName;
-        shaderParams.insert("in_fileTextureName", value.asChar());
+        ShaderParamEncoder encoder("string");
+        encoder.add(textureFileName);
+        shaderParams.insert("in_fileTextureName", encoder.c_str());
         return;
     }
 
@@ -74,7 +74,13 @@ void InstanceExporter::flushEntities()
         assemblyInstanceName.asChar());
 
     assemblyInstance->transform_sequence() = m_transformSequence;
-    mainAssembly().assembly_instances().insert(assemblyInstance);
+    m_objectAssemblyInstance.reset(assemblyInstance);
+    mainAssembly().assembly_instances().insert(m_objectAssemblyInstance.release());
+}
+
+void InstanceExporter::removeEntities()
+{
+    mainAssembly().assembly_instances().remove(m_objectAssemblyInstance.get());
 }
 
 asf::AABB3d InstanceExporter::boundingBox() const
@@ -60,6 +60,8 @@ class InstanceExporter
 
     void flushEntities() override;
 
+    void removeEntities() override;
+
     // Bounds.
     foundation::AABB3d boundingBox() const override;
 
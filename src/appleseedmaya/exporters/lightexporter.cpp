@@ -207,3 +207,12 @@ void LightExporter::flushEntities()
         mainAssembly().lights().insert(m_light.release());
     }
 }
+
+void LightExporter::removeEntities()
+{
+    if (m_light.get())
+    {
+        mainAssembly().colors().remove(m_lightColor.get());
+        mainAssembly().lights().remove(m_light.get());
+    }
+}
@@ -62,6 +62,8 @@ class LightExporter
 
     void flushEntities() override;
 
+    void removeEntities() override;
+
   private:
     LightExporter(
       const MDagPath&                                   path,
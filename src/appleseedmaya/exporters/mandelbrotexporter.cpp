@@ -32,6 +32,7 @@
 // appleseed-maya headers.
 #include "appleseedmaya/attributeutils.h"
 #include "appleseedmaya/exporters/exporterfactory.h"
+#include "appleseedmaya/ramputils.h"
 #include "appleseedmaya/shadingnodemetadata.h"
 
 // Build options header.
@@ -47,53 +48,11 @@
 
 // Standard headers.
 #include <algorithm>
-#include <sstream>
 #include <vector>
 
 namespace asf = foundation;
 namespace asr = renderer;
 
-namespace
-{
-    struct MandelbrotColorsEntry
-    {
-        MandelbrotColorsEntry(float pos, const MColor& col, int interp)
-          : m_pos(pos)
-          , m_col(col)
-          , m_interp(interp)
-        {
-        }
-
-        bool operator<(const MandelbrotColorsEntry& other) const
-        {
-            return m_pos < other.m_pos;
-        }
-
-        float   m_pos;
-        MColor  m_col;
-        int     m_interp;
-    };
-
-    struct MandelbrotValuesEntry
-    {
-        MandelbrotValuesEntry(float pos, float val, int interp)
-          : m_pos(pos)
-          , m_val(val)
-          , m_interp(interp)
-        {
-        }
-
-        bool operator<(const MandelbrotValuesEntry& other) const
-        {
-            return m_pos < other.m_pos;
-        }
-
-        float   m_pos;
-        float   m_val;
-        int     m_interp;
-    };
-}
-
 void MandelbrotExporter::registerExporter()
 {
     NodeExporterFactory::registerShadingNodeExporter(
@@ -125,99 +84,29 @@ void MandelbrotExporter::exportParameterValue(
 
     if (paramInfo.paramName == "in_color_Position")
     {
-        MPlug plug = depNodeFn.findPlug("color", /*wantNetworkedPlug=*/ false, &status);
-
-        std::vector<MandelbrotColorsEntry> mandelbrotColors;
-        mandelbrotColors.reserve(plug.numElements());
-
-        for (unsigned int i = 0, e = plug.numElements(); i < e; ++i)
-        {
-            MPlug entry = plug.elementByPhysicalIndex(i);
-            MPlug position = entry.child(0);
-            MPlug color = entry.child(1);
-            MPlug interp = entry.child(2);
-
-            float p;
-            AttributeUtils::get(position, p);
-
-            MColor c;
-            AttributeUtils::get(color, c);
-
-            int in;
-            AttributeUtils::get(interp, in);
-
-            mandelbrotColors.push_back(MandelbrotColorsEntry(p, c, in));
-        }
-
-        std::sort(mandelbrotColors.begin(), mandelbrotColors.end());
-
-        std::stringstream ssp;
-        ssp << "float[] ";
-
-        std::stringstream ssc;
-        ssc << "color[] ";
-
-        std::stringstream ssi;
-        ssi << "int[] ";
-
-        for (size_t i = 0, e = mandelbrotColors.size(); i < e; ++i)
-        {
-            ssp << mandelbrotColors[i].m_pos << " ";
-            ssc << mandelbrotColors[i].m_col.r << " " << mandelbrotColors[i].m_col.g << " " << mandelbrotColors[i].m_col.b << " ";
-            ssi << mandelbrotColors[i].m_interp << " ";
-        }
-
-        shaderParams.insert("in_color_Position", ssp.str().c_str());
-        shaderParams.insert("in_color_Color"   , ssc.str().c_str());
-        shaderParams.insert("in_color_Interp"  , ssi.str().c_str());
+        std::vector<RampEntry<MColor>> entries;
+        getRampEntries(depNodeFn.findPlug("color", /*wantNetworkedPlug=*/ false, &status), entries);
+        std::sort(entries.begin(), entries.end());
+
+        exportRamp(
+            entries,
+            "in_color_Position",
+            "in_color_Color",
+            "in_color_Interp",
+            shaderParams);
     }
     else if (paramInfo.paramName == "in_value_Position")
     {
-        MPlug plug = depNodeFn.findPlug("value", /*wantNetworkedPlug=*/ false, &status);
-
-        std::vector<MandelbrotValuesEntry> mandelbrotValues;
-        mandelbrotValues.reserve(plug.numElements());
-
-        for (unsigned int i = 0, e = plug.numElements(); i < e; ++i)
-        {
-            MPlug entry = plug.elementByPhysicalIndex(i);
-            MPlug position = entry.child(0);
-            MPlug value = entry.child(1);
-            MPlug interp = entry.child(2);
-
-            float p;
-            AttributeUtils::get(position, p);
-
-            float v;
-            AttributeUtils::get(value, v);
-
-            int in;
-            AttributeUtils::get(interp, in);
-
-            mandelbrotValues.push_back(MandelbrotValuesEntry(p, v, in));
-        }
-
-        std::sort(mandelbrotValues.begin(), mandelbrotValues.end());
-
-        std::stringstream ssp;
-        ssp << "float[] ";
-
-        std::stringstream ssv;
-        ssv << "float[] ";
-
-        std::stringstream ssi;
-        ssi << "int[] ";
-
-        for (size_t i = 0, e = mandelbrotValues.size(); i < e; ++i)
-        {
-            ssp << mandelbrotValues[i].m_pos << " ";
-            ssv << mandelbrotValues[i].m_val << " ";
-            ssi << mandelbrotValues[i].m_interp << " ";
-        }
-
-        shaderParams.insert("in_value_Position", ssp.str().c_str());
-        shaderParams.insert("in_value_FloatValue", ssv.str().c_str());
-        shaderParams.insert("in_value_Interp"  , ssi.str().c_str());
+        std::vector<RampEntry<float>> entries;
+        getRampEntries(depNodeFn.findPlug("value", /*wantNetworkedPlug=*/ false, &status), entries);
+        std::sort(entries.begin(), entries.end());
+
+        exportRamp(
+            entries,
+            "in_value_Position",
+            "in_value_FloatValue",
+            "in_value_Interp",
+            shaderParams);
     }
     else if (paramInfo.paramName == "in_color_Color" ||
              paramInfo.paramName == "in_color_Interp"||
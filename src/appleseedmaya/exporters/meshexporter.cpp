@@ -31,6 +31,7 @@
 
 // appleseed-maya headers.
 #include "appleseedmaya/attributeutils.h"
+#include "appleseedmaya/exceptions.h"
 #include "appleseedmaya/exporters/alphamapexporter.h"
 #include "appleseedmaya/exporters/exporterfactory.h"
 #include "appleseedmaya/logger.h"
@@ -44,13 +45,13 @@
 // Maya headers.
 #include "appleseedmaya/_beginmayaheaders.h"
 #include <maya/MFloatPointArray.h>
+#include <maya/MFnDependencyNode.h>
 #include <maya/MFnEnumAttribute.h>
 #include <maya/MFnMesh.h>
 #include <maya/MFnMeshData.h>
 #include <maya/MItDependencyGraph.h>
-#include <maya/MItMeshPolygon.h>
 #include <maya/MMeshSmoothOptions.h>
-#include <maya/MPointArray.h>
+#include <maya/MPlug.h>
 #include <maya/MString.h>
 #include "appleseedmaya/_endmayaheaders.h"
 
@@ -61,6 +62,9 @@
 
 // Standard headers
 #include <array>
+#include <condition_variable>
+#include <map>
+#include <mutex>
 
 namespace bfs = boost::filesystem;
 namespace asf = foundation;
@@ -68,34 +72,67 @@ namespace asr = renderer;
 
 namespace
 {
-    void staticMeshObjectHash(const asr::MeshObject& mesh, MurmurHash& hash)
+    // Mesh files are written from worker threads. Identical meshes
+    // share the same file, make sure only one thread writes it.
+    // The states only last for one conversion pass, so that a
+    // failed write is attempted again by the next export.
+    enum MeshFileState
     {
-        hash.append(mesh.get_tex_coords_count());
-        for (size_t i = 0, e = mesh.get_tex_coords_count(); i < e; ++i)
-            hash.append(mesh.get_tex_coords(i));
+        MeshFileBeingWritten,
+        MeshFileWritten,
+        MeshFileFailed
+    };
+
+    std::mutex g_meshFilesMutex;
+    std::condition_variable g_meshFilesCondition;
+    std::map<std::string, MeshFileState> g_meshFiles;
+
+    // Return true if the caller must write the file and then call releaseMeshFile().
+    // Otherwise, wait until the thread writing the file, if any, is done and
+    // set succeeded to true if the file exists.
+    bool claimMeshFile(const bfs::path& p, bool& succeeded)
+    {
+        std::unique_lock<std::mutex> lock(g_meshFilesMutex);
 
-        hash.append(mesh.get_triangle_count());
-        for (size_t i = 0, e = mesh.get_triangle_count(); i < e; ++i)
-            hash.append(mesh.get_triangle(i));
+        auto it = g_meshFiles.find(p.string());
+        if (it != g_meshFiles.end())
+        {
+            g_meshFilesCondition.wait(lock, [it]() { return it->second != MeshFileBeingWritten; });
 
-        hash.append(mesh.get_material_slot_count());
-        for (size_t i = 0, e = mesh.get_material_slot_count(); i < e; ++i)
-            hash.append(mesh.get_material_slot(i));
+            if (it->second == MeshFileFailed)
+            {
+                succeeded = false;
+                return false;
+            }
+        }
 
-        hash.append(mesh.get_vertex_count());
-        for (size_t i = 0, e = mesh.get_vertex_count(); i < e; ++i)
-            hash.append(mesh.get_vertex(i));
+        if (bfs::exists(p))
+        {
+            succeeded = true;
+            return false;
+        }
+
+        g_meshFiles[p.string()] = MeshFileBeingWritten;
+        return true;
+    }
 
-        hash.append(mesh.get_vertex_normal_count());
-        for (size_t i = 0, e = mesh.get_vertex_normal_count(); i < e; ++i)
-            hash.append(mesh.get_vertex_normal(i));
+    void releaseMeshFile(const bfs::path& p, const bool succeeded)
+    {
+        {
+            std::lock_guard<std::mutex> lock(g_meshFilesMutex);
+            g_meshFiles[p.string()] = succeeded ? MeshFileWritten : MeshFileFailed;
+        }
 
-        hash.append(mesh.get_vertex_tangent_count());
-        for (size_t i = 0, e = mesh.get_vertex_tangent_count(); i < e; ++i)
-            hash.append(mesh.get_vertex_tangent(i));
+        g_meshFilesCondition.notify_all();
     }
 }
 
+void MeshExporter::resetMeshFiles()
+{
+    std::lock_guard<std::mutex> lock(g_meshFilesMutex);
+    g_meshFiles.clear();
+}
+
 void MeshExporter::registerExporter()
 {
     NodeExporterFactory::registerDagNodeExporter("mesh", &MeshExporter::create);
@@ -244,10 +281,11 @@ void MeshExporter::createEntities(
     m_isDeforming = (m_numMeshKeys > 1) && isAnimated(node());
     m_shapeExportStep = 1;
 
+    m_meshName = appleseedName().asChar();
+
     if (sessionMode() != AppleseedSession::ExportSession)
     {
-        MString objectName = appleseedName();
-        m_mesh.reset(asr::MeshObjectFactory().create(objectName.asChar(), m_meshParams));
+        m_mesh.reset(asr::MeshObjectFactory().create(m_meshName.c_str(), m_meshParams));
         createMaterialSlots();
     }
 }
@@ -261,108 +299,94 @@ void MeshExporter::exportShapeMotionStep(float time)
     MStatus status;
     MeshAndData finalMesh = getFinalMesh(&status);
 
-    if (sessionMode() == AppleseedSession::ExportSession)
+    // Only collect the data from Maya here.
+    // The appleseed mesh objects are built later, in convertEntities.
+    if (m_shapeExportStep == 1)
     {
-        MString objectName = appleseedName();
-        m_mesh.reset(asr::MeshObjectFactory().create(objectName.asChar(), m_meshParams));
-
-        createMaterialSlots();
-        fillTopology(finalMesh.m_mesh);
-        exportGeometry(finalMesh.m_mesh);
-
-        // Compute smooth tangents if needed.
-        if (m_smoothTangents)
+        status = fillTopology(finalMesh.m_mesh);
+        if (!status)
         {
-            assert(m_exportUVs);
-            asr::compute_smooth_vertex_tangents(*m_mesh);
+            RENDERER_LOG_ERROR(
+                "Couldn't get the topology of mesh %s: %s.",
+                appleseedName().asChar(),
+                status.errorString().asChar());
+            m_triangles.clear();
         }
+    }
 
-        MurmurHash meshHash;
-        staticMeshObjectHash(*m_mesh, meshHash);
+    extractGeometry(finalMesh.m_mesh);
 
-        const char* extension = ".binarymesh";
-        const std::string fileName = std::string("_geometry/") + meshHash.toString() + extension;
+    m_shapeExportStep++;
+}
 
-        bfs::path projectPath = project().search_paths().get_root_path().c_str();
-        bfs::path p = projectPath / fileName;
+void MeshExporter::convertEntities()
+{
+    assert(!m_meshKeys.empty());
 
-        // Write a geom file for the object if needed.
-        if (!bfs::exists(p))
-        {
-            if (!asr::MeshObjectWriter::write(*m_mesh, "mesh", p.string().c_str()))
-            {
-                RENDERER_LOG_ERROR(
-                    "Couldn't export mesh file for object %s.",
-                    m_mesh->get_name());
-            }
-        }
-        else
+    if (sessionMode() == AppleseedSession::ExportSession)
+    {
+        // Write a mesh file for each motion step.
+        for (size_t i = 0, e = m_meshKeys.size(); i < e; ++i)
         {
-            RENDERER_LOG_INFO(
-                "Mesh file for object %s already exists.",
-                m_mesh->get_name());
-        }
+            m_mesh.reset(asr::MeshObjectFactory().create(m_meshName.c_str(), m_meshParams));
 
-        m_fileNames.push_back(fileName);
+            createMaterialSlots();
+            copyTopologyToMesh();
+            copyKeyToMesh(m_meshKeys[i]);
 
-        // Update the mesh hash.
-        if (m_shapeExportStep == 1)
-        {
-            m_hash = meshHash;
-            m_hash.append(m_mesh->get_parameters());
-            m_hash.append(m_frontMaterialMappings);
-            m_hash.append(m_backMaterialMappings);
-        }
-        else
-        {
-            m_hash.append(m_mesh->get_vertex_count());
-            for (size_t i = 0, e = m_mesh->get_vertex_count(); i < e; ++i)
-                m_hash.append(m_mesh->get_vertex(i));
+            // Compute smooth tangents if needed.
+            if (m_smoothTangents)
+            {
+                assert(m_exportUVs);
+                asr::compute_smooth_vertex_tangents(*m_mesh);
+            }
 
-            m_hash.append(m_mesh->get_vertex_normal_count());
-            for (size_t i = 0, e = m_mesh->get_vertex_normal_count(); i < e; ++i)
-                m_hash.append(m_mesh->get_vertex_normal(i));
+            if (!writeMeshFile(m_meshKeys[i]))
+                throw AppleseedSessionExportError();
 
-            m_hash.append(m_mesh->get_vertex_tangent_count());
-            for (size_t i = 0, e = m_mesh->get_vertex_tangent_count(); i < e; ++i)
-                m_hash.append(m_mesh->get_vertex_tangent(i));
+            // Update the mesh hash.
+            if (i != 0)
+                hashKey(m_meshKeys[i], m_hash);
         }
     }
     else
     {
-        if (m_shapeExportStep == 1)
-        {
-            fillTopology(finalMesh.m_mesh);
-            exportGeometry(finalMesh.m_mesh);
+        copyTopologyToMesh();
+        copyKeyToMesh(m_meshKeys[0]);
 
-            // Update the mesh hash.
-            staticMeshObjectHash(*m_mesh, m_hash);
-            m_hash.append(m_mesh->get_parameters());
-            m_hash.append(m_frontMaterialMappings);
-            m_hash.append(m_backMaterialMappings);
-        }
-        else
-        {
-            exportMeshKey(finalMesh.m_mesh);
+        // Update the mesh hash.
+        hashTopology(m_hash);
+        hashKey(m_meshKeys[0], m_hash);
+        m_hash.append(m_mesh->get_parameters());
+        m_hash.append(m_frontMaterialMappings);
+        m_hash.append(m_backMaterialMappings);
 
-            // Update the mesh hash.
-            const size_t pose = m_shapeExportStep - 1;
+        if (m_meshKeys.size() > 1)
+        {
+            m_mesh->set_motion_segment_count(m_meshKeys.size() - 1);
 
-            m_hash.append(m_mesh->get_vertex_count());
-            for (size_t i = 0, e = m_mesh->get_vertex_count(); i < e; ++i)
-                m_hash.append(m_mesh->get_vertex_pose(i, pose));
+            for (size_t i = 1, e = m_meshKeys.size(); i < e; ++i)
+            {
+                const size_t pose = i - 1;
+                copyKeyToMeshPose(m_meshKeys[i], pose);
 
-            m_hash.append(m_mesh->get_vertex_normal_count());
-            for (size_t i = 0, e = m_mesh->get_vertex_normal_count(); i < e; ++i)
-                m_hash.append(m_mesh->get_vertex_normal_pose(i, pose));
+                // Update the mesh hash.
+                hashKey(m_meshKeys[i], m_hash);
+            }
+        }
 
-            m_hash.append(m_mesh->get_vertex_tangent_count());
-            for (size_t i = 0, e = m_mesh->get_vertex_tangent_count(); i < e; ++i)
-                m_hash.append(m_mesh->get_vertex_tangent_pose(i, pose));
+        // Compute smooth tangents if needed.
+        if (m_smoothTangents)
+        {
+            assert(m_exportUVs);
+            asr::compute_smooth_vertex_tangents(*m_mesh);
         }
     }
 
-    m_shapeExportStep++;
+    // Free the data collected from Maya.
+    std::vector<asr::Triangle>().swap(m_triangles);
+    std::vector<float>().swap(m_uvs);
+    std::vector<MeshKey>().swap(m_meshKeys);
 }
 
 void MeshExporter::flushEntities()
@@ -397,15 +421,6 @@ void MeshExporter::flushEntities()
         m_mesh.reset(asr::MeshObjectFactory().create(m_mesh->get_name(), params));
         objectName += ".mesh";
     }
-    else
-    {
-        // Compute smooth tangents if needed.
-        if (m_smoothTangents)
-        {
-            assert(m_exportUVs);
-            asr::compute_smooth_vertex_tangents(*m_mesh);
-        }
-    }
 
     // Handle alpha maps.
     if (m_alphaMapExporter)
@@ -425,6 +440,15 @@ void MeshExporter::flushEntities()
     createObjectInstance(objectName);
 }
 
+void MeshExporter::removeEntities()
+{
+    // If we have an assembly, the mesh is removed with it.
+    if (m_objectAssembly.get() == nullptr)
+        mainAssembly().objects().remove(m_mesh.get());
+
+    ShapeExporter::removeEntities();
+}
+
 bool MeshExporter::supportsInstancing() const
 {
     return true;
@@ -461,13 +485,25 @@ MeshExporter::MeshAndData MeshExporter::getFinalMesh(MStatus* ReturnStatus) cons
 {
     MeshAndData finalMesh = {node(), MObject()};
 
+    // Evaluate the mesh at the current motion step time
+    // without changing the current time of the scene.
+    MStatus status;
+    MFnDependencyNode depNodeFn(node());
+    MPlug outMeshPlug = depNodeFn.findPlug("outMesh", /*wantNetworkedPlug=*/ false, &status);
+    if (status)
+    {
+        MObject mesh = plugAsMObject(outMeshPlug, &status);
+        if (status && !mesh.isNull())
+            finalMesh.m_mesh = mesh;
+    }
+
     const int smoothLevel = getSmoothLevel();
     if (smoothLevel > 0)
     {
         // We need to create a smooth mesh.
         MFnMesh meshFn(node());
         MMeshSmoothOptions options;
-        MStatus status = meshFn.getSmoothMeshDisplayOptions(options);
+        status = meshFn.getSmoothMeshDisplayOptions(options);
 
         if (!status)
         {
@@ -481,7 +517,9 @@ MeshExporter::MeshAndData MeshExporter::getFinalMesh(MStatus* ReturnStatus) cons
 
         MFnMeshData meshDataFn;
         finalMesh.m_data = meshDataFn.create();
-        finalMesh.m_mesh = meshFn.generateSmoothMesh(finalMesh.m_data, &options, ReturnStatus);
+
+        MFnMesh evaluatedMeshFn(finalMesh.m_mesh);
+        finalMesh.m_mesh = evaluatedMeshFn.generateSmoothMesh(finalMesh.m_data, &options, ReturnStatus);
     }
 
     return finalMesh;
@@ -500,173 +538,284 @@ void MeshExporter::createMaterialSlots()
         m_mesh->push_material_slot("default");
 }
 
-void MeshExporter::fillTopology(MObject mesh)
+MStatus MeshExporter::fillTopology(MObject mesh)
 {
     MStatus status;
+    MFnMesh meshFn(mesh, &status);
+    if (!status)
+        return status;
+
+    // Query the whole topology at once.
+    MIntArray polyVertexCounts, polyVertices;
+    status = meshFn.getVertices(polyVertexCounts, polyVertices);
+    if (!status)
+        return status;
+
+    // Triangle corners, as indices in the face vertex list of the whole mesh.
+    MIntArray triangleCounts, triangleOffsets;
+    status = meshFn.getTriangleOffsets(triangleCounts, triangleOffsets);
+    if (!status)
+        return status;
+
+    // Faces without UVs have no entries in uvIds.
+    MIntArray uvCounts, uvIds;
+    if (m_exportUVs)
+    {
+        status = meshFn.getAssignedUVs(uvCounts, uvIds);
+        if (!status)
+            return status;
+    }
 
-    // Triangle buffer.
-    std::vector<asr::Triangle> triangles;
+    // Normal ids are listed for every face vertex.
+    MIntArray normalCounts, normalIds;
+    if (m_exportNormals)
+    {
+        status = meshFn.getNormalIds(normalCounts, normalIds);
+        if (!status)
+            return status;
+    }
+
+    m_triangles.clear();
+    m_triangles.resize(triangleOffsets.length() / 3);
 
-    MIntArray faceVertexIndices;
-    MIntArray faceUVIndices;
-    MIntArray faceNormalIndices;
-    MIntArray triangleVertexIndices;
-    MPointArray trianglePoints;
+    // Build the triangles in a single pass, keeping running offsets
+    // to the first face vertex and uv of each face.
+    unsigned int faceVertexOffset = 0;
+    unsigned int uvOffset = 0;
+    unsigned int cornerIndex = 0;
+    size_t triangleIndex = 0;
 
-    MItMeshPolygon faceIt(mesh);
-    for (;!faceIt.isDone(); faceIt.next())
+    for (unsigned int faceIndex = 0, e = polyVertexCounts.length(); faceIndex < e; ++faceIndex)
     {
         // Get the material index for this face.
         int materialIndex = 0;
         if (m_perFaceAssignments.length() != 0)
-            materialIndex = m_perFaceAssignments[faceIt.index()];
+            materialIndex = m_perFaceAssignments[faceIndex];
 
-        // Collect normal and uv indices for this face.
-        faceUVIndices.clear();
-        faceNormalIndices.clear();
+        const bool faceHasUVs = m_exportUVs && uvCounts[faceIndex] != 0;
 
-        faceIt.getVertices(faceVertexIndices);
-        for (unsigned int i = 0, e = faceVertexIndices.length(); i < e; ++i)
+        for (int i = 0, numTris = triangleCounts[faceIndex]; i < numTris; ++i)
         {
+            const unsigned int o0 = triangleOffsets[cornerIndex++];
+            const unsigned int o1 = triangleOffsets[cornerIndex++];
+            const unsigned int o2 = triangleOffsets[cornerIndex++];
+
+            asr::Triangle& triangle = m_triangles[triangleIndex++];
+            triangle.m_v0 = polyVertices[o0];
+            triangle.m_v1 = polyVertices[o1];
+            triangle.m_v2 = polyVertices[o2];
+            triangle.m_pa = materialIndex;
+
             if (m_exportUVs)
             {
-                int uvIndex;
-                status = faceIt.getUVIndex(static_cast<int>(i), uvIndex);
-                faceUVIndices.append(uvIndex);
+                // uvIds skips the faces without UVs, index it relative to the face.
+                triangle.m_a0 = faceHasUVs ? uvIds[uvOffset + o0 - faceVertexOffset] : 0;
+                triangle.m_a1 = faceHasUVs ? uvIds[uvOffset + o1 - faceVertexOffset] : 0;
+                triangle.m_a2 = faceHasUVs ? uvIds[uvOffset + o2 - faceVertexOffset] : 0;
             }
 
             if (m_exportNormals)
             {
-                unsigned int normalIndex = faceIt.normalIndex(static_cast<int>(i), &status);
-                faceNormalIndices.append(normalIndex);
+                triangle.m_n0 = normalIds[o0];
+                triangle.m_n1 = normalIds[o1];
+                triangle.m_n2 = normalIds[o2];
             }
         }
 
-        // Match the triangle indices to the face indices.
-        int numTris;
-        faceIt.numTriangles(numTris);
-        for (int i = 0; i < numTris; ++i)
-        {
-            trianglePoints.clear();
-            triangleVertexIndices.clear();
-            faceIt.getTriangle(i, trianglePoints, triangleVertexIndices);
+        faceVertexOffset += polyVertexCounts[faceIndex];
 
-            int triangleVertexOffset[3] = {-1, -1, -1};
-            for (unsigned int j = 0, je = faceVertexIndices.length(); j < je; ++j)
-            {
-                if (faceVertexIndices[j] == triangleVertexIndices[0])
-                    triangleVertexOffset[0] = j;
-                else if (faceVertexIndices[j] == triangleVertexIndices[1])
-                    triangleVertexOffset[1] = j;
-                else if (faceVertexIndices[j] == triangleVertexIndices[2])
-                    triangleVertexOffset[2] = j;
-            }
-
-            asr::Triangle triangle(
-                faceVertexIndices[triangleVertexOffset[0]],
-                faceVertexIndices[triangleVertexOffset[1]],
-                faceVertexIndices[triangleVertexOffset[2]],
-                materialIndex);
-
-            if (m_exportUVs)
-            {
-                triangle.m_a0 = faceUVIndices[triangleVertexOffset[0]];
-                triangle.m_a1 = faceUVIndices[triangleVertexOffset[1]];
-                triangle.m_a2 = faceUVIndices[triangleVertexOffset[2]];
-            }
+        if (m_exportUVs)
+            uvOffset += uvCounts[faceIndex];
+    }
 
-            if (m_exportNormals)
-            {
-                triangle.m_n0 = faceNormalIndices[triangleVertexOffset[0]];
-                triangle.m_n1 = faceNormalIndices[triangleVertexOffset[1]];
-                triangle.m_n2 = faceNormalIndices[triangleVertexOffset[2]];
-            }
+    assert(triangleIndex == m_triangles.size());
 
-            triangles.push_back(triangle);
+#ifndef NDEBUG
+    // Check the bulk topology against the per-face triangle query.
+    triangleIndex = 0;
+    for (int faceIndex = 0, e = static_cast<int>(polyVertexCounts.length()); faceIndex < e; ++faceIndex)
+    {
+        for (int i = 0, numTris = triangleCounts[faceIndex]; i < numTris; ++i)
+        {
+            int vertexList[3];
+            status = meshFn.getPolygonTriangleVertices(faceIndex, i, vertexList);
+            assert(status);
+
+            const asr::Triangle& triangle = m_triangles[triangleIndex++];
+            assert(static_cast<int>(triangle.m_v0) == vertexList[0]);
+            assert(static_cast<int>(triangle.m_v1) == vertexList[1]);
+            assert(static_cast<int>(triangle.m_v2) == vertexList[2]);
         }
     }
+#endif
 
-    // Copy triangles to the mesh.
-    m_mesh->reserve_triangles(triangles.size());
-    for (size_t i = 0, e = triangles.size(); i < e; ++i)
-        m_mesh->push_triangle(triangles[i]);
+    return MS::kSuccess;
 }
 
-void MeshExporter::exportGeometry(MObject mesh)
+void MeshExporter::extractGeometry(MObject mesh)
 {
     MStatus status;
     MFnMesh meshFn(mesh);
 
+    m_meshKeys.push_back(MeshKey());
+    MeshKey& key = m_meshKeys.back();
+
     // Vertices.
-    m_mesh->reserve_vertices(meshFn.numVertices());
     {
         const float* p = meshFn.getRawPoints(&status);
-        for (size_t i = 0, e = meshFn.numVertices(); i < e; ++i, p += 3)
-            m_mesh->push_vertex(asr::GVector3(p[0], p[1], p[2]));
+        key.m_points.assign(p, p + 3 * meshFn.numVertices());
     }
 
-    if (m_exportUVs)
+    if (m_exportNormals)
     {
-        m_mesh->reserve_tex_coords(meshFn.numUVs());
-        MFloatArray u, v;
-        status = meshFn.getUVs(u, v);
-        for (int i = 0, e = meshFn.numUVs(); i < e; ++i)
-            m_mesh->push_tex_coords(asr::GVector2(u[i], v[i]));
+        const float* p = meshFn.getRawNormals(&status);
+        key.m_normals.assign(p, p + 3 * meshFn.numNormals());
     }
 
-    if (m_exportNormals)
+    // UVs are not animated, we only need them once.
+    if (m_exportUVs && m_meshKeys.size() == 1)
     {
-        const asr::GVector3 Y(0.0f, 1.0f, 0.0f);
-        m_mesh->reserve_vertex_normals(meshFn.numNormals());
-        const float* p = meshFn.getRawNormals(&status);
+        MFloatArray u, v;
+        status = meshFn.getUVs(u, v);
 
-        for (int i = 0, e = meshFn.numNormals(); i < e; ++i, p += 3)
+        m_uvs.resize(2 * u.length());
+        for (unsigned int i = 0, e = u.length(); i < e; ++i)
         {
-            asr::GVector3 n(p[0], p[1], p[2]);
-            m_mesh->push_vertex_normal(asf::safe_normalize(n, Y));
+            m_uvs[2 * i] = u[i];
+            m_uvs[2 * i + 1] = v[i];
         }
     }
 }
 
-void MeshExporter::exportMeshKey(MObject mesh)
+void MeshExporter::copyTopologyToMesh()
 {
-    MStatus status;
-    MFnMesh meshFn(mesh);
+    m_mesh->reserve_triangles(m_triangles.size());
+    for (size_t i = 0, e = m_triangles.size(); i < e; ++i)
+        m_mesh->push_triangle(m_triangles[i]);
 
-    if (m_shapeExportStep == 1)
-    {
-        assert(m_isDeforming);
-        assert(m_numMeshKeys > 1);
+    m_mesh->reserve_tex_coords(m_uvs.size() / 2);
+    for (size_t i = 0, e = m_uvs.size(); i < e; i += 2)
+        m_mesh->push_tex_coords(asr::GVector2(m_uvs[i], m_uvs[i + 1]));
+}
 
-        // Reserve number of keys.
-        m_mesh->set_motion_segment_count(m_numMeshKeys - 1);
+void MeshExporter::copyKeyToMesh(const MeshKey& key)
+{
+    // Vertices.
+    m_mesh->reserve_vertices(key.m_points.size() / 3);
+    {
+        const float* p = key.m_points.data();
+        for (size_t i = 0, e = key.m_points.size() / 3; i < e; ++i, p += 3)
+            m_mesh->push_vertex(asr::GVector3(p[0], p[1], p[2]));
     }
 
-    // Vertices.
+    // Normals.
+    const asr::GVector3 Y(0.0f, 1.0f, 0.0f);
+    m_mesh->reserve_vertex_normals(key.m_normals.size() / 3);
     {
-        const float* p = meshFn.getRawPoints(&status);
-        for (size_t i = 0, e = meshFn.numVertices(); i < e; ++i, p += 3)
+        const float* p = key.m_normals.data();
+        for (size_t i = 0, e = key.m_normals.size() / 3; i < e; ++i, p += 3)
         {
-            m_mesh->set_vertex_pose(
-                i,
-                m_shapeExportStep - 1,
-                asr::GVector3(p[0], p[1], p[2]));
+            asr::GVector3 n(p[0], p[1], p[2]);
+            m_mesh->push_vertex_normal(asf::safe_normalize(n, Y));
         }
     }
+}
 
-    if (m_exportNormals)
+void MeshExporter::copyKeyToMeshPose(const MeshKey& key, const size_t pose)
+{
+    // Vertices.
     {
-        const asr::GVector3 Y(0.0f, 1.0f, 0.0f);
-        m_mesh->reserve_vertex_normals(meshFn.numNormals());
-        const float* p = meshFn.getRawNormals(&status);
+        const float* p = key.m_points.data();
+        for (size_t i = 0, e = key.m_points.size() / 3; i < e; ++i, p += 3)
+            m_mesh->set_vertex_pose(i, pose, asr::GVector3(p[0], p[1], p[2]));
+    }
 
-        for (size_t i = 0, e = meshFn.numNormals(); i < e; ++i, p += 3)
+    // Normals.
+    const asr::GVector3 Y(0.0f, 1.0f, 0.0f);
+    {
+        const float* p = key.m_normals.data();
+        for (size_t i = 0, e = key.m_normals.size() / 3; i < e; ++i, p += 3)
         {
             asr::GVector3 n(p[0], p[1], p[2]);
-            m_mesh->set_vertex_normal_pose(
-                i,
-                m_shapeExportStep - 1,
-                asf::safe_normalize(n, Y));
+            m_mesh->set_vertex_normal_pose(i, pose, asf::safe_normalize(n, Y));
         }
     }
 }
+
+void MeshExporter::hashTopology(MurmurHash& hash) const
+{
+    // The collected buffers are contiguous, hash them in bulk.
+    hash.append(m_uvs.size());
+    hash.append(m_uvs.data(), m_uvs.size());
+
+    hash.append(m_triangles.size());
+    hash.append(m_triangles.data(), m_triangles.size());
+
+    if (!m_frontMaterialMappings.empty())
+    {
+        for (auto it(m_frontMaterialMappings.begin()), e(m_frontMaterialMappings.end()); it != e; ++it)
+            hash.append(it.key());
+    }
+    else
+        hash.append("default");
+
+    // Tangents are computed from the other data, only their presence matters.
+    hash.append(m_smoothTangents);
+}
+
+void MeshExporter::hashKey(const MeshKey& key, MurmurHash& hash) const
+{
+    hash.append(key.m_points.size());
+    hash.append(key.m_points.data(), key.m_points.size());
+
+    hash.append(key.m_normals.size());
+    hash.append(key.m_normals.data(), key.m_normals.size());
+}
+
+bool MeshExporter::writeMeshFile(const MeshKey& key)
+{
+    MurmurHash meshHash;
+    hashTopology(meshHash);
+    hashKey(key, meshHash);
+
+    const char* extension = ".binarymesh";
+    const std::string fileName = std::string("_geometry/") + meshHash.toString() + extension;
+
+    bfs::path projectPath = project().search_paths().get_root_path().c_str();
+    bfs::path p = projectPath / fileName;
+
+    // Write a geom file for the object if needed.
+    bool succeeded = false;
+    if (claimMeshFile(p, succeeded))
+    {
+        succeeded = asr::MeshObjectWriter::write(*m_mesh, "mesh", p.string().c_str());
+        releaseMeshFile(p, succeeded);
+    }
+    else if (succeeded)
+    {
+        RENDERER_LOG_INFO(
+            "Mesh file for object %s already exists.",
+            m_mesh->get_name());
+    }
+
+    if (!succeeded)
+    {
+        RENDERER_LOG_ERROR(
+            "Couldn't export mesh file for object %s.",
+            m_mesh->get_name());
+        return false;
+    }
+
+    m_fileNames.push_back(fileName);
+
+    // The hash of the first motion step is the base of the mesh hash.
+    if (m_fileNames.size() == 1)
+    {
+        m_hash = meshHash;
+        m_hash.append(m_mesh->get_parameters());
+        m_hash.append(m_frontMaterialMappings);
+        m_hash.append(m_backMaterialMappings);
+    }
+
+    return true;
+}
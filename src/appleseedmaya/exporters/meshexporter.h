@@ -64,6 +64,10 @@ class MeshExporter
       renderer::Project&                                project,
       AppleseedSession::SessionMode                     sessionMode);
 
+    // Forget the mesh files written or failed by previous conversions.
+    // Must be called before converting entities, not during.
+    static void resetMeshFiles();
+
     ~MeshExporter() override;
 
     void createExporters(const AppleseedSession::IExporterFactory& exporter_factory) override;
@@ -74,8 +78,12 @@ class MeshExporter
 
     void exportShapeMotionStep(float time) override;
 
+    void convertEntities() override;
+
     void flushEntities() override;
 
+    void removeEntities() override;
+
     bool supportsInstancing() const override;
 
     MurmurHash hash() const override;
@@ -97,12 +105,25 @@ class MeshExporter
     int getSmoothLevel(MStatus* ReturnStatus = nullptr) const;
     MeshAndData getFinalMesh(MStatus* ReturnStatus = nullptr) const;
 
+    // Geometry data collected from Maya for a single motion step.
+    struct MeshKey
+    {
+        std::vector<float>  m_points;
+        std::vector<float>  m_normals;
+    };
+
     void createMaterialSlots();
-    void fillTopology(MObject mesh);
-    void exportGeometry(MObject mesh);
-    void exportMeshKey(MObject mesh);
+    MStatus fillTopology(MObject mesh);
+    void extractGeometry(MObject mesh);
+    void copyTopologyToMesh();
+    void copyKeyToMesh(const MeshKey& key);
+    void copyKeyToMeshPose(const MeshKey& key, const size_t pose);
+    void hashTopology(MurmurHash& hash) const;
+    void hashKey(const MeshKey& key, MurmurHash& hash) const;
+    bool writeMeshFile(const MeshKey& key);
 
     AppleseedEntityPtr<renderer::MeshObject>    m_mesh;
+    std::string                                 m_meshName;
     renderer::ParamArray                        m_meshParams;
     bool                                        m_exportUVs;
     bool                                        m_exportNormals;
@@ -114,5 +135,8 @@ class MeshExporter
     size_t                                      m_shapeExportStep;
     AlphaMapExporterPtr                         m_alphaMapExporter;
     MurmurHash                                  m_hash;
+    std::vector<renderer::Triangle>             m_triangles;
+    std::vector<float>                          m_uvs;
+    std::vector<MeshKey>                        m_meshKeys;
 };
 
@@ -32,6 +32,7 @@
 // appleseed-maya headers.
 #include "appleseedmaya/attributeutils.h"
 #include "appleseedmaya/exporters/exporterfactory.h"
+#include "appleseedmaya/shaderparamencoder.h"
 
 // Build options header.
 #include "foundation/core/buildoptions.h"
@@ -46,9 +47,6 @@
 #include <maya/MMatrix.h>
 #include "appleseedmaya/_endmayaheaders.h"
 
-// Standard headers.
-#include <sstream>
-
 namespace asf = foundation;
 namespace asr = renderer;
 
@@ -82,12 +80,11 @@ void Place3dTextureExporter::exportShaderParameters(
     MDagPath::getAPathTo(node(), dagPath);
     MMatrix matrixValue = dagPath.inclusiveMatrixInverse();
 
-    std::stringstream ss;
-    ss << "matrix ";
+    ShaderParamEncoder encoder("matrix");
     for (int i = 0; i < 4; ++i)
         for (int j = 0; j < 4; ++j)
-            ss << matrixValue[i][j] << " ";
-    shaderParams.insert("inclusiveMatrixInverse", ss.str().c_str());
+            encoder.add(matrixValue[i][j]);
+    shaderParams.insert("inclusiveMatrixInverse", encoder.c_str());
 
     // Handle the rest of the parameters.
     ShadingNodeExporter::exportShaderParameters(
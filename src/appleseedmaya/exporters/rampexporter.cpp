@@ -48,7 +48,6 @@
 
 // Standard headers.
 #include <algorithm>
-#include <sstream>
 #include <vector>
 
 namespace asf = foundation;
@@ -85,27 +84,10 @@ void RampExporter::exportParameterValue(
 
     if (paramInfo.paramName == "in_position")
     {
-        MPlug plug = depNodeFn.findPlug("colorEntryList", /*wantNetworkedPlug=*/ false, &status);
-
         std::vector<RampEntry<MColor>> rampColors;
-        rampColors.reserve(plug.numElements());
-
-        for (unsigned int i = 0, e = plug.numElements(); i < e; ++i)
-        {
-            MPlug entry = plug.elementByPhysicalIndex(i);
-            MPlug position = entry.child(0);
-            MPlug color = entry.child(1);
-
-            float p;
-            AttributeUtils::get(position, p);
-
-            MColor c;
-            AttributeUtils::get(color, c);
+        getRampEntries(depNodeFn.findPlug("colorEntryList", /*wantNetworkedPlug=*/ false, &status), rampColors);
 
-            rampColors.push_back(RampEntry<MColor>(i, p, c));
-        }
-
-        plug = depNodeFn.findPlug("type", /*wantNetworkedPlug=*/ false, &status);
+        MPlug plug = depNodeFn.findPlug("type", /*wantNetworkedPlug=*/ false, &status);
         int rampType;
         AttributeUtils::get(plug, rampType);
 
@@ -128,12 +110,12 @@ void RampExporter::exportParameterValue(
             std::sort(rampColors.begin(), rampColors.end());
         }
 
-        std::string values;
-        std::string positions;
-        serializeRamp(rampColors, values, positions);
-
-        shaderParams.insert("in_position", positions.c_str());
-        shaderParams.insert("in_color"   , values.c_str());
+        exportRamp(
+            rampColors,
+            "in_position",
+            "in_color",
+            nullptr,
+            shaderParams);
     }
     else if (paramInfo.paramName == "in_color")
     {
@@ -32,6 +32,7 @@
 // appleseed-maya headers.
 #include "appleseedmaya/attributeutils.h"
 #include "appleseedmaya/exporters/exporterfactory.h"
+#include "appleseedmaya/ramputils.h"
 #include "appleseedmaya/shadingnodemetadata.h"
 
 // Build options header.
@@ -47,34 +48,11 @@
 
 // Standard headers.
 #include <algorithm>
-#include <sstream>
 #include <vector>
 
 namespace asf = foundation;
 namespace asr = renderer;
 
-namespace
-{
-    struct RemapColorEntry
-    {
-        RemapColorEntry(float pos, float val, int in)
-          : m_pos(pos)
-          , m_value(val)
-          , m_interp(in)
-        {
-        }
-
-        bool operator<(const RemapColorEntry& other) const
-        {
-            return m_pos < other.m_pos;
-        }
-
-        float   m_pos;
-        float   m_value;
-        int     m_interp;
-    };
-}
-
 void RemapColorExporter::registerExporter()
 {
     NodeExporterFactory::registerShadingNodeExporter(
@@ -106,141 +84,39 @@ void RemapColorExporter::exportParameterValue(
 
     if (paramInfo.paramName == "in_red_Position")
     {
-        MPlug plug = depNodeFn.findPlug("red", /*wantNetworkedPlug=*/ false, &status);
-
-        std::vector<RemapColorEntry> remapRed;
-        remapRed.reserve(plug.numElements());
-
-        for (unsigned int i = 0, e = plug.numElements(); i < e; ++i)
-        {
-            MPlug entry = plug.elementByPhysicalIndex(i);
-            MPlug position = entry.child(0);
-            MPlug value = entry.child(1);
-            MPlug interp = entry.child(2);
-
-            float p;
-            AttributeUtils::get(position, p);
-
-            float v;
-            AttributeUtils::get(value, v);
-
-            int in;
-            AttributeUtils::get(interp, in);
-
-            remapRed.push_back(RemapColorEntry(p, v, in));
-        }
-
-        std::stringstream ssp;
-        ssp << "float[] ";
-
-        std::stringstream ssv;
-        ssv << "float[] ";
-
-        std::stringstream ssi;
-        ssi << "int[] ";
-
-        for (size_t i = 0, e = remapRed.size(); i < e; ++i)
-        {
-            ssp << remapRed[i].m_pos    << " ";
-            ssv << remapRed[i].m_value  << " ";
-            ssi << remapRed[i].m_interp << " ";
-        }
-
-        shaderParams.insert("in_red_Position"  , ssp.str().c_str());
-        shaderParams.insert("in_red_FloatValue", ssv.str().c_str());
-        shaderParams.insert("in_red_Interp"    , ssi.str().c_str());
+        std::vector<RampEntry<float>> entries;
+        getRampEntries(depNodeFn.findPlug("red", /*wantNetworkedPlug=*/ false, &status), entries);
+
+        exportRamp(
+            entries,
+            "in_red_Position",
+            "in_red_FloatValue",
+            "in_red_Interp",
+            shaderParams);
     }
     else if (paramInfo.paramName == "in_green_Position")
     {
-        MPlug plug = depNodeFn.findPlug("green", /*wantNetworkedPlug=*/ false, &status);
-
-        std::vector<RemapColorEntry> remapGreen;
-        remapGreen.reserve(plug.numElements());
-
-        for (unsigned int i = 0, e = plug.numElements(); i < e; ++i)
-        {
-            MPlug entry = plug.elementByPhysicalIndex(i);
-            MPlug position = entry.child(0);
-            MPlug value = entry.child(1);
-            MPlug interp = entry.child(2);
-
-            float p;
-            AttributeUtils::get(position, p);
-
-            float v;
-            AttributeUtils::get(value, v);
-
-            int in;
-            AttributeUtils::get(interp, in);
-
-            remapGreen.push_back(RemapColorEntry(p, v, in));
-        }
-
-        std::stringstream ssp;
-        ssp << "float[] ";
-
-        std::stringstream ssv;
-        ssv << "float[] ";
-
-        std::stringstream ssi;
-        ssi << "int[] ";
-
-        for (size_t i = 0, e = remapGreen.size(); i < e; ++i)
-        {
-            ssp << remapGreen[i].m_pos    << " ";
-            ssv << remapGreen[i].m_value  << " ";
-            ssi << remapGreen[i].m_interp << " ";
-        }
-
-        shaderParams.insert("in_green_Position"  , ssp.str().c_str());
-        shaderParams.insert("in_green_FloatValue", ssv.str().c_str());
-        shaderParams.insert("in_green_Interp"    , ssi.str().c_str());
+        std::vector<RampEntry<float>> entries;
+        getRampEntries(depNodeFn.findPlug("green", /*wantNetworkedPlug=*/ false, &status), entries);
+
+        exportRamp(
+            entries,
+            "in_green_Position",
+            "in_green_FloatValue",
+            "in_green_Interp",
+            shaderParams);
     }
     else if (paramInfo.paramName == "in_blue_Position")
     {
-        MPlug plug = depNodeFn.findPlug("blue", /*wantNetworkedPlug=*/ false, &status);
-
-        std::vector<RemapColorEntry> remapBlue;
-        remapBlue.reserve(plug.numElements());
-
-        for (unsigned int i = 0, e = plug.numElements(); i < e; ++i)
-        {
-            MPlug entry = plug.elementByPhysicalIndex(i);
-            MPlug position = entry.child(0);
-            MPlug value = entry.child(1);
-            MPlug interp = entry.child(2);
-
-            float p;
-            AttributeUtils::get(position, p);
-
-            float v;
-            AttributeUtils::get(value, v);
-
-            int in;
-            AttributeUtils::get(interp, in);
-
-            remapBlue.push_back(RemapColorEntry(p, v, in));
-        }
-
-        std::stringstream ssp;
-        ssp << "float[] ";
-
-        std::stringstream ssv;
-        ssv << "float[] ";
-
-        std::stringstream ssi;
-        ssi << "int[] ";
-
-        for (size_t i = 0, e = remapBlue.size(); i < e; ++i)
-        {
-            ssp << remapBlue[i].m_pos    << " ";
-            ssv << remapBlue[i].m_value  << " ";
-            ssi << remapBlue[i].m_interp << " ";
-        }
-
-        shaderParams.insert("in_blue_Position"  , ssp.str().c_str());
-        shaderParams.insert("in_blue_FloatValue", ssv.str().c_str());
-        shaderParams.insert("in_blue_Interp"    , ssi.str().c_str());
+        std::vector<RampEntry<float>> entries;
+        getRampEntries(depNodeFn.findPlug("blue", /*wantNetworkedPlug=*/ false, &status), entries);
+
+        exportRamp(
+            entries,
+            "in_blue_Position",
+            "in_blue_FloatValue",
+            "in_blue_Interp",
+            shaderParams);
     }
     else if (
         paramInfo.paramName == "in_red_FloatValue" ||
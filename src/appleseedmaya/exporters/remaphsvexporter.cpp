@@ -32,6 +32,7 @@
 // appleseed-maya headers.
 #include "appleseedmaya/attributeutils.h"
 #include "appleseedmaya/exporters/exporterfactory.h"
+#include "appleseedmaya/ramputils.h"
 #include "appleseedmaya/shadingnodemetadata.h"
 
 // Build options header.
@@ -47,34 +48,11 @@
 
 // Standard headers.
 #include <algorithm>
-#include <sstream>
 #include <vector>
 
 namespace asf = foundation;
 namespace asr = renderer;
 
-namespace
-{
-    struct RemapHsvEntry
-    {
-        RemapHsvEntry(float pos, float val, int in)
-          : m_pos(pos)
-          , m_value(val)
-          , m_interp(in)
-        {
-        }
-
-        bool operator<(const RemapHsvEntry& other) const
-        {
-            return m_pos < other.m_pos;
-        }
-
-        float   m_pos;
-        float   m_value;
-        int     m_interp;
-    };
-}
-
 void RemapHsvExporter::registerExporter()
 {
     NodeExporterFactory::registerShadingNodeExporter(
@@ -106,141 +84,39 @@ void RemapHsvExporter::exportParameterValue(
 
     if (paramInfo.paramName == "in_hue_Position")
     {
-        MPlug plug = depNodeFn.findPlug("hue", /*wantNetworkedPlug=*/ false, &status);
-
-        std::vector<RemapHsvEntry> remapHue;
-        remapHue.reserve(plug.numElements());
-
-        for (unsigned int i = 0, e = plug.numElements(); i < e; ++i)
-        {
-            MPlug entry = plug.elementByPhysicalIndex(i);
-            MPlug position = entry.child(0);
-            MPlug value = entry.child(1);
-            MPlug interp = entry.child(2);
-
-            float p;
-            AttributeUtils::get(position, p);
-
-            float v;
-            AttributeUtils::get(value, v);
-
-            int in;
-            AttributeUtils::get(interp, in);
-
-            remapHue.push_back(RemapHsvEntry(p, v, in));
-        }
-
-        std::stringstream ssp;
-        ssp << "float[] ";
-
-        std::stringstream ssv;
-        ssv << "float[] ";
-
-        std::stringstream ssi;
-        ssi << "int[] ";
-
-        for (size_t i = 0, e = remapHue.size(); i < e; ++i)
-        {
-            ssp << remapHue[i].m_pos    << " ";
-            ssv << remapHue[i].m_value  << " ";
-            ssi << remapHue[i].m_interp << " ";
-        }
-
-        shaderParams.insert("in_hue_Position"  , ssp.str().c_str());
-        shaderParams.insert("in_hue_FloatValue", ssv.str().c_str());
-        shaderParams.insert("in_hue_Interp"    , ssi.str().c_str());
+        std::vector<RampEntry<float>> entries;
+        getRampEntries(depNodeFn.findPlug("hue", /*wantNetworkedPlug=*/ false, &status), entries);
+
+        exportRamp(
+            entries,
+            "in_hue_Position",
+            "in_hue_FloatValue",
+            "in_hue_Interp",
+            shaderParams);
     }
     else if (paramInfo.paramName == "in_saturation_Position")
     {
-        MPlug plug = depNodeFn.findPlug("saturation", /*wantNetworkedPlug=*/ false, &status);
-
-        std::vector<RemapHsvEntry> remapSaturation;
-        remapSaturation.reserve(plug.numElements());
-
-        for (unsigned int i = 0, e = plug.numElements(); i < e; ++i)
-        {
-            MPlug entry = plug.elementByPhysicalIndex(i);
-            MPlug position = entry.child(0);
-            MPlug value = entry.child(1);
-            MPlug interp = entry.child(2);
-
-            float p;
-            AttributeUtils::get(position, p);
-
-            float v;
-            AttributeUtils::get(value, v);
-
-            int in;
-            AttributeUtils::get(interp, in);
-
-            remapSaturation.push_back(RemapHsvEntry(p, v, in));
-        }
-
-        std::stringstream ssp;
-        ssp << "float[] ";
-
-        std::stringstream ssv;
-        ssv << "float[] ";
-
-        std::stringstream ssi;
-        ssi << "int[] ";
-
-        for (size_t i = 0, e = remapSaturation.size(); i < e; ++i)
-        {
-            ssp << remapSaturation[i].m_pos    << " ";
-            ssv << remapSaturation[i].m_value  << " ";
-            ssi << remapSaturation[i].m_interp << " ";
-        }
-
-        shaderParams.insert("in_saturation_Position"  , ssp.str().c_str());
-        shaderParams.insert("in_saturation_FloatValue", ssv.str().c_str());
-        shaderParams.insert("in_saturation_Interp"    , ssi.str().c_str());
+        std::vector<RampEntry<float>> entries;
+        getRampEntries(depNodeFn.findPlug("saturation", /*wantNetworkedPlug=*/ false, &status), entries);
+
+        exportRamp(
+            entries,
+            "in_saturation_Position",
+            "in_saturation_FloatValue",
+            "in_saturation_Interp",
+            shaderParams);
     }
     else if (paramInfo.paramName == "in_value_Position")
     {
-        MPlug plug = depNodeFn.findPlug("value", /*wantNetworkedPlug=*/ false, &status);
-
-        std::vector<RemapHsvEntry> remapValue;
-        remapValue.reserve(plug.numElements());
-
-        for (unsigned int i = 0, e = plug.numElements(); i < e; ++i)
-        {
-            MPlug entry = plug.elementByPhysicalIndex(i);
-            MPlug position = entry.child(0);
-            MPlug value = entry.child(1);
-            MPlug interp = entry.child(2);
-
-            float p;
-            AttributeUtils::get(position, p);
-
-            float v;
-            AttributeUtils::get(value, v);
-
-            int in;
-            AttributeUtils::get(interp, in);
-
-            remapValue.push_back(RemapHsvEntry(p, v, in));
-        }
-
-        std::stringstream ssp;
-        ssp << "float[] ";
-
-        std::stringstream ssv;
-        ssv << "float[] ";
-
-        std::stringstream ssi;
-        ssi << "int[] ";
-
-        for (size_t i = 0, e = remapValue.size(); i < e; ++i)
-        {
-            ssp << remapValue[i].m_pos    << " ";
-            ssv << remapValue[i].m_value  << " ";
-            ssi << remapValue[i].m_interp << " ";
-        }
-
-        shaderParams.insert("in_value_Position"  , ssp.str().c_str());
-        shaderParams.insert("in_value_FloatValue", ssv.str().c_str());
-        shaderParams.insert("in_value_Interp"    , ssi.str().c_str());
+        std::vector<RampEntry<float>> entries;
+        getRampEntries(depNodeFn.findPlug("value", /*wantNetworkedPlug=*/ false, &status), entries);
+
+        exportRamp(
+            entries,
+            "in_value_Position",
+            "in_value_FloatValue",
+            "in_value_Interp",
+            shaderParams);
     }
     else if (
         paramInfo.paramName == "in_hue_FloatValue" ||
@@ -32,6 +32,7 @@
 // appleseed-maya headers.
 #include "appleseedmaya/attributeutils.h"
 #include "appleseedmaya/exporters/exporterfactory.h"
+#include "appleseedmaya/ramputils.h"
 #include "appleseedmaya/shadingnodemetadata.h"
 
 // Build options header.
@@ -47,53 +48,11 @@
 
 // Standard headers.
 #include <algorithm>
-#include <sstream>
 #include <vector>
 
 namespace asf = foundation;
 namespace asr = renderer;
 
-namespace
-{
-    struct RemapValueEntry
-    {
-        RemapValueEntry(float pos, float val, int vin)
-          : m_pos(pos)
-          , m_value(val)
-          , m_interp(vin)
-        {
-        }
-
-        bool operator<(const RemapValueEntry& other) const
-        {
-            return m_pos < other.m_pos;
-        }
-
-        float   m_pos;
-        float   m_value;
-        int     m_interp;
-    };
-
-    struct RemapColorsEntry
-    {
-        RemapColorsEntry(float pos, const MColor& col, int cin)
-          : m_pos(pos)
-          , m_color(col)
-          , m_interp(cin)
-        {
-        }
-
-        bool operator<(const RemapColorsEntry& other) const
-        {
-            return m_pos < other.m_pos;
-        }
-
-        float   m_pos;
-        MColor  m_color;
-        int     m_interp;
-    };
-}
-
 void RemapValueExporter::registerExporter()
 {
     NodeExporterFactory::registerShadingNodeExporter(
@@ -125,95 +84,27 @@ void RemapValueExporter::exportParameterValue(
 
     if (paramInfo.paramName == "in_value_Position")
     {
-        MPlug plug = depNodeFn.findPlug("value", /*wantNetworkedPlug=*/ false, &status);
-
-        std::vector<RemapValueEntry> remapValue;
-        remapValue.reserve(plug.numElements());
-
-        for (unsigned int i = 0, e = plug.numElements(); i < e; ++i)
-        {
-            MPlug entry = plug.elementByPhysicalIndex(i);
-            MPlug position = entry.child(0);
-            MPlug value = entry.child(1);
-            MPlug interp = entry.child(2);
-
-            float p;
-            AttributeUtils::get(position, p);
-
-            float v;
-            AttributeUtils::get(value, v);
-
-            int in;
-            AttributeUtils::get(interp, in);
-
-            remapValue.push_back(RemapValueEntry(p, v, in));
-        }
-
-        std::stringstream ssp;
-        ssp << "float[] ";
-
-        std::stringstream ssv;
-        ssv << "float[] ";
-
-        std::stringstream ssi;
-        ssi << "int[] ";
-
-        for (size_t i = 0, e = remapValue.size(); i < e; ++i)
-        {
-            ssp << remapValue[i].m_pos << " ";
-            ssv << remapValue[i].m_value << " ";
-            ssi << remapValue[i].m_interp << " ";
-        }
-
-        shaderParams.insert("in_value_Position"     , ssp.str().c_str());
-        shaderParams.insert("in_value_FloatValue"   , ssv.str().c_str());
-        shaderParams.insert("in_value_Interp"       , ssi.str().c_str());
+        std::vector<RampEntry<float>> entries;
+        getRampEntries(depNodeFn.findPlug("value", /*wantNetworkedPlug=*/ false, &status), entries);
+
+        exportRamp(
+            entries,
+            "in_value_Position",
+            "in_value_FloatValue",
+            "in_value_Interp",
+            shaderParams);
     }
     else if (paramInfo.paramName == "in_color_Position")
     {
-        MPlug plug = depNodeFn.findPlug("color", /*wantNetworkedPlug=*/ false, &status);
-
-        std::vector<RemapColorsEntry> remapColors;
-        remapColors.reserve(plug.numElements());
-
-        for (unsigned int i = 0, e = plug.numElements(); i < e; ++i)
-        {
-            MPlug entry = plug.elementByPhysicalIndex(i);
-            MPlug position = entry.child(0);
-            MPlug color = entry.child(1);
-            MPlug interp = entry.child(2);
-
-            float p;
-            AttributeUtils::get(position, p);
-
-            MColor c;
-            AttributeUtils::get(color, c);
-
-            int in;
-            AttributeUtils::get(interp, in);
-
-            remapColors.push_back(RemapColorsEntry(p, c, in));
-        }
-
-        std::stringstream ssp;
-        ssp << "float[] ";
-
-        std::stringstream ssc;
-        ssc<< "color[] ";
-
-        std::stringstream ssi;
-        ssi << "int[] ";
-
-        for (size_t i = 0, e = remapColors.size(); i < e; ++i)
-        {
-            ssp << remapColors[i].m_pos << " ";
-            ssc << remapColors[i].m_color.r << " " << remapColors[i].m_color.g << " " << remapColors[i].m_color.b << " ";
-            ssi << remapColors[i].m_interp << " ";
-        }
-
-        shaderParams.insert("in_color_Position"     , ssp.str().c_str());
-        shaderParams.insert("in_color_Color"   , ssc.str().c_str());
-        shaderParams.insert("in_color_Interp"       , ssi.str().c_str());
+        std::vector<RampEntry<MColor>> entries;
+        getRampEntries(depNodeFn.findPlug("color", /*wantNetworkedPlug=*/ false, &status), entries);
+
+        exportRamp(
+            entries,
+            "in_color_Position",
+            "in_color_Color",
+            "in_color_Interp",
+            shaderParams);
     }
     else if (
         paramInfo.paramName == "in_value_FloatValue" ||
@@ -56,12 +56,14 @@ ShadingEngineExporter::ShadingEngineExporter(
   : m_sessionMode(sessionMode)
   , m_object(object)
   , m_mainAssembly(mainAssembly)
+  , m_shadingSamples(1)
+  , m_master(nullptr)
 {
 }
 
 ShadingEngineExporter::~ShadingEngineExporter()
 {
-    if (m_sessionMode == AppleseedSession::ProgressiveRenderSession)
+    if (m_sessionMode == AppleseedSession::ProgressiveRenderSession && m_material.get() && m_master == nullptr)
     {
         m_mainAssembly.materials().remove(m_material.get());
 
@@ -102,22 +104,22 @@ void ShadingEngineExporter::createEntities(const AppleseedSession::Options& opti
     const MString appleseedName = depNodeFn.name();
 
     // Create a surface shader if needed.
-    int numSamples = 1;
-    AttributeUtils::get(depNodeFn, "asShadingSamples", numSamples);
+    m_shadingSamples = 1;
+    AttributeUtils::get(depNodeFn, "asShadingSamples", m_shadingSamples);
 
-    if (numSamples > 1)
+    if (m_shadingSamples > 1)
     {
         MString surfaceShaderName = appleseedName + MString("_surface_shader");
         m_surfaceShader.reset(
             asr::PhysicalSurfaceShaderFactory().create(
                 surfaceShaderName.asChar(),
-                asr::ParamArray().insert("lighting_samples", numSamples)));
+                asr::ParamArray().insert("lighting_samples", m_shadingSamples)));
     }
 
     // Create the material.
-    MString materialName = appleseedName + MString("_material");
+    m_materialName = appleseedName + MString("_material");
     m_material.reset(asr::OSLMaterialFactory().create(
-        materialName.asChar(), asr::ParamArray()));
+        m_materialName.asChar(), asr::ParamArray()));
 
     // Set the surface shader in the material.
     if (m_surfaceShader.get())
@@ -126,6 +128,10 @@ void ShadingEngineExporter::createEntities(const AppleseedSession::Options& opti
 
 void ShadingEngineExporter::flushEntities()
 {
+    // Shared materials are flushed by their master.
+    if (m_master)
+        return;
+
     if (m_surfaceShader.get())
         m_mainAssembly.surface_shaders().insert(m_surfaceShader.release());
 
@@ -138,3 +144,53 @@ void ShadingEngineExporter::flushEntities()
 
     m_mainAssembly.materials().insert(m_material.release());
 }
+
+void ShadingEngineExporter::removeEntities()
+{
+    if (m_master)
+        return;
+
+    m_mainAssembly.materials().remove(m_material.get());
+    m_material.reset();
+
+    if (m_surfaceShader.get())
+    {
+        m_mainAssembly.surface_shaders().remove(m_surfaceShader.get());
+        m_surfaceShader.reset();
+    }
+}
+
+const MObject& ShadingEngineExporter::node() const
+{
+    return m_object;
+}
+
+MString ShadingEngineExporter::materialName() const
+{
+    if (m_master)
+        return m_master->materialName();
+
+    return m_materialName;
+}
+
+bool ShadingEngineExporter::isAnimated() const
+{
+    return m_surfaceNetworkExporter && m_surfaceNetworkExporter->isAnimated();
+}
+
+MurmurHash ShadingEngineExporter::hash() const
+{
+    MurmurHash hash;
+    hash.append(m_shadingSamples);
+
+    if (m_surfaceNetworkExporter)
+        hash.append(m_surfaceNetworkExporter->hash().toString());
+
+    return hash;
+}
+
+void ShadingEngineExporter::useSharedMaterial(const ShadingEngineExporter& master)
+{
+    assert(&master != this);
+    m_master = &master;
+}
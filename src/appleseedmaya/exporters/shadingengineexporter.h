@@ -34,6 +34,7 @@
 // appleseed-maya headers.
 #include "appleseedmaya/appleseedsession.h"
 #include "appleseedmaya/exporters/shadingnetworkexporterfwd.h"
+#include "appleseedmaya/murmurhash.h"
 #include "appleseedmaya/utils.h"
 
 // Build options header.
@@ -49,6 +50,7 @@
 // Maya headers.
 #include "appleseedmaya/_beginmayaheaders.h"
 #include <maya/MObject.h>
+#include <maya/MString.h>
 #include "appleseedmaya/_endmayaheaders.h"
 
 // Forward declarations.
@@ -69,6 +71,24 @@ class ShadingEngineExporter
     // Flush entities to the renderer.
     void flushEntities();
 
+    // Remove the flushed material and surface shader from the assembly.
+    void removeEntities();
+
+    // Return the shading engine node.
+    const MObject& node() const;
+
+    // Return the name of the material used by this shading engine.
+    MString materialName() const;
+
+    // Return true if the surface shading network is animated.
+    bool isAnimated() const;
+
+    // Compute a hash of the material and its surface shading network.
+    MurmurHash hash() const;
+
+    // Reference the material of an identical shading engine instead of flushing our own.
+    void useSharedMaterial(const ShadingEngineExporter& master);
+
   private:
     friend class NodeExporterFactory;
 
@@ -83,5 +103,8 @@ class ShadingEngineExporter
     AppleseedEntityPtr<renderer::Material>          m_material;
     AppleseedEntityPtr<renderer::SurfaceShader>     m_surfaceShader;
     ShadingNetworkExporterPtr                       m_surfaceNetworkExporter;
+    MString                                         m_materialName;
+    int                                             m_shadingSamples;
+    const ShadingEngineExporter*                    m_master;
 };
 
@@ -42,15 +42,25 @@
 
 // appleseed.renderer headers.
 #include "renderer/api/scene.h"
+#include "renderer/api/shadergroup.h"
+#include "renderer/api/utility.h"
+
+// appleseed.foundation headers.
+#include "foundation/string/string.h"
 
 // Maya headers.
 #include "appleseedmaya/_beginmayaheaders.h"
+#include <maya/MAnimUtil.h>
 #include <maya/MItDependencyGraph.h>
 #include <maya/MFnDependencyNode.h>
 #include "appleseedmaya/_endmayaheaders.h"
 
 // Standard headers.
 #include <algorithm>
+#include <cstddef>
+#include <map>
+#include <string>
+#include <vector>
 
 namespace asf = foundation;
 namespace asr = renderer;
@@ -77,6 +87,203 @@ namespace
             nodeTypeName.asChar());
         return status;
     }
+
+    //
+    // Shader group optimization.
+    //
+    // OSL executes layers lazily, so layers the last layer does not
+    // depend on never run, but they are still loaded and optimized when
+    // the shader group is compiled, and identical adaptors are each run
+    // once. Before flushing a network we simplify the graph of layers:
+    //
+    // - Identical adaptor layers reading the same inputs are merged.
+    // - Layers that do not contribute to the last layer are dropped.
+    //
+    // Adaptors are only created when some of their inputs are connected,
+    // so there are no constant adaptors to fold here; OSL's own optimizer
+    // folds constant layers when the group is compiled.
+    //
+
+    struct LayerInfo
+    {
+        std::string         m_type;
+        std::string         m_shader;
+        std::string         m_name;
+        asr::ParamArray     m_params;
+        bool                m_used;
+    };
+
+    struct ConnectionInfo
+    {
+        std::string         m_srcLayer;
+        std::string         m_srcParam;
+        std::string         m_dstLayer;
+        std::string         m_dstParam;
+    };
+
+    // Adaptor layers created by the shading node exporters.
+    bool isAdaptorLayer(const LayerInfo& layer)
+    {
+        return layer.m_name.compare(0, 2, "__") == 0;
+    }
+
+    std::string layerSignature(
+        const LayerInfo&                    layer,
+        const std::vector<ConnectionInfo>&  connections)
+    {
+        std::string signature = layer.m_type + '|' + layer.m_shader + '|';
+
+        for (auto it = layer.m_params.strings().begin(), e = layer.m_params.strings().end(); it != e; ++it)
+        {
+            signature += it.key();
+            signature += '=';
+            signature += it.value();
+            signature += ';';
+        }
+
+        std::vector<std::string> inputs;
+        for (const ConnectionInfo& c : connections)
+        {
+            if (c.m_dstLayer == layer.m_name)
+                inputs.push_back(c.m_dstParam + '<' + c.m_srcLayer + '.' + c.m_srcParam);
+        }
+
+        std::sort(inputs.begin(), inputs.end());
+
+        for (const std::string& input : inputs)
+            signature += '|' + input;
+
+        return signature;
+    }
+
+    void optimizeShaderGroup(asr::ShaderGroup& shaderGroup)
+    {
+        std::vector<LayerInfo> layers;
+        std::vector<ConnectionInfo> connections;
+
+        for (auto it = shaderGroup.shaders().begin(), e = shaderGroup.shaders().end(); it != e; ++it)
+        {
+            LayerInfo layer;
+            layer.m_type = it->get_type();
+            layer.m_shader = it->get_shader();
+            layer.m_name = it->get_layer();
+            layer.m_params = it->get_parameters();
+            layer.m_used = true;
+            layers.push_back(layer);
+        }
+
+        for (auto it = shaderGroup.shader_connections().begin(), e = shaderGroup.shader_connections().end(); it != e; ++it)
+        {
+            ConnectionInfo connection;
+            connection.m_srcLayer = it->get_src_layer();
+            connection.m_srcParam = it->get_src_param();
+            connection.m_dstLayer = it->get_dst_layer();
+            connection.m_dstParam = it->get_dst_param();
+            connections.push_back(connection);
+        }
+
+        if (layers.size() < 2)
+            return;
+
+        std::map<std::string, size_t> layerIndices;
+        for (size_t i = 0, e = layers.size(); i < e; ++i)
+            layerIndices[layers[i].m_name] = i;
+
+        // Merge identical adaptors. Layers are in dependency order,
+        // so merging an adaptor can make its consumers identical too.
+        size_t mergedLayers = 0;
+        std::map<std::string, std::string> signatures;
+        for (LayerInfo& layer : layers)
+        {
+            if (!isAdaptorLayer(layer))
+                continue;
+
+            const std::string signature = layerSignature(layer, connections);
+            const auto it = signatures.find(signature);
+
+            if (it == signatures.end())
+            {
+                signatures[signature] = layer.m_name;
+                continue;
+            }
+
+            for (ConnectionInfo& c : connections)
+            {
+                if (c.m_srcLayer == layer.m_name)
+                    c.m_srcLayer = it->second;
+            }
+
+            ++mergedLayers;
+        }
+
+        // Keep only the layers the last layer depends on.
+        for (LayerInfo& layer : layers)
+            layer.m_used = false;
+
+        std::vector<size_t> stack(1, layers.size() - 1);
+        layers.back().m_used = true;
+
+        while (!stack.empty())
+        {
+            const std::string& layerName = layers[stack.back()].m_name;
+            stack.pop_back();
+
+            for (const ConnectionInfo& c : connections)
+            {
+                if (c.m_dstLayer != layerName)
+                    continue;
+
+                const auto it = layerIndices.find(c.m_srcLayer);
+                if (it != layerIndices.end() && !layers[it->second].m_used)
+                {
+                    layers[it->second].m_used = true;
+                    stack.push_back(it->second);
+                }
+            }
+        }
+
+        size_t removedLayers = 0;
+        for (const LayerInfo& layer : layers)
+        {
+            if (!layer.m_used)
+                ++removedLayers;
+        }
+
+        if (removedLayers == 0)
+            return;
+
+        shaderGroup.clear();
+
+        for (const LayerInfo& layer : layers)
+        {
+            if (layer.m_used)
+            {
+                shaderGroup.add_shader(
+                    layer.m_type.c_str(),
+                    layer.m_shader.c_str(),
+                    layer.m_name.c_str(),
+                    layer.m_params);
+            }
+        }
+
+        for (const ConnectionInfo& c : connections)
+        {
+            if (layers[layerIndices[c.m_dstLayer]].m_used)
+            {
+                shaderGroup.add_connection(
+                    c.m_srcLayer.c_str(),
+                    c.m_srcParam.c_str(),
+                    c.m_dstLayer.c_str(),
+                    c.m_dstParam.c_str());
+            }
+        }
+
+        RENDERER_LOG_DEBUG(
+            "Optimized shader group %s: %s adaptor(s) merged, %s layer(s) removed.",
+            shaderGroup.get_name(),
+            asf::pretty_uint(mergedLayers).c_str(),
+            asf::pretty_uint(removedLayers).c_str());
+    }
 }
 
 ShadingNetworkExporter::ShadingNetworkExporter(
@@ -90,17 +297,21 @@ ShadingNetworkExporter::ShadingNetworkExporter(
   , m_object(object)
   , m_outputPlug(outputPlug)
   , m_mainAssembly(mainAssembly)
+  , m_master(nullptr)
 {
 }
 
 ShadingNetworkExporter::~ShadingNetworkExporter()
 {
-    if (m_sessionMode == AppleseedSession::ProgressiveRenderSession)
+    if (m_sessionMode == AppleseedSession::ProgressiveRenderSession && m_master == nullptr)
         m_mainAssembly.shader_groups().remove(m_shaderGroup.get());
 }
 
 MString ShadingNetworkExporter::shaderGroupName() const
 {
+    if (m_master)
+        return m_master->shaderGroupName();
+
     assert(m_shaderGroup.get());
     return m_shaderGroup->get_name();
 }
@@ -111,6 +322,8 @@ void ShadingNetworkExporter::createEntities()
     MString shaderGroupName = depNodeFn.name() + MString("_shader_group");
     m_shaderGroup = asr::ShaderGroupFactory::create(shaderGroupName.asChar());
 
+    m_nodeExporters.clear();
+    m_namesToExporters.clear();
     createShaderNodeExporters(m_object);
 
     // Create shader entities
@@ -120,6 +333,10 @@ void ShadingNetworkExporter::createEntities()
 
 void ShadingNetworkExporter::flushEntities()
 {
+    // Shared networks are flushed by their master.
+    if (m_master)
+        return;
+
     // Add any extra shader and or connections, depending on the context.
     switch (m_context)
     {
@@ -191,11 +408,77 @@ void ShadingNetworkExporter::flushEntities()
         break;
     }
 
+    optimizeShaderGroup(*m_shaderGroup);
+
     insertEntityWithUniqueName(
         m_mainAssembly.shader_groups(),
         m_shaderGroup);
 }
 
+bool ShadingNetworkExporter::isAnimated() const
+{
+    for (size_t i = 0, e = m_nodeExporters.size(); i < e; ++i)
+    {
+        if (MAnimUtil::isAnimated(m_nodeExporters[i]->node()))
+            return true;
+    }
+
+    return false;
+}
+
+void ShadingNetworkExporter::removeEntities()
+{
+    if (m_shaderGroup.get() && m_master == nullptr)
+        m_mainAssembly.shader_groups().remove(m_shaderGroup.get());
+}
+
+MurmurHash ShadingNetworkExporter::hash() const
+{
+    assert(m_shaderGroup.get());
+
+    MurmurHash hash;
+    hash.append(m_context);
+    hash.append(MFnDependencyNode(m_object).typeName());
+    hash.append(m_outputPlug.partialName());
+
+    // Layers are named after the Maya nodes; hash their indices instead.
+    std::map<std::string, size_t> layerIndices;
+
+    for (auto it = m_shaderGroup->shaders().begin(), e = m_shaderGroup->shaders().end(); it != e; ++it)
+    {
+        const size_t index = layerIndices.size();
+        layerIndices[it->get_layer()] = index;
+
+        hash.append(it->get_type());
+        hash.append(it->get_shader());
+        hash.append(it->get_parameters());
+    }
+
+    for (auto it = m_shaderGroup->shader_connections().begin(), e = m_shaderGroup->shader_connections().end(); it != e; ++it)
+    {
+        hash.append(layerIndices[it->get_src_layer()]);
+        hash.append(it->get_src_param());
+        hash.append(layerIndices[it->get_dst_layer()]);
+        hash.append(it->get_dst_param());
+    }
+
+    return hash;
+}
+
+void ShadingNetworkExporter::useSharedShaderGroup(const ShadingNetworkExporter& master)
+{
+    assert(&master != this);
+    m_master = &master;
+}
+
+void ShadingNetworkExporter::getNodes(MObjectArray& nodes) const
+{
+    nodes.clear();
+
+    for (size_t i = 0, e = m_nodeExporters.size(); i < e; ++i)
+        nodes.append(m_nodeExporters[i]->node());
+}
+
 void ShadingNetworkExporter::createShaderNodeExporters(const MObject& node)
 {
     MStatus status;
@@ -220,7 +503,17 @@ void ShadingNetworkExporter::createShaderNodeExporters(const MObject& node)
             if (paramInfo.isOutput)
                 continue;
 
-            MPlug plug = depNodeFn.findPlug(paramInfo.mayaAttributeName, /*wantNetworkedPlug=*/ false, &status);
+            // Resolve the plug through the attribute table of the node type if possible.
+            MPlug plug;
+            const MObject& attr = shaderInfo->paramAttribute(i);
+            if (!attr.isNull())
+            {
+                plug = MPlug(node, attr);
+                status = MS::kSuccess;
+            }
+            else
+                plug = depNodeFn.findPlug(paramInfo.mayaAttributeName, /*wantNetworkedPlug=*/ false, &status);
+
             if (!status)
             {
                 RENDERER_LOG_WARNING(
@@ -34,6 +34,7 @@
 // appleseed-maya headers.
 #include "appleseedmaya/appleseedsession.h"
 #include "appleseedmaya/exporters/shadingnodeexporterfwd.h"
+#include "appleseedmaya/murmurhash.h"
 #include "appleseedmaya/utils.h"
 
 // Build options header.
@@ -48,6 +49,7 @@
 // Maya headers.
 #include "appleseedmaya/_beginmayaheaders.h"
 #include <maya/MObject.h>
+#include <maya/MObjectArray.h>
 #include <maya/MPlug.h>
 #include <maya/MString.h>
 #include "appleseedmaya/_endmayaheaders.h"
@@ -74,6 +76,22 @@ class ShadingNetworkExporter
     // Flush entities to the renderer.
     void flushEntities();
 
+    // Return true if any node of the shading network is animated.
+    bool isAnimated() const;
+
+    // Remove the flushed shader group from the assembly.
+    void removeEntities();
+
+    // Compute a hash of the shaders, parameter values and connections
+    // of the network, independent of the names of the Maya nodes.
+    MurmurHash hash() const;
+
+    // Reference the shader group of an identical network instead of flushing our own.
+    void useSharedShaderGroup(const ShadingNetworkExporter& master);
+
+    // Return the Maya nodes of the shading network.
+    void getNodes(MObjectArray& nodes) const;
+
   private:
     friend class NodeExporterFactory;
 
@@ -92,6 +110,7 @@ class ShadingNetworkExporter
     MPlug                                       m_outputPlug;
     renderer::Assembly&                         m_mainAssembly;
     AppleseedEntityPtr<renderer::ShaderGroup>   m_shaderGroup;
+    const ShadingNetworkExporter*               m_master;
     std::vector<ShadingNodeExporterPtr>         m_nodeExporters;
     ShadingNodeExporterMap                      m_namesToExporters;
 };
@@ -34,6 +34,7 @@
 #include "appleseedmaya/exporters/exporterfactory.h"
 #include "appleseedmaya/logger.h"
 #include "appleseedmaya/ramputils.h"
+#include "appleseedmaya/shaderparamencoder.h"
 #include "appleseedmaya/shadingnodemetadata.h"
 #include "appleseedmaya/shadingnoderegistry.h"
 
@@ -58,7 +59,6 @@
 
 // Standard headers.
 #include <algorithm>
-#include <sstream>
 #include <vector>
 
 namespace asf = foundation;
@@ -118,6 +118,10 @@ void ShadingNodeExporter::createEntities(ShadingNodeExporterMap& exporters)
     // - Then we need to create the shader itself.
     // - Output adaptor shaders are created as needed.
 
+    // Resolve the plugs of the input parameters once, for both passes.
+    std::vector<MPlug> plugs(shaderInfo.paramInfo.size());
+    std::vector<bool> validPlugs(shaderInfo.paramInfo.size(), false);
+
     // Create adaptor shaders and add component connections first.
     for (size_t i = 0, e = shaderInfo.paramInfo.size(); i < e; ++i)
     {
@@ -127,10 +131,13 @@ void ShadingNodeExporter::createEntities(ShadingNodeExporterMap& exporters)
         if (paramInfo.isOutput)
             continue;
 
-        MPlug plug = depNodeFn.findPlug(paramInfo.mayaAttributeName, /*wantNetworkedPlug=*/ false, &status);
+        plugs[i] = findParamPlug(shaderInfo, i, &status);
         if (!status)
             continue;
 
+        validPlugs[i] = true;
+        const MPlug& plug = plugs[i];
+
         if (hasConnections(plug, true, false))
         {
             // If the attribute is a float attribute,
@@ -262,8 +269,8 @@ void ShadingNodeExporter::createEntities(ShadingNodeExporterMap& exporters)
         if (paramInfo.isOutput)
             continue;
 
-        MPlug plug = depNodeFn.findPlug(paramInfo.mayaAttributeName, /*wantNetworkedPlug=*/ false, &status);
-        if (!status)
+        const MPlug& plug = plugs[i];
+        if (!validPlugs[i])
         {
             RENDERER_LOG_WARNING(
                 "Skipping unknown attribute %s of shading node %s",
@@ -427,7 +434,7 @@ void ShadingNodeExporter::exportShaderParameters(
     for (size_t i = 0, e = shaderInfo.paramInfo.size(); i < e; ++i)
     {
         const OSLParamInfo& paramInfo = shaderInfo.paramInfo[i];
-        MPlug plug = depNodeFn.findPlug(paramInfo.mayaAttributeName, /*wantNetworkedPlug=*/ false, &status);
+        MPlug plug = findParamPlug(shaderInfo, i, &status);
         if (!status)
         {
             RENDERER_LOG_WARNING(
@@ -484,39 +491,61 @@ void ShadingNodeExporter::exportValue(
         "Exporting shading node attr %s.",
         paramInfo.mayaAttributeName.asChar());
 
-    std::stringstream ss;
+    ShaderParamEncoder encoder(paramInfo.paramType.asChar());
 
     if (paramInfo.paramType == "color")
     {
         MColor value;
         if (AttributeUtils::get(plug, value))
-            ss << "color " << value.r << " " << value.g << " " << value.b;
+        {
+            const float values[3] = { value.r, value.g, value.b };
+            if (paramInfo.isDefaultValue(values, 3))
+                return;
+
+            encoder.add(value);
+        }
     }
     else if (paramInfo.paramType == "float")
     {
+        float value;
+        bool valid;
+
         if (paramInfo.units == "degrees")
         {
-            MAngle value(0.0f, MAngle::kDegrees);
-            if (AttributeUtils::get(plug, value))
-                ss << "float " << value.asDegrees();
+            MAngle angle(0.0f, MAngle::kDegrees);
+            valid = AttributeUtils::get(plug, angle);
+            value = static_cast<float>(angle.asDegrees());
         }
         else
+            valid = AttributeUtils::get(plug, value);
+
+        if (valid)
         {
-            float value;
-            if (AttributeUtils::get(plug, value))
-                ss << "float " << value;
+            if (paramInfo.isDefaultValue(&value, 1))
+                return;
+
+            encoder.add(value);
         }
     }
     else if (paramInfo.paramType == "int")
     {
         int value;
-        if (AttributeUtils::get(plug, value))
-            ss << "int " << value;
-        else
+        bool valid = AttributeUtils::get(plug, value);
+
+        if (!valid)
         {
             bool boolValue;
-            if (AttributeUtils::get(plug, boolValue))
-                ss << "int " << (boolValue ? "1" : "0"); // ?: has lower precedence than <<
+            valid = AttributeUtils::get(plug, boolValue);
+            value = boolValue ? 1 : 0;
+        }
+
+        if (valid)
+        {
+            const float floatValue = static_cast<float>(value);
+            if (paramInfo.isDefaultValue(&floatValue, 1))
+                return;
+
+            encoder.add(value);
         }
     }
     else if (paramInfo.paramType == "matrix")
@@ -524,47 +553,57 @@ void ShadingNodeExporter::exportValue(
         MMatrix matrixValue;
         if (AttributeUtils::get(plug, matrixValue))
         {
-            ss << "matrix ";
             for (int i = 0; i < 4; ++i)
                 for (int j = 0; j < 4; ++j)
-                    ss << matrixValue[i][j] << " ";
+                    encoder.add(matrixValue[i][j]);
         }
     }
-    else if (paramInfo.paramType == "normal")
+    else if (
+        paramInfo.paramType == "normal" ||
+        paramInfo.paramType == "point"  ||
+        paramInfo.paramType == "vector")
     {
         MVector value;
         if (AttributeUtils::get(plug, value))
-            ss << "normal " << value.z << " " << value.y << " " << value.z;
-    }
-    else if (paramInfo.paramType == "point")
-    {
-        MPoint value;
-        if (AttributeUtils::get(plug, value))
-            ss << "point " << value.z << " " << value.y << " " << value.z;
+        {
+            const float values[3] =
+            {
+                static_cast<float>(value.x),
+                static_cast<float>(value.y),
+                static_cast<float>(value.z)
+            };
+
+            if (paramInfo.isDefaultValue(values, 3))
+                return;
+
+            encoder.add(values[0]);
+            encoder.add(values[1]);
+            encoder.add(values[2]);
+        }
     }
     else if (paramInfo.paramType == "string")
     {
+        MString value;
+        bool valid;
+
         if (paramInfo.widget == "popup")
         {
             MObject attr = plug.attribute();
             MFnEnumAttribute fnEnumAttr(attr);
-            short shortValue = plug.asShort();
-            MString value = fnEnumAttr.fieldName(shortValue);
-            ss << "string " << value;
+            value = fnEnumAttr.fieldName(plug.asShort());
+            valid = true;
         }
         else
+            valid = AttributeUtils::get(plug, value);
+
+        if (valid)
         {
-            MString value;
-            if (AttributeUtils::get(plug, value))
-                ss << "string " << value;
+            if (paramInfo.isDefaultValue(value))
+                return;
+
+            encoder.add(value);
         }
     }
-    else if (paramInfo.paramType == "vector")
-    {
-        MVector value;
-        if (AttributeUtils::get(plug, value))
-            ss << "vector " << value.x << " " << value.y << " " << value.z;
-    }
     else
     {
         RENDERER_LOG_WARNING(
@@ -573,9 +612,8 @@ void ShadingNodeExporter::exportValue(
             paramInfo.paramType.asChar());
     }
 
-    std::string valueAsString = ss.str();
-    if (!valueAsString.empty())
-        shaderParams.insert(paramInfo.paramName.asChar(), valueAsString.c_str());
+    if (!encoder.empty())
+        shaderParams.insert(paramInfo.paramName.asChar(), encoder.c_str());
 }
 
 void ShadingNodeExporter::exportArrayValue(
@@ -587,65 +625,68 @@ void ShadingNodeExporter::exportArrayValue(
         "Exporting shading node attr %s.",
         paramInfo.mayaAttributeName.asChar());
 
+    const bool isFloatArray = strncmp(paramInfo.paramType.asChar(), "float[", 6) == 0;
+    const bool isIntArray = strncmp(paramInfo.paramType.asChar(), "int[", 4) == 0;
+
+    if (!isFloatArray && !isIntArray)
+    {
+        RENDERER_LOG_WARNING(
+            "Skipping shading node attr %s of type %s.",
+            paramInfo.mayaAttributeName.asChar(),
+            paramInfo.paramType.asChar());
+        return;
+    }
+
+    assert(plug.isCompound());
+
     MStatus status;
     bool valid = true;
 
-    std::stringstream ss;
+    ShaderParamEncoder encoder(isFloatArray ? "float[]" : "int[]");
+    std::vector<float> values;
+    values.reserve(plug.numChildren());
 
-    if (strncmp(paramInfo.paramType.asChar(), "float[", 5) == 0)
+    for (unsigned int i = 0, e = plug.numChildren(); i < e; ++i)
     {
-        assert(plug.isCompound());
+        MPlug childPlug = plug.child(i, &status);
+        if (!status)
+        {
+            valid = false;
+            break;
+        }
 
-        ss << "float[] ";
-        for (unsigned int i = 0, e = plug.numChildren(); i < e; ++i)
+        if (isFloatArray)
         {
-            MPlug childPlug = plug.child(i, &status);
-            if (status)
+            float value;
+            if (!AttributeUtils::get(childPlug, value))
             {
-                float value;
-                if (AttributeUtils::get(childPlug, value))
-                    ss << value << " ";
-                else
-                    valid = false;
-            }
-            else
                 valid = false;
-        }
-    }
-    else if (strncmp(paramInfo.paramType.asChar(), "int[", 4) == 0)
-    {
-        assert(plug.isCompound());
+                break;
+            }
 
-        ss << "int[] ";
-        for (unsigned int i = 0, e = plug.numChildren(); i < e; ++i)
+            encoder.add(value);
+            values.push_back(value);
+        }
+        else
         {
-            MPlug childPlug = plug.child(i, &status);
-            if (status)
+            int value;
+            if (!AttributeUtils::get(childPlug, value))
             {
-                int value;
-                if (AttributeUtils::get(childPlug, value))
-                    ss << value << " ";
-                else
-                    valid = false;
-            }
-            else
                 valid = false;
+                break;
+            }
+
+            encoder.add(value);
+            values.push_back(static_cast<float>(value));
         }
     }
-    else
-    {
-        RENDERER_LOG_WARNING(
-            "Skipping shading node attr %s of type %s.",
-            paramInfo.mayaAttributeName.asChar(),
-            paramInfo.paramType.asChar());
-        return;
-    }
 
     if (valid)
     {
-        std::string valueAsString = ss.str();
-        if (!valueAsString.empty())
-            shaderParams.insert(paramInfo.paramName.asChar(), valueAsString.c_str());
+        if (!values.empty() && paramInfo.isDefaultValue(values.data(), values.size()))
+            return;
+
+        shaderParams.insert(paramInfo.paramName.asChar(), encoder.c_str());
     }
     else
     {
@@ -805,6 +846,28 @@ const OSLShaderInfo& ShadingNodeExporter::getShaderInfo() const
     return *shaderInfo;
 }
 
+MPlug ShadingNodeExporter::findParamPlug(
+    const OSLShaderInfo&                shaderInfo,
+    const size_t                        paramIndex,
+    MStatus*                            status) const
+{
+    const MObject& attr = shaderInfo.paramAttribute(paramIndex);
+
+    if (!attr.isNull())
+    {
+        if (status)
+            *status = MS::kSuccess;
+
+        return MPlug(m_object, attr);
+    }
+
+    MFnDependencyNode depNodeFn(m_object);
+    return depNodeFn.findPlug(
+        shaderInfo.paramInfo[paramIndex].mayaAttributeName,
+        /*wantNetworkedPlug=*/ false,
+        status);
+}
+
 ShadingNodeExporter* ShadingNodeExporter::findExporterForNode(
     ShadingNodeExporterMap&             exporters,
     const MObject&                      node)
@@ -904,9 +967,9 @@ void ShadingNodeExporter::createInputFloatCompoundAdaptorShader(
             float value;
             if (AttributeUtils::get(childPlug, value))
             {
-                std::stringstream ss;
-                ss << "float " << value;
-                params.insert(shaderParamNames[i], ss.str().c_str());
+                ShaderParamEncoder encoder("float");
+                encoder.add(value);
+                params.insert(shaderParamNames[i], encoder.c_str());
             }
         }
     }
@@ -73,6 +73,9 @@ class ShadingNodeExporter
     // Flush entities to the renderer.
     void flushEntities();
 
+    // Return the Maya node exported by this exporter.
+    MObject node() const;
+
   protected:
     ShadingNodeExporter(
         const MObject&                  object,
@@ -107,14 +110,19 @@ class ShadingNodeExporter
         MString&                        layerName,
         MString&                        paramName);
 
-    MObject node() const;
-
     bool hasConnections(const MPlug& plug, const bool asDst, const bool asSrc) const;
     bool hasChildrenConnections(const MPlug& plug, const bool asDst, const bool asSrc) const;
     bool hasElementConnections(const MPlug& plug, const bool asDst, const bool asSrc) const;
 
     const OSLShaderInfo& getShaderInfo() const;
 
+    // Return the plug of a shader parameter. The plug is resolved through
+    // the attribute table of the node type, falling back to a name lookup.
+    MPlug findParamPlug(
+        const OSLShaderInfo&            shaderInfo,
+        const size_t                    paramIndex,
+        MStatus*                        status = nullptr) const;
+
     ShadingNodeExporter* findExporterForNode(
         ShadingNodeExporterMap&         exporters,
         const MObject&                  node);
@@ -41,6 +41,28 @@
 namespace asf = foundation;
 namespace asr = renderer;
 
+namespace
+{
+    void remapMaterialNames(
+        const asf::StringDictionary&    aliases,
+        asf::StringDictionary&          mappings)
+    {
+        asf::StringDictionary result;
+
+        for (auto it = mappings.begin(), e = mappings.end(); it != e; ++it)
+        {
+            const char* materialName = it.value();
+
+            if (aliases.exist(materialName))
+                materialName = aliases.get(materialName);
+
+            result.insert(it.key(), materialName);
+        }
+
+        mappings = result;
+    }
+}
+
 ShapeExporter::ShapeExporter(
     const MDagPath&                 path,
     asr::Project&                   project,
@@ -81,6 +103,32 @@ void ShapeExporter::instanceCreated() const
     m_numInstances++;
 }
 
+void ShapeExporter::remapMaterials(const asf::StringDictionary& aliases)
+{
+    if (aliases.empty())
+        return;
+
+    remapMaterialNames(aliases, m_frontMaterialMappings);
+    remapMaterialNames(aliases, m_backMaterialMappings);
+}
+
+bool ShapeExporter::usesMaterial(const std::set<std::string>& materialNames) const
+{
+    for (auto it = m_frontMaterialMappings.begin(), e = m_frontMaterialMappings.end(); it != e; ++it)
+    {
+        if (materialNames.count(it.value()) != 0)
+            return true;
+    }
+
+    for (auto it = m_backMaterialMappings.begin(), e = m_backMaterialMappings.end(); it != e; ++it)
+    {
+        if (materialNames.count(it.value()) != 0)
+            return true;
+    }
+
+    return false;
+}
+
 asf::AABB3d ShapeExporter::boundingBox() const
 {
     asf::AABB3d bbox = objectSpaceBoundingBox(dagPath());
@@ -89,8 +137,9 @@ asf::AABB3d ShapeExporter::boundingBox() const
 
 void ShapeExporter::exportTransformMotionStep(float time)
 {
-    asf::Matrix4d m = convert(dagPath().inclusiveMatrix());
-    asf::Matrix4d invM = convert(dagPath().inclusiveMatrixInverse());
+    const MMatrix worldMat = worldMatrix(dagPath());
+    asf::Matrix4d m = convert(worldMat);
+    asf::Matrix4d invM = convert(worldMat.inverse());
     asf::Transformd xform(m, invM);
     m_transformSequence.set_transform(time, xform);
 }
@@ -123,6 +172,33 @@ void ShapeExporter::flushEntities()
     }
 }
 
+void ShapeExporter::removeEntities()
+{
+    if (m_objectAssembly.get())
+    {
+        mainAssembly().assemblies().remove(m_objectAssembly.get());
+        mainAssembly().assembly_instances().remove(m_objectAssemblyInstance.get());
+    }
+    else if (m_objectInstance.get())
+        mainAssembly().object_instances().remove(m_objectInstance.get());
+}
+
+bool ShapeExporter::updateTransformEntities()
+{
+    // Interactive sessions always create an assembly instance.
+    if (!m_objectAssemblyInstance.get())
+        return false;
+
+    // Interactive sessions export a single motion step.
+    m_transformSequence.clear();
+    exportTransformMotionStep(0.0f);
+    m_transformSequence.optimize();
+
+    m_objectAssemblyInstance->transform_sequence() = m_transformSequence;
+    m_objectAssemblyInstance->bump_version_id();
+    return true;
+}
+
 void ShapeExporter::shapeAttributesToParams(renderer::ParamArray& params)
 {
 }
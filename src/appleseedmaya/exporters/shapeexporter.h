@@ -40,6 +40,8 @@
 #include "renderer/api/utility.h"
 
 // Standard headers.
+#include <set>
+#include <string>
 #include <vector>
 
 class ShapeExporter
@@ -54,6 +56,10 @@ class ShapeExporter
 
     void flushEntities() override = 0;
 
+    void removeEntities() override;
+
+    bool updateTransformEntities() override;
+
     // Return true if this object can be instanced.
     virtual bool supportsInstancing() const;
 
@@ -63,6 +69,11 @@ class ShapeExporter
     // Called when this object is instanced.
     void instanceCreated() const;
 
+    void remapMaterials(const foundation::StringDictionary& aliases) override;
+
+    // Return true if any of the materials assigned to this shape is in materialNames.
+    bool usesMaterial(const std::set<std::string>& materialNames) const;
+
     // Bounds.
     foundation::AABB3d boundingBox() const override;
 
@@ -32,6 +32,8 @@
 // appleseed-maya headers.
 #include "appleseedmaya/attributeutils.h"
 #include "appleseedmaya/exporters/exporterfactory.h"
+#include "appleseedmaya/renderglobalsnode.h"
+#include "appleseedmaya/utils.h"
 
 // appleseed.renderer headers.
 #include "renderer/api/scene.h"
@@ -41,7 +43,10 @@
 #include <maya/MAnimControl.h>
 #include <maya/MFileObject.h>
 #include <maya/MFnDagNode.h>
+#include <maya/MFnDependencyNode.h>
 #include <maya/MGlobal.h>
+#include <maya/MPlug.h>
+#include <maya/MPlugArray.h>
 #include <maya/MTime.h>
 #include "appleseedmaya/_endmayaheaders.h"
 
@@ -84,7 +89,32 @@ XGenExporter::~XGenExporter()
 
 void XGenExporter::createExporters(const AppleseedSession::IExporterFactory& exporter_factory)
 {
-    // todo: implement this.
+    const unsigned int instanceNumber = dagPath().isInstanced() ? dagPath().instanceNumber() : 0;
+
+    MStatus status;
+    MFnDependencyNode depNodeFn(node(), &status);
+    MPlug plug = depNodeFn.findPlug("instObjGroups", /*wantNetworkedPlug=*/ false, &status);
+    if (!status)
+        return;
+
+    plug = plug.elementByLogicalIndex(instanceNumber);
+
+    // The whole description uses a single material.
+    MPlugArray connections;
+    plug.connectedTo(connections, false, true);
+    if (connections.length() == 0)
+        return;
+
+    MObject shadingEngine = connections[0].node();
+    exporter_factory.createShadingEngineExporter(shadingEngine);
+    depNodeFn.setObject(shadingEngine);
+    m_materialName = depNodeFn.name() + MString("_material");
+}
+
+void XGenExporter::remapMaterials(const asf::StringDictionary& aliases)
+{
+    if (aliases.exist(m_materialName.asChar()))
+        m_materialName = aliases.get(m_materialName.asChar());
 }
 
 namespace
@@ -194,6 +224,12 @@ void XGenExporter::createEntities(
     xgen_args += asf::format(" -description {0}", descriptionName.asChar());
     xgen_args += asf::format(" -world {0};0;0;0;0;{0};0;0;0;0;{0};0;0;0;0;1", getUnitConversionFactor());
 
+    // Level of detail settings, shared by all the patches.
+    asr::ParamArray lodParams;
+    MObject globalsNode;
+    if (getDependencyNodeByName("appleseedRenderGlobals", globalsNode))
+        RenderGlobalsNode::collectXGenLodParameters(globalsNode, lodParams);
+
     for (unsigned int i = 0, e = descriptionPath.childCount(); i < e; ++i)
     {
         MDagPath childDagPath;
@@ -219,6 +255,12 @@ void XGenExporter::createEntities(
             params.insert_path(
                 "parameters.xgen_args", asf::format(xgen_args, patchName.asChar()).c_str());
 
+            for (auto it = lodParams.strings().begin(), e = lodParams.strings().end(); it != e; ++it)
+                params.insert_path((std::string("parameters.") + it.key()).c_str(), it.value());
+
+            if (m_materialName.length() != 0)
+                params.insert_path("parameters.material", m_materialName.asChar());
+
             const asr::AssemblyFactoryRegistrar& assemblyFactories =
                 project().get_factory_registrar<asr::Assembly>();
 
@@ -244,8 +286,9 @@ void XGenExporter::createEntities(
 
 void XGenExporter::exportTransformMotionStep(float time)
 {
-    asf::Matrix4d m = convert(dagPath().inclusiveMatrix());
-    asf::Matrix4d invM = convert(dagPath().inclusiveMatrixInverse());
+    const MMatrix worldMat = worldMatrix(dagPath());
+    asf::Matrix4d m = convert(worldMat);
+    asf::Matrix4d invM = convert(worldMat.inverse());
     asf::Transformd xform(m, invM);
     m_transformSequence.set_transform(time, xform);
 }
@@ -266,3 +309,15 @@ void XGenExporter::flushEntities()
     m_assemblyInstance->transform_sequence() = m_transformSequence;
     mainAssembly().assembly_instances().insert(m_assemblyInstance.release());
 }
+
+bool XGenExporter::isTimeDependent() const
+{
+    // The XGen arguments include the current frame.
+    return true;
+}
+
+void XGenExporter::removeEntities()
+{
+    mainAssembly().assemblies().remove(m_assembly.get());
+    mainAssembly().assembly_instances().remove(m_assemblyInstance.get());
+}
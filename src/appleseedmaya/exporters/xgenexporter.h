@@ -53,6 +53,8 @@ class XGenExporter
 
     void createExporters(const AppleseedSession::IExporterFactory& exporter_factory) override;
 
+    void remapMaterials(const foundation::StringDictionary& aliases) override;
+
     void createEntities(
         const AppleseedSession::Options&                options,
         const AppleseedSession::MotionBlurSampleTimes&  motionBlurSampleTimes) override;
@@ -61,15 +63,19 @@ class XGenExporter
 
     void flushEntities() override;
 
+    bool isTimeDependent() const override;
+
+    void removeEntities() override;
+
   private:
     XGenExporter(
       const MDagPath&                                   path,
       renderer::Project&                                project,
       AppleseedSession::SessionMode                     sessionMode);
 
+    MString                                         m_materialName;
     renderer::TransformSequence                     m_transformSequence;
     AppleseedEntityPtr<renderer::Assembly>          m_assembly;
     AppleseedEntityPtr<renderer::AssemblyInstance>  m_assemblyInstance;
-
 };
 
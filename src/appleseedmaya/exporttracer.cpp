@@ -0,0 +1,350 @@
+
+//
+// This source file is part of appleseed.
+// Visit https://appleseedhq.net/ for additional information and resources.
+//
+// This software is released under the MIT license.
+//
+// Copyright (c) 2016-2019 Esteban Tovagliari, The appleseedhq Organization
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+// Interface header.
+#include "exporttracer.h"
+
+// appleseed-maya headers.
+#include "appleseedmaya/logger.h"
+
+// appleseed.foundation headers.
+#include "foundation/string/string.h"
+
+// Standard headers.
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace asf = foundation;
+
+namespace
+{
+    struct TraceEvent
+    {
+        std::string                             m_category;
+        std::string                             m_name;
+        const char*                             m_phase;
+        std::int64_t                            m_start;    // microseconds
+        std::int64_t                            m_duration; // microseconds
+        size_t                                  m_threadId;
+    };
+
+    struct TraceTotals
+    {
+        TraceTotals()
+          : m_count(0)
+          , m_duration(0)
+        {
+        }
+
+        size_t                                  m_count;
+        std::int64_t                            m_duration;
+    };
+
+    std::mutex                                  g_mutex;
+    bool                                        g_enabled = false;
+    std::chrono::steady_clock::time_point       g_origin;
+    std::vector<TraceEvent>                     g_events;
+
+    std::int64_t toMicroseconds(const std::chrono::steady_clock::duration& d)
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(d).count();
+    }
+
+    std::string escapeJSON(const std::string& s)
+    {
+        std::string result;
+        result.reserve(s.size());
+
+        for (const char c : s)
+        {
+            if (c == '"' || c == '\\')
+                result += '\\';
+
+            result += c;
+        }
+
+        return result;
+    }
+
+    void writeChromeTrace(const std::string& filename)
+    {
+        std::ofstream file(filename.c_str());
+
+        if (!file)
+        {
+            RENDERER_LOG_ERROR("Could not open export trace file %s", filename.c_str());
+            return;
+        }
+
+        file << "{\"traceEvents\":[\n";
+
+        for (size_t i = 0, e = g_events.size(); i < e; ++i)
+        {
+            const TraceEvent& event = g_events[i];
+
+            file << "{\"name\":\"" << escapeJSON(event.m_name) << "\""
+                 << ",\"cat\":\"" << escapeJSON(event.m_category) << "\""
+                 << ",\"ph\":\"X\""
+                 << ",\"ts\":" << event.m_start
+                 << ",\"dur\":" << event.m_duration
+                 << ",\"pid\":1"
+                 << ",\"tid\":" << event.m_threadId;
+
+            if (event.m_phase)
+                file << ",\"args\":{\"phase\":\"" << event.m_phase << "\"}";
+
+            file << (i + 1 < e ? "},\n" : "}\n");
+        }
+
+        file << "]}\n";
+
+        RENDERER_LOG_INFO("Wrote export trace to %s", filename.c_str());
+    }
+
+    template <typename Map>
+    void logTotals(const char* title, const Map& totals, const size_t maxRows)
+    {
+        typedef std::pair<std::string, TraceTotals> Row;
+        std::vector<Row> rows(totals.begin(), totals.end());
+
+        std::sort(
+            rows.begin(),
+            rows.end(),
+            [](const Row& a, const Row& b)
+            {
+                return a.second.m_duration > b.second.m_duration;
+            });
+
+        if (rows.size() > maxRows)
+            rows.resize(maxRows);
+
+        RENDERER_LOG_INFO("%s:", title);
+
+        for (const Row& row : rows)
+        {
+            RENDERER_LOG_INFO(
+                "  %-48s %10s ms  %8s calls",
+                row.first.c_str(),
+                asf::pretty_scalar(static_cast<double>(row.second.m_duration) / 1000.0, 1).c_str(),
+                asf::pretty_uint(row.second.m_count).c_str());
+        }
+    }
+
+    void logSummary()
+    {
+        std::map<std::string, TraceTotals> phases;
+        std::map<std::string, TraceTotals> nodeTypes;
+        std::map<std::string, TraceTotals> nodes;
+
+        for (const TraceEvent& event : g_events)
+        {
+            TraceTotals* totals[2] = {nullptr, nullptr};
+
+            if (event.m_category == "phase")
+                totals[0] = &phases[event.m_name];
+            else
+            {
+                totals[0] = &nodeTypes[event.m_category];
+                totals[1] = &nodes[event.m_name];
+            }
+
+            for (TraceTotals* t : totals)
+            {
+                if (t)
+                {
+                    t->m_count++;
+                    t->m_duration += event.m_duration;
+                }
+            }
+        }
+
+        RENDERER_LOG_INFO("Export trace summary:");
+        logTotals("Export phases", phases, phases.size());
+        logTotals("Exporters by node type", nodeTypes, nodeTypes.size());
+        logTotals("Slowest nodes", nodes, 20);
+    }
+}
+
+namespace ExportTracer
+{
+
+bool enabled()
+{
+    return g_enabled;
+}
+
+std::string traceFilename(const MString& globalsFilename)
+{
+    if (const char* envFilename = std::getenv("APPLESEED_MAYA_EXPORT_TRACE"))
+    {
+        if (*envFilename != '\0')
+            return envFilename;
+    }
+
+    return globalsFilename.asChar();
+}
+
+void addEvent(
+    const std::string&                                  category,
+    const std::string&                                  name,
+    const char*                                         phase,
+    const std::chrono::steady_clock::time_point&        start,
+    const std::chrono::steady_clock::time_point&        end)
+{
+    TraceEvent event;
+    event.m_category = category;
+    event.m_name = name;
+    event.m_phase = phase;
+    event.m_duration = toMicroseconds(end - start);
+    event.m_threadId = std::hash<std::thread::id>()(std::this_thread::get_id());
+
+    std::lock_guard<std::mutex> lock(g_mutex);
+
+    if (g_enabled)
+    {
+        event.m_start = toMicroseconds(start - g_origin);
+        g_events.push_back(std::move(event));
+    }
+}
+
+} // namespace ExportTracer
+
+ScopedExportTrace::ScopedExportTrace(const std::string& filename)
+  : m_active(false)
+{
+    if (filename.empty() || g_enabled)
+        return;
+
+    std::lock_guard<std::mutex> lock(g_mutex);
+    g_events.clear();
+    g_origin = std::chrono::steady_clock::now();
+    g_enabled = true;
+
+    m_filename = filename;
+    m_active = true;
+}
+
+ScopedExportTrace::~ScopedExportTrace()
+{
+    if (!m_active)
+        return;
+
+    std::lock_guard<std::mutex> lock(g_mutex);
+    g_enabled = false;
+
+    writeChromeTrace(m_filename);
+    logSummary();
+    g_events.clear();
+}
+
+ScopedTraceEvent::ScopedTraceEvent()
+  : m_active(false)
+  , m_phase(nullptr)
+{
+}
+
+ScopedTraceEvent::ScopedTraceEvent(const char* phase)
+  : m_active(g_enabled)
+  , m_phase(nullptr)
+{
+    if (m_active)
+    {
+        m_category = "phase";
+        m_name = phase;
+        m_start = std::chrono::steady_clock::now();
+    }
+}
+
+ScopedTraceEvent::ScopedTraceEvent(
+    const MString&                                      nodeType,
+    const MString&                                      nodeName,
+    const char*                                         phase)
+  : m_active(g_enabled)
+  , m_phase(phase)
+{
+    if (m_active)
+    {
+        m_category = nodeType.asChar();
+        m_name = nodeName.asChar();
+        m_start = std::chrono::steady_clock::now();
+    }
+}
+
+ScopedTraceEvent::ScopedTraceEvent(ScopedTraceEvent&& other)
+  : m_active(other.m_active)
+  , m_category(std::move(other.m_category))
+  , m_name(std::move(other.m_name))
+  , m_phase(other.m_phase)
+  , m_start(other.m_start)
+{
+    other.m_active = false;
+}
+
+ScopedTraceEvent& ScopedTraceEvent::operator=(ScopedTraceEvent&& other)
+{
+    if (this != &other)
+    {
+        record();
+
+        m_active = other.m_active;
+        m_category = std::move(other.m_category);
+        m_name = std::move(other.m_name);
+        m_phase = other.m_phase;
+        m_start = other.m_start;
+        other.m_active = false;
+    }
+
+    return *this;
+}
+
+ScopedTraceEvent::~ScopedTraceEvent()
+{
+    record();
+}
+
+void ScopedTraceEvent::record()
+{
+    if (m_active)
+    {
+        ExportTracer::addEvent(
+            m_category,
+            m_name,
+            m_phase,
+            m_start,
+            std::chrono::steady_clock::now());
+
+        m_active = false;
+    }
+}
@@ -0,0 +1,120 @@
+
+//
+// This source file is part of appleseed.
+// Visit https://appleseedhq.net/ for additional information and resources.
+//
+// This software is released under the MIT license.
+//
+// Copyright (c) 2016-2019 Esteban Tovagliari, The appleseedhq Organization
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#pragma once
+
+// Maya headers.
+#include "appleseedmaya/_beginmayaheaders.h"
+#include <maya/MString.h>
+#include "appleseedmaya/_endmayaheaders.h"
+
+// appleseed.foundation headers.
+#include "foundation/core/concepts/noncopyable.h"
+
+// Standard headers.
+#include <chrono>
+#include <string>
+
+//
+// Export tracing.
+//  Records the time spent in each phase of the export and by each exporter.
+//  The events are written as a Chrome trace JSON file (chrome://tracing)
+//  and summarized in the log when the trace ends.
+//
+
+namespace ExportTracer
+{
+
+// Return true if events are being recorded.
+bool enabled();
+
+// Return the trace filename set in the render globals or in the
+// APPLESEED_MAYA_EXPORT_TRACE environment variable, if any.
+std::string traceFilename(const MString& globalsFilename);
+
+// Record a complete event. Thread safe.
+void addEvent(
+    const std::string&                                  category,
+    const std::string&                                  name,
+    const char*                                         phase,
+    const std::chrono::steady_clock::time_point&        start,
+    const std::chrono::steady_clock::time_point&        end);
+
+} // namespace ExportTracer
+
+//
+// Record export events while in scope and write them when leaving it.
+//  Does nothing if the filename is empty or if a trace is already active.
+//
+
+class ScopedExportTrace
+  : public foundation::NonCopyable
+{
+  public:
+    explicit ScopedExportTrace(const std::string& filename);
+    ~ScopedExportTrace();
+
+  private:
+    bool            m_active;
+    std::string     m_filename;
+};
+
+//
+// Record the time spent in a scope as a trace event.
+//
+
+class ScopedTraceEvent
+  : public foundation::NonCopyable
+{
+  public:
+    // Inactive event.
+    ScopedTraceEvent();
+
+    // Export phase.
+    explicit ScopedTraceEvent(const char* phase);
+
+    // Work done by an exporter, by node type and node name.
+    ScopedTraceEvent(
+        const MString&                                  nodeType,
+        const MString&                                  nodeName,
+        const char*                                     phase);
+
+    ScopedTraceEvent(ScopedTraceEvent&& other);
+    ScopedTraceEvent& operator=(ScopedTraceEvent&& other);
+
+    ~ScopedTraceEvent();
+
+  private:
+    void record();
+
+    bool                                                m_active;
+    std::string                                         m_category;
+    std::string                                         m_name;
+    const char*                                         m_phase;
+    std::chrono::steady_clock::time_point               m_start;
+};
@@ -29,6 +29,306 @@
 // Interface header.
 #include "hypershaderenderer.h"
 
+// appleseed-maya headers.
+#include "appleseedmaya/appleseedsession.h"
+#include "appleseedmaya/exporters/exporterfactory.h"
+#include "appleseedmaya/exporters/shadingnetworkexporter.h"
+#include "appleseedmaya/logger.h"
+
+// Build options header.
+#include "foundation/core/buildoptions.h"
+
+// appleseed.renderer headers.
+#include "renderer/api/camera.h"
+#include "renderer/api/environment.h"
+#include "renderer/api/environmentedf.h"
+#include "renderer/api/environmentshader.h"
+#include "renderer/api/frame.h"
+#include "renderer/api/light.h"
+#include "renderer/api/material.h"
+#include "renderer/api/object.h"
+#include "renderer/api/scene.h"
+
+// appleseed.foundation headers.
+#include "foundation/image/image.h"
+#include "foundation/image/tile.h"
+#include "foundation/math/scalar.h"
+#include "foundation/math/transform.h"
+#include "foundation/math/vector.h"
+
+// Maya headers.
+#include "appleseedmaya/_beginmayaheaders.h"
+#include <maya/MFloatArray.h>
+#include <maya/MFnCamera.h>
+#include <maya/MFnDependencyNode.h>
+#include <maya/MFnMesh.h>
+#include <maya/MIntArray.h>
+#include <maya/MMatrix.h>
+#include <maya/MPlug.h>
+#include <maya/MPlugArray.h>
+#include <maya/MUuid.h>
+#include "appleseedmaya/_endmayaheaders.h"
+
+// Standard headers.
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+
+namespace asf = foundation;
+namespace asr = renderer;
+
+namespace
+{
+    class HypershadeTileCallback
+      : public asr::TileCallbackBase
+    {
+      public:
+        explicit HypershadeTileCallback(HypershadeRenderer& renderer)
+          : m_renderer(renderer)
+        {
+        }
+
+        void release() override
+        {
+            delete this;
+        }
+
+        void on_progressive_frame_update(
+            const asr::Frame&       frame,
+            const double            time,
+            const std::uint64_t     samples,
+            const double            samples_per_pixel,
+            const std::uint64_t     samples_per_second) override
+        {
+            m_renderer.writeFrame(frame);
+        }
+
+      private:
+        HypershadeRenderer& m_renderer;
+    };
+
+    class HypershadeTileCallbackFactory
+      : public asr::ITileCallbackFactory
+    {
+      public:
+        explicit HypershadeTileCallbackFactory(HypershadeRenderer& renderer)
+          : m_renderer(renderer)
+        {
+        }
+
+        void release() override
+        {
+            delete this;
+        }
+
+        asr::ITileCallback* create() override
+        {
+            return new HypershadeTileCallback(m_renderer);
+        }
+
+      private:
+        HypershadeRenderer& m_renderer;
+    };
+
+    asf::Matrix4d convert(const MMatrix& m)
+    {
+        asf::Matrix4d result;
+
+        for (int i = 0; i < 4; ++i)
+        {
+            for (int j = 0; j < 4; ++j)
+                result(i, j) = m[j][i];
+        }
+
+        return result;
+    }
+
+    MString meshName(const MString& id)
+    {
+        return MString("mesh_") + id;
+    }
+
+    MString materialName(const MString& id)
+    {
+        return MString("material_") + id;
+    }
+
+    // Fill an appleseed mesh from a Maya mesh using bulk queries.
+    // Material viewer meshes are simple, they only have one material slot.
+    MStatus fillMesh(const MObject& node, asr::MeshObject& mesh)
+    {
+        MStatus status;
+        MFnMesh meshFn(node, &status);
+        if (!status)
+            return status;
+
+        // Vertices.
+        {
+            const float* p = meshFn.getRawPoints(&status);
+            if (!status)
+                return status;
+
+            mesh.reserve_vertices(meshFn.numVertices());
+            for (int i = 0, e = meshFn.numVertices(); i < e; ++i, p += 3)
+                mesh.push_vertex(asr::GVector3(p[0], p[1], p[2]));
+        }
+
+        // Normals.
+        const asr::GVector3 Y(0.0f, 1.0f, 0.0f);
+        {
+            const float* p = meshFn.getRawNormals(&status);
+            if (!status)
+                return status;
+
+            mesh.reserve_vertex_normals(meshFn.numNormals());
+            for (int i = 0, e = meshFn.numNormals(); i < e; ++i, p += 3)
+                mesh.push_vertex_normal(asf::safe_normalize(asr::GVector3(p[0], p[1], p[2]), Y));
+        }
+
+        // UVs.
+        MFloatArray u, v;
+        status = meshFn.getUVs(u, v);
+        if (!status)
+            return status;
+
+        const bool hasUVs = u.length() != 0;
+
+        mesh.reserve_tex_coords(u.length());
+        for (unsigned int i = 0, e = u.length(); i < e; ++i)
+            mesh.push_tex_coords(asr::GVector2(u[i], v[i]));
+
+        // Topology.
+        MIntArray polyVertexCounts, polyVertices;
+        status = meshFn.getVertices(polyVertexCounts, polyVertices);
+        if (!status)
+            return status;
+
+        // Triangle corners, as indices in the face vertex list of the whole mesh.
+        MIntArray triangleCounts, triangleOffsets;
+        status = meshFn.getTriangleOffsets(triangleCounts, triangleOffsets);
+        if (!status)
+            return status;
+
+        // Faces without UVs have no entries in uvIds.
+        MIntArray uvCounts, uvIds;
+        if (hasUVs)
+        {
+            status = meshFn.getAssignedUVs(uvCounts, uvIds);
+            if (!status)
+                return status;
+        }
+
+        // Normal ids are listed for every face vertex.
+        MIntArray normalCounts, normalIds;
+        status = meshFn.getNormalIds(normalCounts, normalIds);
+        if (!status)
+            return status;
+
+        mesh.reserve_triangles(triangleOffsets.length() / 3);
+
+        unsigned int faceVertexOffset = 0;
+        unsigned int uvOffset = 0;
+        unsigned int cornerIndex = 0;
+
+        for (unsigned int faceIndex = 0, e = polyVertexCounts.length(); faceIndex < e; ++faceIndex)
+        {
+            const bool faceHasUVs = hasUVs && uvCounts[faceIndex] != 0;
+
+            for (int i = 0, numTris = triangleCounts[faceIndex]; i < numTris; ++i)
+            {
+                const unsigned int o0 = triangleOffsets[cornerIndex++];
+                const unsigned int o1 = triangleOffsets[cornerIndex++];
+                const unsigned int o2 = triangleOffsets[cornerIndex++];
+
+                asr::Triangle triangle;
+                triangle.m_v0 = polyVertices[o0];
+                triangle.m_v1 = polyVertices[o1];
+                triangle.m_v2 = polyVertices[o2];
+                triangle.m_n0 = normalIds[o0];
+                triangle.m_n1 = normalIds[o1];
+                triangle.m_n2 = normalIds[o2];
+
+                // uvIds skips the faces without UVs, index it relative to the face.
+                triangle.m_a0 = faceHasUVs ? uvIds[uvOffset + o0 - faceVertexOffset] : 0;
+                triangle.m_a1 = faceHasUVs ? uvIds[uvOffset + o1 - faceVertexOffset] : 0;
+                triangle.m_a2 = faceHasUVs ? uvIds[uvOffset + o2 - faceVertexOffset] : 0;
+                triangle.m_pa = 0;
+                mesh.push_triangle(triangle);
+            }
+
+            faceVertexOffset += polyVertexCounts[faceIndex];
+
+            if (hasUVs)
+                uvOffset += uvCounts[faceIndex];
+        }
+
+#ifndef NDEBUG
+        // Check the bulk topology against the per-face triangle query.
+        size_t triangleIndex = 0;
+        for (int faceIndex = 0, e = static_cast<int>(polyVertexCounts.length()); faceIndex < e; ++faceIndex)
+        {
+            for (int i = 0, numTris = triangleCounts[faceIndex]; i < numTris; ++i)
+            {
+                int vertexList[3];
+                status = meshFn.getPolygonTriangleVertices(faceIndex, i, vertexList);
+                assert(status);
+
+                const asr::Triangle& triangle = mesh.get_triangle(triangleIndex++);
+                assert(static_cast<int>(triangle.m_v0) == vertexList[0]);
+                assert(static_cast<int>(triangle.m_v1) == vertexList[1]);
+                assert(static_cast<int>(triangle.m_v2) == vertexList[2]);
+            }
+        }
+#endif
+
+        return MS::kSuccess;
+    }
+
+    asf::auto_release_ptr<asr::MeshObject> convertMesh(const MString& name, const MObject& node)
+    {
+        asf::auto_release_ptr<asr::MeshObject> mesh(
+            asr::MeshObjectFactory().create(name.asChar(), asr::ParamArray()));
+        mesh->push_material_slot("default");
+
+        const MStatus status = fillMesh(node, mesh.ref());
+
+        if (!status)
+        {
+            RENDERER_LOG_ERROR(
+                "Couldn't convert material viewer mesh %s: %s.",
+                name.asChar(),
+                status.errorString().asChar());
+
+            // Render an empty mesh rather than a partial one.
+            mesh.reset(asr::MeshObjectFactory().create(name.asChar(), asr::ParamArray()).release());
+            mesh->push_material_slot("default");
+        }
+
+        return mesh;
+    }
+
+    // Return the node and plug a shader network should be exported from.
+    bool findSurfaceShader(const MObject& node, MObject& shaderNode, MPlug& outputPlug)
+    {
+        MFnDependencyNode depNodeFn(node);
+
+        // Maya can give us a shading engine; follow its surface shader connection.
+        if (node.hasFn(MFn::kShadingEngine))
+        {
+            MPlug plug = depNodeFn.findPlug("surfaceShader", /*wantNetworkedPlug=*/ false);
+            MPlugArray connections;
+            if (plug.isNull() || !plug.connectedTo(connections, true, false) || connections.length() == 0)
+                return false;
+
+            return findSurfaceShader(connections[0].node(), shaderNode, outputPlug);
+        }
+
+        outputPlug = depNodeFn.findPlug("outColor", /*wantNetworkedPlug=*/ false);
+        shaderNode = node;
+        return !outputPlug.isNull();
+    }
+}
+
 const MString HypershadeRenderer::name("appleseed");
 
 void* HypershadeRenderer::creator()
@@ -37,41 +337,147 @@ void* HypershadeRenderer::creator()
 }
 
 HypershadeRenderer::HypershadeRenderer()
+  : m_running(false)
+  , m_jobActive(false)
+  , m_maxSamples(0)
+  , m_width(256)
+  , m_height(256)
+  , m_instancesDirty(false)
+  , m_cameraDirty(false)
 {
+    m_resourceSearchPaths = AppleseedSession::resourceSearchPaths();
+    createProject();
+}
+
+HypershadeRenderer::~HypershadeRenderer()
+{
+    stopRender();
+
+    // Shading network exporters remove their entities from the project.
+    m_shaders.clear();
+    m_project.reset();
 }
 
 bool HypershadeRenderer::isSafeToUnload()
 {
-    return true;
+    return !m_running;
 }
 
 MStatus HypershadeRenderer::startAsync(const JobParams& params)
 {
+    m_maxSamples = params.maxSamples;
+    m_jobActive = true;
+
+    startRender();
     return MS::kSuccess;
 }
 
 MStatus HypershadeRenderer::stopAsync()
 {
+    m_jobActive = false;
+    stopRender();
     return MS::kSuccess;
 }
 
 bool HypershadeRenderer::isRunningAsync()
 {
-    return true;
+    return m_running;
 }
 
 MStatus HypershadeRenderer::beginSceneUpdate()
 {
+    // The project cannot be edited while rendering.
+    stopRender();
     return MS::kSuccess;
 }
 
 MStatus HypershadeRenderer::endSceneUpdate()
 {
-    return MS::kSuccess;
+    MStatus status = MS::kSuccess;
+
+    try
+    {
+        // Only the shaders reported as changed are exported again.
+        for (auto it = m_dirtyShaders.begin(), e = m_dirtyShaders.end(); it != e; ++it)
+        {
+            ShaderMap::iterator shaderIt = m_shaders.find(*it);
+            if (shaderIt == m_shaders.end())
+                continue;
+
+            Shader& shader = shaderIt->second;
+
+            // Remove the previous shader group.
+            shader.m_exporter.reset();
+
+            MObject shaderNode;
+            MPlug outputPlug;
+            if (!findSurfaceShader(shader.m_node, shaderNode, outputPlug))
+                continue;
+
+            shader.m_exporter.reset(NodeExporterFactory::createShadingNetworkExporter(
+                SurfaceNetworkContext,
+                shaderNode,
+                outputPlug,
+                mainAssembly(),
+                AppleseedSession::ProgressiveRenderSession));
+
+            shader.m_exporter->createEntities();
+            shader.m_exporter->flushEntities();
+
+            const MString material = materialName(*it);
+            asr::Material* m = mainAssembly().materials().get_by_name(material.asChar());
+            if (m == nullptr)
+            {
+                asf::auto_release_ptr<asr::Material> newMaterial(
+                    asr::OSLMaterialFactory().create(material.asChar(), asr::ParamArray()));
+                m = newMaterial.get();
+                mainAssembly().materials().insert(newMaterial);
+            }
+
+            m->get_parameters().insert("osl_surface", shader.m_exporter->shaderGroupName().asChar());
+            m->bump_version_id();
+        }
+
+        m_dirtyShaders.clear();
+
+        if (m_cameraDirty)
+        {
+            createCamera();
+            m_cameraDirty = false;
+        }
+
+        if (m_instancesDirty)
+        {
+            createInstances();
+            m_instancesDirty = false;
+        }
+    }
+    catch (const std::exception& e)
+    {
+        RENDERER_LOG_ERROR("Hypershade scene update failed, error = %s.", e.what());
+        status = MS::kFailure;
+    }
+
+    if (m_jobActive)
+        startRender();
+
+    return status;
 }
 
 MStatus HypershadeRenderer::destroyScene()
 {
+    stopRender();
+
+    m_shaders.clear();
+    m_dirtyShaders.clear();
+    m_shaderAssignments.clear();
+    m_transforms.clear();
+    m_meshes.clear();
+    m_cameraNode = MObject();
+    m_cameraId.clear();
+
+    m_project.reset();
+    createProject();
     return MS::kSuccess;
 }
 
@@ -97,27 +503,55 @@ MStatus HypershadeRenderer::setProperty(const MUuid& id, const MString& name, co
 
 MStatus HypershadeRenderer::setShader(const MUuid& id, const MUuid& shaderId)
 {
+    m_shaderAssignments[id.asString()] = shaderId.asString();
+    m_instancesDirty = true;
     return MS::kSuccess;
 }
 
 MStatus HypershadeRenderer::setResolution(unsigned int w, unsigned int h)
 {
+    if (w == m_width && h == m_height)
+        return MS::kSuccess;
+
+    stopRender();
+
+    m_width = w;
+    m_height = h;
+    createFrame();
+    createCamera();
+
+    if (m_jobActive)
+        startRender();
+
     return MS::kSuccess;
 }
 
-
 MStatus HypershadeRenderer::translateMesh(const MUuid& id, const MObject& node)
 {
+    const MString name = meshName(id.asString());
+
+    if (asr::Object* object = mainAssembly().objects().get_by_name(name.asChar()))
+        mainAssembly().objects().remove(object);
+
+    asf::auto_release_ptr<asr::MeshObject> mesh = convertMesh(name, node);
+    mainAssembly().objects().insert(asf::auto_release_ptr<asr::Object>(mesh.release()));
+
+    m_meshes.insert(id.asString());
+    m_instancesDirty = true;
     return MS::kSuccess;
 }
 
 MStatus HypershadeRenderer::translateLightSource(const MUuid& id, const MObject& node)
 {
+    // The material viewer scene is lit by our own environment and key light.
     return MS::kSuccess;
 }
 
 MStatus HypershadeRenderer::translateCamera(const MUuid& id, const MObject& node)
 {
+    m_cameraId = id.asString();
+    m_cameraNode = node;
+    m_cameraDirty = true;
     return MS::kSuccess;
 }
 
@@ -128,10 +562,259 @@ MStatus HypershadeRenderer::translateEnvironment(const MUuid& id, EnvironmentTyp
 
 MStatus HypershadeRenderer::translateTransform(const MUuid& id, const MUuid& childId, const MMatrix& matrix)
 {
+    const MString child = childId.asString();
+    m_transforms[child] = convert(matrix);
+
+    if (child == m_cameraId)
+        m_cameraDirty = true;
+    else
+        m_instancesDirty = true;
+
     return MS::kSuccess;
 }
 
 MStatus HypershadeRenderer::translateShader(const MUuid& id, const MObject& node)
 {
+    const MString shaderId = id.asString();
+    m_shaders[shaderId].m_node = node;
+    m_dirtyShaders.insert(shaderId);
     return MS::kSuccess;
 }
+
+void HypershadeRenderer::writeFrame(const asr::Frame& frame)
+{
+    const asf::Image& image = frame.image();
+    const asf::CanvasProperties& props = image.properties();
+
+    std::lock_guard<std::mutex> lock(m_pixelsMutex);
+
+    const size_t width = props.m_canvas_width;
+    const size_t height = props.m_canvas_height;
+    m_pixels.resize(width * height * 4);
+
+    // Maya expects the rows bottom to top.
+    for (size_t ty = 0; ty < props.m_tile_count_y; ++ty)
+    {
+        for (size_t tx = 0; tx < props.m_tile_count_x; ++tx)
+        {
+            const asf::Tile& tile = image.tile(tx, ty);
+            const size_t x0 = props.m_tile_width * tx;
+            const size_t y0 = props.m_tile_height * ty;
+
+            for (size_t j = 0, je = tile.get_height(); j < je; ++j)
+            {
+                const size_t y = height - 1 - (y0 + j);
+                memcpy(
+                    &m_pixels[(y * width + x0) * 4],
+                    tile.pixel(0, j),
+                    tile.get_width() * 4 * sizeof(float));
+            }
+        }
+    }
+
+    RefreshParams params;
+    params.width = static_cast<unsigned int>(width);
+    params.height = static_cast<unsigned int>(height);
+    params.left = 0;
+    params.right = params.width - 1;
+    params.bottom = 0;
+    params.top = params.height - 1;
+    params.channels = 4;
+    params.bytesPerChannel = sizeof(float);
+    params.data = &m_pixels[0];
+    refresh(params);
+}
+
+void HypershadeRenderer::createProject()
+{
+    assert(m_project.get() == nullptr);
+
+    m_project = asr::ProjectFactory::create("hypershade");
+    m_project->add_default_configurations();
+
+    asr::Configuration* cfg = m_project->configurations().get_by_name("interactive");
+    asr::ParamArray& cfgParams = cfg->get_parameters();
+    cfgParams.insert("sample_renderer", "generic");
+    cfgParams.insert("sample_generator", "generic");
+    cfgParams.insert("tile_renderer", "generic");
+    cfgParams.insert("frame_renderer", "progressive");
+    cfgParams.insert("pixel_renderer", "uniform");
+    cfgParams.insert("sampling_mode", "qmc");
+    cfgParams.insert("lighting_engine", "pt");
+    cfgParams.insert("spectrum_mode", "rgb");
+    cfgParams.insert_path("progressive_frame_renderer.max_fps", "10");
+
+    asf::auto_release_ptr<asr::Scene> scene = asr::SceneFactory::create();
+    m_project->set_scene(scene);
+
+    // Create the environment.
+    asf::auto_release_ptr<asr::EnvironmentEDF> environmentEDF(asr::ConstantEnvironmentEDFFactory().create(
+        "environmentEDF",
+        asr::ParamArray().insert("radiance", "0.25")));
+    m_project->get_scene()->environment_edfs().insert(environmentEDF);
+
+    asf::auto_release_ptr<asr::EnvironmentShader> environmentShader(asr::EDFEnvironmentShaderFactory().create(
+        "environmentShader",
+        asr::ParamArray()
+            .insert("environment_edf", "environmentEDF")
+            .insert("alpha_value", "1.0")));
+    m_project->get_scene()->environment_shaders().insert(environmentShader);
+
+    asf::auto_release_ptr<asr::Environment> environment = asr::EnvironmentFactory().create(
+        "environment",
+        asr::ParamArray().insert("environment_shader", "environmentShader"));
+    m_project->get_scene()->set_environment(environment);
+
+    // Create the main assembly.
+    asf::auto_release_ptr<asr::Assembly> assembly = asr::AssemblyFactory().create("assembly", asr::ParamArray());
+
+    asf::auto_release_ptr<asr::Light> light = asr::DirectionalLightFactory().create(
+        "light",
+        asr::ParamArray().insert("irradiance", "2.0"));
+    assembly->lights().insert(light);
+
+    asf::auto_release_ptr<asr::Material> defaultMaterial = asr::OSLMaterialFactory().create(
+        "default_material",
+        asr::ParamArray());
+    assembly->materials().insert(defaultMaterial);
+
+    m_project->get_scene()->assemblies().insert(assembly);
+
+    asf::auto_release_ptr<asr::AssemblyInstance> assemblyInstance = asr::AssemblyInstanceFactory::create(
+        "assembly_inst",
+        asr::ParamArray(),
+        "assembly");
+    m_project->get_scene()->assembly_instances().insert(assemblyInstance);
+
+    createFrame();
+    createCamera();
+}
+
+void HypershadeRenderer::createFrame()
+{
+    asf::auto_release_ptr<asr::Frame> frame(
+        asr::FrameFactory::create(
+            "beauty",
+            asr::ParamArray()
+                .insert("resolution", asf::Vector2u(m_width, m_height))
+                .insert("camera", "camera")
+                .insert("tile_size", asf::Vector2i(32, 32))));
+    m_project->set_frame(frame);
+}
+
+void HypershadeRenderer::createCamera()
+{
+    const double aspect = static_cast<double>(m_width) / m_height;
+    const double filmWidth = 0.036;
+
+    asr::ParamArray params;
+    params.insert("film_dimensions", asf::Vector2d(filmWidth, filmWidth / aspect));
+
+    asf::Transformd transform(asf::Matrix4d::make_translation(asf::Vector3d(0.0, 0.0, 2.65)));
+
+    if (!m_cameraNode.isNull())
+    {
+        MFnCamera cameraFn(m_cameraNode);
+        params.insert("horizontal_fov", asf::rad_to_deg(cameraFn.horizontalFieldOfView()));
+    }
+    else
+        params.insert("focal_length", "0.035");
+
+    TransformMap::const_iterator it = m_transforms.find(m_cameraId);
+    if (it != m_transforms.end())
+        transform = asf::Transformd::from_local_to_parent(it->second);
+
+    m_project->get_scene()->cameras().clear();
+
+    asf::auto_release_ptr<asr::Camera> camera = asr::PinholeCameraFactory().create("camera", params);
+    camera->transform_sequence().set_transform(0.0f, transform);
+    m_project->get_scene()->cameras().insert(camera);
+}
+
+void HypershadeRenderer::createInstances()
+{
+    mainAssembly().object_instances().clear();
+
+    for (auto it = m_meshes.begin(), e = m_meshes.end(); it != e; ++it)
+    {
+        const MString name = meshName(*it);
+
+        asf::Transformd transform = asf::Transformd::identity();
+        TransformMap::const_iterator transformIt = m_transforms.find(*it);
+        if (transformIt != m_transforms.end())
+            transform = asf::Transformd::from_local_to_parent(transformIt->second);
+
+        MString material("default_material");
+        ShaderAssignmentMap::const_iterator assignIt = m_shaderAssignments.find(*it);
+        if (assignIt != m_shaderAssignments.end())
+        {
+            const MString assigned = materialName(assignIt->second);
+            if (mainAssembly().materials().get_by_name(assigned.asChar()))
+                material = assigned;
+        }
+
+        asf::StringDictionary materials;
+        materials.insert("default", material.asChar());
+
+        asf::auto_release_ptr<asr::ObjectInstance> objInstance = asr::ObjectInstanceFactory().create(
+            (name + MString("_instance")).asChar(),
+            asr::ParamArray(),
+            name.asChar(),
+            transform,
+            materials,
+            materials);
+        mainAssembly().object_instances().insert(objInstance);
+    }
+}
+
+void HypershadeRenderer::startRender()
+{
+    // Join the previous render thread, it may have finished on its own.
+    stopRender();
+
+    m_rendererController.set_status(asr::IRendererController::ContinueRendering);
+    m_tileCallbackFactory.reset(new HypershadeTileCallbackFactory(*this));
+
+    asr::ParamArray params =
+        m_project->configurations().get_by_name("interactive")->get_inherited_parameters();
+
+    if (m_maxSamples != 0)
+        params.insert_path("progressive_frame_renderer.max_average_spp", m_maxSamples);
+
+    m_renderer.reset(
+        new asr::MasterRenderer(
+            *m_project,
+            params,
+            m_resourceSearchPaths,
+            m_tileCallbackFactory.get()));
+
+    m_running = true;
+    std::thread thread(&HypershadeRenderer::renderFunc, this);
+    m_renderThread.swap(thread);
+}
+
+void HypershadeRenderer::stopRender()
+{
+    // Ask appleseed to stop rendering and wait for the render thread.
+    m_rendererController.set_status(asr::IRendererController::AbortRendering);
+
+    if (m_renderThread.joinable())
+        m_renderThread.join();
+
+    // The renderer references the tile callback factory.
+    m_renderer.reset();
+    m_tileCallbackFactory.reset();
+}
+
+void HypershadeRenderer::renderFunc()
+{
+    m_renderer->render(m_rendererController);
+    m_running = false;
+}
+
+asr::Assembly& HypershadeRenderer::mainAssembly()
+{
+    asr::Assembly* assembly = m_project->get_scene()->assemblies().get_by_name("assembly");
+    assert(assembly);
+    return *assembly;
+}
@@ -28,11 +28,51 @@
 
 #pragma once
 
+// appleseed-maya headers.
+#include "appleseedmaya/exporters/shadingnetworkexporterfwd.h"
+#include "appleseedmaya/renderercontroller.h"
+#include "appleseedmaya/utils.h"
+
+// Build options header.
+#include "foundation/core/buildoptions.h"
+
+// appleseed.renderer headers.
+#include "renderer/api/project.h"
+#include "renderer/api/rendering.h"
+
+// appleseed.foundation headers.
+#include "foundation/math/matrix.h"
+#include "foundation/memory/autoreleaseptr.h"
+#include "foundation/utility/searchpaths.h"
+
 // Maya headers.
 #include "appleseedmaya/_beginmayaheaders.h"
+#include <maya/MObject.h>
 #include <maya/MPxRenderer.h>
+#include <maya/MString.h>
 #include "appleseedmaya/_endmayaheaders.h"
 
+// Standard headers.
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+
+// Forward declarations.
+namespace renderer { class Assembly; }
+namespace renderer { class Frame; }
+
+//
+// Renderer for Hypershade's material viewer.
+//
+// A small persistent project is kept between updates. Only the meshes, shaders
+// and transforms Maya reports as changed are translated again; rendering is
+// progressive and runs on a background thread.
+//
+
 class HypershadeRenderer
   : public MPxRenderer
 {
@@ -42,6 +82,7 @@ class HypershadeRenderer
     static void* creator();
 
     HypershadeRenderer();
+    ~HypershadeRenderer() override;
 
     bool isSafeToUnload() override;
 
@@ -67,5 +108,56 @@ class HypershadeRenderer
     MStatus translateEnvironment(const MUuid& id, EnvironmentType type) override;
     MStatus translateTransform(const MUuid& id, const MUuid& childId, const MMatrix& matrix) override;
     MStatus translateShader(const MUuid& id, const MObject& node) override;
-};
 
+    // Send the rendered frame to Maya. Called from the render thread.
+    void writeFrame(const renderer::Frame& frame);
+
+  private:
+    struct Shader
+    {
+        MObject                     m_node;
+        ShadingNetworkExporterPtr   m_exporter;
+    };
+
+    void createProject();
+    void createFrame();
+    void createCamera();
+    void createInstances();
+
+    void startRender();
+    void stopRender();
+    void renderFunc();
+
+    renderer::Assembly& mainAssembly();
+
+    typedef std::map<MString, MString, MStringCompareLess>              ShaderAssignmentMap;
+    typedef std::map<MString, Shader, MStringCompareLess>               ShaderMap;
+    typedef std::map<MString, foundation::Matrix4d, MStringCompareLess> TransformMap;
+    typedef std::set<MString, MStringCompareLess>                       NameSet;
+
+    foundation::auto_release_ptr<renderer::Project>         m_project;
+    foundation::SearchPaths                                 m_resourceSearchPaths;
+    std::unique_ptr<renderer::ITileCallbackFactory>         m_tileCallbackFactory;
+    std::unique_ptr<renderer::MasterRenderer>               m_renderer;
+    RendererController                                      m_rendererController;
+    std::thread                                             m_renderThread;
+    std::atomic<bool>                                       m_running;
+    bool                                                    m_jobActive;
+    unsigned int                                            m_maxSamples;
+
+    unsigned int                                            m_width;
+    unsigned int                                            m_height;
+    std::vector<float>                                      m_pixels;
+    std::mutex                                              m_pixelsMutex;
+
+    // Translated scene state, keyed by the Maya uuids.
+    NameSet                                                 m_meshes;
+    ShaderMap                                               m_shaders;
+    NameSet                                                 m_dirtyShaders;
+    ShaderAssignmentMap                                     m_shaderAssignments;
+    TransformMap                                            m_transforms;
+    MObject                                                 m_cameraNode;
+    MString                                                 m_cameraId;
+    bool                                                    m_instancesDirty;
+    bool                                                    m_cameraDirty;
+};
@@ -32,6 +32,9 @@
 // appleseed-maya headers.
 #include "appleseedmaya/logger.h"
 
+// appleseed.foundation headers.
+#include "foundation/string/string.h"
+
 // Maya headers.
 #include "appleseedmaya/_beginmayaheaders.h"
 #include <maya/MEventMessage.h>
@@ -40,19 +43,43 @@
 #include "appleseedmaya/_endmayaheaders.h"
 
 // Standard headers.
+#include <algorithm>
 #include <cassert>
+#include <chrono>
 #include <mutex>
 #include <queue>
+#include <vector>
+
+namespace asf = foundation;
 
 namespace
 {
+    // Time spent executing jobs in each idle callback, to keep Maya responsive.
+    const std::chrono::milliseconds IdleTimeBudget(20);
+
     MCallbackId g_callbackId;
 
     std::queue<std::function<void ()>> g_jobQueue;
+    std::vector<std::function<void ()>> g_deferredActions;
     std::mutex g_jobQueueMutex;
 
-    static void idleCallback(void* clientData)
+    // Statistics, protected by g_jobQueueMutex.
+    IdleJobQueue::Statistics g_statistics;
+
+    void resetStatistics()
     {
+        std::lock_guard<std::mutex> lock(g_jobQueueMutex);
+        g_statistics.m_queueDepth = 0;
+        g_statistics.m_maxQueueDepth = 0;
+        g_statistics.m_executedJobs = 0;
+        g_statistics.m_mainThreadTime = 0.0;
+    }
+
+    void executeJobs(const bool useTimeBudget)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        size_t executedJobs = 0;
+
         while (true)
         {
             std::function<void ()> job;
@@ -65,10 +92,49 @@ namespace
 
                 job = std::move(g_jobQueue.front());
                 g_jobQueue.pop();
+                g_statistics.m_queueDepth = g_jobQueue.size();
             }
 
             job();
+            ++executedJobs;
+
+            // Leave the remaining jobs for the next idle callbacks.
+            if (useTimeBudget && std::chrono::steady_clock::now() - start >= IdleTimeBudget)
+                break;
         }
+
+        if (executedJobs != 0)
+        {
+            const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+            std::lock_guard<std::mutex> lock(g_jobQueueMutex);
+            g_statistics.m_executedJobs += executedJobs;
+            g_statistics.m_mainThreadTime += elapsed.count();
+        }
+    }
+
+    void executeDeferredActions()
+    {
+        std::vector<std::function<void ()>> actions;
+
+        {
+            std::lock_guard<std::mutex> lock(g_jobQueueMutex);
+            actions.swap(g_deferredActions);
+        }
+
+        for (size_t i = 0, e = actions.size(); i < e; ++i)
+            actions[i]();
+    }
+
+    static void idleCallback(void* clientData)
+    {
+        executeJobs(true);
+
+        // The jobs are done, the actions can now stop the queue.
+        executeDeferredActions();
+
+        // Display the messages logged by the render threads.
+        Logger::flush();
     }
 }
 
@@ -94,6 +160,7 @@ void start()
     if (g_callbackId == 0)
     {
         RENDERER_LOG_DEBUG("Started idle job queue");
+        resetStatistics();
 
         MStatus status;
         g_callbackId = MEventMessage::addEventCallback(
@@ -114,8 +181,21 @@ void stop()
         g_callbackId = 0;
 
         // Perform any pending jobs.
-        idleCallback(nullptr);
+        executeJobs(false);
         assert(g_jobQueue.empty());
+
+        // Deferred actions target the session being stopped.
+        {
+            std::lock_guard<std::mutex> lock(g_jobQueueMutex);
+            g_deferredActions.clear();
+        }
+
+        const Statistics stats = statistics();
+        RENDERER_LOG_DEBUG(
+            "Idle job queue: %s jobs executed, max queue depth %s, %s seconds spent in the main thread",
+            asf::pretty_uint(stats.m_executedJobs).c_str(),
+            asf::pretty_uint(stats.m_maxQueueDepth).c_str(),
+            asf::pretty_scalar(stats.m_mainThreadTime, 3).c_str());
     }
 }
 
@@ -126,6 +206,23 @@ void pushJob(std::function<void ()> job)
 
     std::lock_guard<std::mutex> lock(g_jobQueueMutex);
     g_jobQueue.push(std::move(job));
+    g_statistics.m_queueDepth = g_jobQueue.size();
+    g_statistics.m_maxQueueDepth = std::max(g_statistics.m_maxQueueDepth, g_statistics.m_queueDepth);
+}
+
+void pushDeferredAction(std::function<void ()> action)
+{
+    assert(action);
+    assert(g_callbackId != 0);
+
+    std::lock_guard<std::mutex> lock(g_jobQueueMutex);
+    g_deferredActions.push_back(std::move(action));
+}
+
+Statistics statistics()
+{
+    std::lock_guard<std::mutex> lock(g_jobQueueMutex);
+    return g_statistics;
 }
 
 } // IdleJobQueue
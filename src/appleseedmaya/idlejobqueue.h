@@ -34,11 +34,20 @@
 #include "appleseedmaya/_endmayaheaders.h"
 
 // Standard headers.
+#include <cstddef>
 #include <functional>
 
 namespace IdleJobQueue
 {
 
+struct Statistics
+{
+    size_t  m_queueDepth;       // jobs waiting to be executed
+    size_t  m_maxQueueDepth;    // maximum number of waiting jobs since start()
+    size_t  m_executedJobs;     // jobs executed since start()
+    double  m_mainThreadTime;   // seconds spent executing jobs since start()
+};
+
 MStatus initialize();
 MStatus uninitialize();
 
@@ -49,7 +58,17 @@ void start();
 void stop();
 
 // Push a job to be executed in the main thread during the idle callback.
+// Each idle callback executes jobs for a limited time, the remaining
+// jobs are executed in the next idle callbacks.
 void pushJob(std::function<void()> job);
 
+// Push an action to be executed in the main thread after the jobs of the
+// current idle callback, outside of the queue. Used for actions that stop
+// the queue, like ending or restarting a session, which can't run in a job.
+void pushDeferredAction(std::function<void()> action);
+
+// Return the queue statistics.
+Statistics statistics();
+
 } // IdleJobQueue
 
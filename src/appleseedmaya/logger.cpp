@@ -39,12 +39,26 @@
 // Maya headers.
 #include "appleseedmaya/_beginmayaheaders.h"
 #include <maya/MGlobal.h>
+#include <maya/MMessage.h>
 #include <maya/MStatus.h>
+#include <maya/MTimerMessage.h>
 #include "appleseedmaya/_endmayaheaders.h"
 
 // Standard headers.
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
 #include <cstdlib>
 #include <cstring>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
 
 namespace asf = foundation;
 namespace asr = renderer;
@@ -54,6 +68,339 @@ namespace Logger
 
 namespace
 {
+    // Number of messages that can be waiting to be displayed. Must be a power of two.
+    const size_t MessageQueueCapacity = 1024;
+
+    // Longer messages are truncated, and end with TruncatedMarker.
+    const size_t MaxMessageLength = 1024;
+    const char* TruncatedMarker = " (truncated)";
+
+    // Maximum number of messages displayed per second, for each category.
+    // Errors are always displayed.
+    const size_t MaxMessagesPerSecond[asf::LogMessage::NumMessageCategories] =
+    {
+        50,     // Debug
+        50,     // Info
+        50,     // Warning
+        0,      // Error, unlimited
+        0       // Fatal, unlimited
+    };
+
+    // Time after which a pending "repeated N times" summary is displayed.
+    const std::chrono::milliseconds RepeatReportDelay(1000);
+
+    // Period of the timer used to display messages when no render is running.
+    const float FlushTimerPeriod = 0.1f;
+
+    // Messages below this level logged from the current thread are discarded.
+    thread_local asf::LogMessage::Category gThreadLogLevel = asf::LogMessage::Debug;
+
+    void displayMessage(
+        const asf::LogMessage::Category  category,
+        const char*                      message)
+    {
+        const MString text = MString("appleseed: ") + message;
+
+        switch (category)
+        {
+            case asf::LogMessage::Debug:
+                MGlobal::displayInfo(text);
+            break;
+
+            case asf::LogMessage::Info:
+                MGlobal::displayInfo(text);
+            break;
+
+            case asf::LogMessage::Warning:
+                MGlobal::displayWarning(text);
+            break;
+
+            case asf::LogMessage::Error:
+            case asf::LogMessage::Fatal:
+            default:
+                MGlobal::displayError(text);
+            break;
+        }
+    }
+
+    //
+    // Bounded, lock-free, multiple producers / single consumer message queue.
+    // Errors that do not fit are kept in an unbounded overflow list instead
+    // of being dropped.
+    //
+
+    class MessageQueue
+      : public asf::NonCopyable
+    {
+      public:
+        MessageQueue()
+          : m_enqueuePos(0)
+          , m_dequeuePos(0)
+          , m_droppedMessages(0)
+        {
+            for (size_t i = 0; i < MessageQueueCapacity; ++i)
+                m_slots[i].m_sequence.store(i, std::memory_order_relaxed);
+        }
+
+        // Can be called from any thread. Returns false if the message was dropped.
+        bool push(
+            const asf::LogMessage::Category  category,
+            const char*                      message)
+        {
+            size_t pos = m_enqueuePos.load(std::memory_order_relaxed);
+            Slot* slot;
+
+            while (true)
+            {
+                slot = &m_slots[pos & (MessageQueueCapacity - 1)];
+                const size_t seq = slot->m_sequence.load(std::memory_order_acquire);
+                const std::intptr_t diff =
+                    static_cast<std::intptr_t>(seq) - static_cast<std::intptr_t>(pos);
+
+                if (diff == 0)
+                {
+                    if (m_enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                        break;
+                }
+                else if (diff < 0)
+                {
+                    if (category >= asf::LogMessage::Error)
+                    {
+                        std::lock_guard<std::mutex> lock(m_overflowMutex);
+                        m_overflow.push_back(std::make_pair(category, std::string(message)));
+                        return true;
+                    }
+
+                    m_droppedMessages.fetch_add(1, std::memory_order_relaxed);
+                    return false;
+                }
+                else
+                    pos = m_enqueuePos.load(std::memory_order_relaxed);
+            }
+
+            slot->m_category = category;
+
+            const size_t length = std::strlen(message);
+            if (length < MaxMessageLength)
+                std::memcpy(slot->m_message, message, length + 1);
+            else
+            {
+                const size_t markerLength = std::strlen(TruncatedMarker);
+                const size_t keptLength = MaxMessageLength - 1 - markerLength;
+                std::memcpy(slot->m_message, message, keptLength);
+                std::memcpy(slot->m_message + keptLength, TruncatedMarker, markerLength + 1);
+            }
+
+            slot->m_sequence.store(pos + 1, std::memory_order_release);
+            return true;
+        }
+
+        // Must only be called from one thread at a time.
+        bool pop(
+            asf::LogMessage::Category&       category,
+            std::string&                     message)
+        {
+            Slot& slot = m_slots[m_dequeuePos & (MessageQueueCapacity - 1)];
+            const size_t seq = slot.m_sequence.load(std::memory_order_acquire);
+
+            if (seq != m_dequeuePos + 1)
+            {
+                // The queue is empty, display the errors that did not fit.
+                std::lock_guard<std::mutex> lock(m_overflowMutex);
+
+                if (m_overflow.empty())
+                    return false;
+
+                category = m_overflow.front().first;
+                message.swap(m_overflow.front().second);
+                m_overflow.pop_front();
+                return true;
+            }
+
+            category = slot.m_category;
+            message = slot.m_message;
+
+            slot.m_sequence.store(m_dequeuePos + MessageQueueCapacity, std::memory_order_release);
+            ++m_dequeuePos;
+            return true;
+        }
+
+        size_t takeDroppedMessages()
+        {
+            return m_droppedMessages.exchange(0, std::memory_order_relaxed);
+        }
+
+      private:
+        struct Slot
+        {
+            std::atomic<size_t>         m_sequence;
+            asf::LogMessage::Category   m_category;
+            char                        m_message[MaxMessageLength];
+        };
+
+        typedef std::pair<asf::LogMessage::Category, std::string> Message;
+
+        Slot                    m_slots[MessageQueueCapacity];
+        std::atomic<size_t>     m_enqueuePos;
+        size_t                  m_dequeuePos;
+        std::atomic<size_t>     m_droppedMessages;
+        std::mutex              m_overflowMutex;
+        std::deque<Message>     m_overflow;
+    };
+
+    //
+    // Displays queued messages in Maya, collapsing repeated messages
+    // and limiting the number of messages displayed per second.
+    //
+
+    class MessageDisplay
+    {
+      public:
+        MessageDisplay()
+          : m_lastCategory(asf::LogMessage::Info)
+          , m_repeatCount(0)
+        {
+        }
+
+        void flush(MessageQueue& queue, const bool final)
+        {
+            const auto now = std::chrono::steady_clock::now();
+
+            asf::LogMessage::Category category;
+            while (queue.pop(category, m_message))
+            {
+                if (category == m_lastCategory && m_message == m_lastMessage)
+                {
+                    ++m_repeatCount;
+                    continue;
+                }
+
+                displayRepeats();
+
+                m_lastCategory = category;
+                m_lastMessage = m_message;
+                m_lastMessageTime = now;
+
+                if (acceptMessage(category, now))
+                    displayMessage(category, m_message.c_str());
+            }
+
+            if (const size_t dropped = queue.takeDroppedMessages())
+            {
+                MGlobal::displayWarning(
+                    MString("appleseed: ") +
+                    asf::pretty_uint(dropped).c_str() +
+                    " log message(s) dropped, log queue full");
+            }
+
+            if (m_repeatCount != 0 && (final || now - m_lastMessageTime >= RepeatReportDelay))
+                displayRepeats();
+
+            for (size_t i = 0; i < asf::LogMessage::NumMessageCategories; ++i)
+            {
+                RateWindow& window = m_windows[i];
+                if (final || now - window.m_start >= std::chrono::seconds(1))
+                    displaySuppressed(static_cast<asf::LogMessage::Category>(i), window);
+            }
+        }
+
+      private:
+        struct RateWindow
+        {
+            RateWindow()
+              : m_count(0)
+              , m_suppressed(0)
+            {
+            }
+
+            std::chrono::steady_clock::time_point   m_start;
+            size_t                                  m_count;
+            size_t                                  m_suppressed;
+        };
+
+        bool acceptMessage(
+            const asf::LogMessage::Category          category,
+            const std::chrono::steady_clock::time_point&  now)
+        {
+            // Errors are never suppressed.
+            if (category >= asf::LogMessage::Error)
+                return true;
+
+            RateWindow& window = m_windows[category];
+
+            if (now - window.m_start >= std::chrono::seconds(1))
+            {
+                displaySuppressed(category, window);
+                window.m_start = now;
+                window.m_count = 0;
+            }
+
+            if (window.m_count >= MaxMessagesPerSecond[category])
+            {
+                ++window.m_suppressed;
+                return false;
+            }
+
+            ++window.m_count;
+            return true;
+        }
+
+        void displayRepeats()
+        {
+            if (m_repeatCount == 0)
+                return;
+
+            const std::string summary =
+                "last message repeated " + asf::pretty_uint(m_repeatCount) + " time(s)";
+            displayMessage(m_lastCategory, summary.c_str());
+            m_repeatCount = 0;
+        }
+
+        void displaySuppressed(
+            const asf::LogMessage::Category  category,
+            RateWindow&                      window)
+        {
+            if (window.m_suppressed == 0)
+                return;
+
+            const std::string summary =
+                asf::pretty_uint(window.m_suppressed) + " " +
+                asf::LogMessage::get_category_name(category) +
+                " message(s) suppressed";
+            displayMessage(category, summary.c_str());
+            window.m_suppressed = 0;
+        }
+
+        RateWindow                              m_windows[asf::LogMessage::NumMessageCategories];
+        asf::LogMessage::Category               m_lastCategory;
+        std::string                             m_lastMessage;
+        std::string                             m_message;
+        std::chrono::steady_clock::time_point   m_lastMessageTime;
+        size_t                                  m_repeatCount;
+    };
+
+    MessageQueue    gMessageQueue;
+    MessageDisplay  gMessageDisplay;
+    std::mutex      gMessageDisplayMutex;
+    std::thread::id gMainThreadId;
+    MCallbackId     gFlushTimerCallbackId = 0;
+
+    void flushMessages(const bool final)
+    {
+        std::unique_lock<std::mutex> lock(gMessageDisplayMutex, std::try_to_lock);
+
+        // Another flush is in progress.
+        if (!lock.owns_lock())
+            return;
+
+        gMessageDisplay.flush(gMessageQueue, final);
+    }
+
+    void flushTimerCallback(float elapsedTime, float lastTime, void* clientData)
+    {
+        flushMessages(false);
+    }
+
     class LogTarget
       : public asf::ILogTarget
     {
@@ -70,36 +417,161 @@ namespace
             const char*                      header,
             const char*                      message)
         {
-            const MString prefix("appleseed: ");
+            if (category < gThreadLogLevel)
+                return;
 
-            switch (category)
+            // In batch mode there is no event loop to display the
+            // queued messages, display them directly.
+            if (gFlushTimerCallbackId == 0)
             {
-                case asf::LogMessage::Debug:
-                    MGlobal::displayInfo(prefix + message);
-                break;
-
-                case asf::LogMessage::Info:
-                    MGlobal::displayInfo(prefix + message);
-                break;
-
-                case asf::LogMessage::Warning:
-                    MGlobal::displayWarning(prefix + message);
-                break;
-
-                case asf::LogMessage::Error:
-                case asf::LogMessage::Fatal:
-                default:
-                    MGlobal::displayError(prefix + message);
-                break;
+                displayMessage(category, message);
+                return;
             }
+
+            // Render threads only queue the message, it will be
+            // displayed later, from Maya's main thread.
+            gMessageQueue.push(category, message);
+
+            if (std::this_thread::get_id() == gMainThreadId)
+                flushMessages(false);
         }
     };
 
     LogTarget gLogTarget;
+
+    //
+    // File log target writing messages from a background thread.
+    //
+
+    class AsyncFileLogTarget
+      : public asf::ILogTarget
+    {
+      public:
+        AsyncFileLogTarget()
+          : m_done(false)
+        {
+        }
+
+        ~AsyncFileLogTarget() override
+        {
+            if (m_thread.joinable())
+            {
+                {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    m_done = true;
+                }
+
+                m_condition.notify_one();
+                m_thread.join();
+            }
+        }
+
+        bool open(const char* filename)
+        {
+            m_file.open(filename, std::ios_base::out | std::ios_base::trunc);
+
+            if (!m_file.is_open())
+                return false;
+
+            std::thread thread(&AsyncFileLogTarget::writeFunc, this);
+            m_thread.swap(thread);
+            return true;
+        }
+
+        void release() override
+        {
+            delete this;
+        }
+
+        void write(
+            const asf::LogMessage::Category  category,
+            const char*                      file,
+            const size_t                     line,
+            const char*                      header,
+            const char*                      message) override
+        {
+            if (category < gThreadLogLevel)
+                return;
+
+            // Prefix each line of the message with the header.
+            std::string text;
+            const char* begin = message;
+
+            while (true)
+            {
+                const char* end = std::strchr(begin, '\n');
+
+                text += header;
+                text.append(begin, end ? end : begin + std::strlen(begin));
+                text += '\n';
+
+                if (end == nullptr)
+                    break;
+
+                begin = end + 1;
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_pending.push_back(std::move(text));
+            }
+
+            m_condition.notify_one();
+        }
+
+      private:
+        void writeFunc()
+        {
+            std::deque<std::string> messages;
+
+            while (true)
+            {
+                bool done;
+
+                {
+                    std::unique_lock<std::mutex> lock(m_mutex);
+                    m_condition.wait(lock, [this] { return m_done || !m_pending.empty(); });
+                    messages.swap(m_pending);
+                    done = m_done;
+                }
+
+                for (const std::string& message : messages)
+                    m_file << message;
+
+                messages.clear();
+                m_file.flush();
+
+                if (done)
+                    break;
+            }
+        }
+
+        std::ofstream               m_file;
+        std::thread                 m_thread;
+        std::mutex                  m_mutex;
+        std::condition_variable     m_condition;
+        std::deque<std::string>     m_pending;
+        bool                        m_done;
+    };
 }
 
 MStatus initialize()
 {
+    gMainThreadId = std::this_thread::get_id();
+
+    if (MGlobal::mayaState() == MGlobal::kInteractive)
+    {
+        MStatus status;
+        gFlushTimerCallbackId = MTimerMessage::addTimerCallback(
+            FlushTimerPeriod,
+            &flushTimerCallback,
+            nullptr,
+            &status);
+
+        if (!status)
+            gFlushTimerCallbackId = 0;
+    }
+
     asr::global_logger().add_target(&gLogTarget);
 
     asf::LogMessage::Category level = asf::LogMessage::Warning;
@@ -122,9 +594,34 @@ MStatus initialize()
 MStatus uninitialize()
 {
     asr::global_logger().remove_target(&gLogTarget);
+
+    if (gFlushTimerCallbackId != 0)
+    {
+        MMessage::removeCallback(gFlushTimerCallbackId);
+        gFlushTimerCallbackId = 0;
+    }
+
+    // Display any pending messages.
+    flushMessages(true);
     return MS::kSuccess;
 }
 
+void flush()
+{
+    assert(std::this_thread::get_id() == gMainThreadId);
+    flushMessages(false);
+}
+
+asf::auto_release_ptr<asf::ILogTarget> createAsyncFileLogTarget(const char* filename)
+{
+    asf::auto_release_ptr<AsyncFileLogTarget> logTarget(new AsyncFileLogTarget());
+
+    if (!logTarget->open(filename))
+        return asf::auto_release_ptr<asf::ILogTarget>();
+
+    return asf::auto_release_ptr<asf::ILogTarget>(logTarget.release());
+}
+
 } // namespace Logger.
 
 ScopedSetLoggerVerbosity::ScopedSetLoggerVerbosity(foundation::LogMessage::Category newLevel)
@@ -138,6 +635,17 @@ ScopedSetLoggerVerbosity::~ScopedSetLoggerVerbosity()
     asr::global_logger().set_verbosity_level(m_prevLevel);
 }
 
+ScopedThreadLogFilter::ScopedThreadLogFilter(foundation::LogMessage::Category minLevel)
+{
+    m_prevLevel = Logger::gThreadLogLevel;
+    Logger::gThreadLogLevel = minLevel;
+}
+
+ScopedThreadLogFilter::~ScopedThreadLogFilter()
+{
+    Logger::gThreadLogLevel = m_prevLevel;
+}
+
 ScopedLogTarget::ScopedLogTarget()
 {
 }
@@ -49,6 +49,13 @@ namespace Logger
 MStatus initialize();
 MStatus uninitialize();
 
+// Display the messages logged from other threads. Must be called from the main thread.
+void flush();
+
+// Create a log target that writes to a file from a background thread.
+// Returns an empty pointer if the file could not be opened.
+foundation::auto_release_ptr<foundation::ILogTarget> createAsyncFileLogTarget(const char* filename);
+
 } // namespace Logger
 
 //
@@ -66,6 +73,23 @@ class ScopedSetLoggerVerbosity
     foundation::LogMessage::Category m_prevLevel;
 };
 
+//
+// RAII class to hide the messages below a level logged from the current thread.
+// Unlike ScopedSetLoggerVerbosity, messages logged from other threads, including
+// the threads started by a renderer, are not affected.
+//
+
+class ScopedThreadLogFilter
+  : public foundation::NonCopyable
+{
+  public:
+    explicit ScopedThreadLogFilter(foundation::LogMessage::Category minLevel);
+    ~ScopedThreadLogFilter();
+
+  private:
+    foundation::LogMessage::Category m_prevLevel;
+};
+
 //
 // Helper class to manage appleseed log targets in an exception safe way.
 //
@@ -38,83 +38,133 @@
 // appleseed.foundation headers.
 #include "foundation/containers/dictionary.h"
 
+// Standard headers.
+#include <algorithm>
+
 namespace asf = foundation;
 namespace asr = renderer;
 
-uint64_t rotl64(uint64_t x, int8_t r)
+namespace
 {
-    return (x << r) | (x >> (64 - r));
-}
+    const uint64_t c1 = 0x87c37b91114253d5;
+    const uint64_t c2 = 0x4cf5ad432745937f;
 
-uint64_t fmix(uint64_t k)
-{
-    k ^= k >> 33;
-    k *= 0xff51afd7ed558ccd;
-    k ^= k >> 33;
-    k *= 0xc4ceb9fe1a85ec53;
-    k ^= k >> 33;
+    inline uint64_t rotl64(uint64_t x, int8_t r)
+    {
+        return (x << r) | (x >> (64 - r));
+    }
 
-    return k;
+    inline uint64_t fmix(uint64_t k)
+    {
+        k ^= k >> 33;
+        k *= 0xff51afd7ed558ccd;
+        k ^= k >> 33;
+        k *= 0xc4ceb9fe1a85ec53;
+        k ^= k >> 33;
+
+        return k;
+    }
+
+    inline uint64_t load64(const uint8_t* p)
+    {
+        uint64_t x;
+        std::memcpy(&x, p, sizeof(uint64_t));
+        return x;
+    }
 }
 
 MurmurHash::MurmurHash()
   : m_h1(0)
   , m_h2(0)
+  , m_length(0)
+  , m_tailSize(0)
+  , m_finalized(false)
+  , m_f1(0)
+  , m_f2(0)
 {
 }
 
 MurmurHash::MurmurHash(const MurmurHash& other)
-  : m_h1(other.m_h1)
-  , m_h2(other.m_h2)
 {
+    *this = other;
 }
 
 const MurmurHash& MurmurHash::operator=(const MurmurHash& other)
 {
     m_h1 = other.m_h1;
     m_h2 = other.m_h2;
+    m_length = other.m_length;
+    std::memcpy(m_tail, other.m_tail, other.m_tailSize);
+    m_tailSize = other.m_tailSize;
+    m_finalized = other.m_finalized;
+    m_f1 = other.m_f1;
+    m_f2 = other.m_f2;
     return *this;
 }
 
-void MurmurHash::append(const void* data, size_t bytes)
+void MurmurHash::processBlock(const uint8_t* block)
 {
-    const int nBlocks = static_cast<int>(bytes) / 16;
+    uint64_t k1 = load64(block);
+    uint64_t k2 = load64(block + 8);
 
-    const uint64_t c1 = 0x87c37b91114253d5;
-    const uint64_t c2 = 0x4cf5ad432745937f;
+    k1 *= c1; k1  = rotl64(k1, 31); k1 *= c2; m_h1 ^= k1;
 
-    // local copies of m_h1, and m_h2. we'll work
-    // with these before copying back at the end.
-    // this gives the optimiser more freedom to do
-    // its thing.
-    uint64_t h1 = m_h1;
-    uint64_t h2 = m_h2;
+    m_h1 = rotl64(m_h1, 27); m_h1 += m_h2; m_h1 = m_h1*5 + 0x52dce729;
 
-    // body
+    k2 *= c2; k2  = rotl64(k2, 33); k2 *= c1; m_h2 ^= k2;
 
-    const uint64_t* blocks = (const uint64_t *)data;
-    for (int i = 0; i < nBlocks; i++)
-    {
-        uint64_t k1 = blocks[i*2];
-        uint64_t k2 = blocks[i*2+1];
+    m_h2 = rotl64(m_h2, 31); m_h2 += m_h1; m_h2 = m_h2*5 + 0x38495ab5;
+}
 
-        k1 *= c1; k1  = rotl64(k1, 31); k1 *= c2; h1 ^= k1;
+void MurmurHash::appendBytes(const void* data, size_t bytes)
+{
+    const uint8_t* p = static_cast<const uint8_t*>(data);
 
-        h1 = rotl64(h1, 27); h1 += h2; h1 = h1*5 + 0x52dce729;
+    m_length += bytes;
+    m_finalized = false;
 
-        k2 *= c2; k2  = rotl64(k2, 33); k2 *= c1; h2 ^= k2;
+    // Complete the pending partial block first.
+    if (m_tailSize != 0)
+    {
+        const size_t n = std::min(bytes, sizeof(m_tail) - m_tailSize);
+        std::memcpy(m_tail + m_tailSize, p, n);
+        m_tailSize += n;
+        p += n;
+        bytes -= n;
 
-        h2 = rotl64(h2, 31); h2 += h1; h2 = h2*5 + 0x38495ab5;
+        if (m_tailSize < sizeof(m_tail))
+            return;
+
+        processBlock(m_tail);
+        m_tailSize = 0;
     }
 
+    // body
+
+    for (; bytes >= 16; p += 16, bytes -= 16)
+        processBlock(p);
+
+    // Keep the remaining bytes for the next append or the finalization.
+    std::memcpy(m_tail, p, bytes);
+    m_tailSize = bytes;
+}
+
+void MurmurHash::finalize() const
+{
+    if (m_finalized)
+        return;
+
+    uint64_t h1 = m_h1;
+    uint64_t h2 = m_h2;
+
     // tail
 
-    const uint8_t * tail = ((const uint8_t*)data) + nBlocks*16;
+    const uint8_t* tail = m_tail;
 
     uint64_t k1 = 0;
     uint64_t k2 = 0;
 
-    switch(bytes & 15)
+    switch(m_tailSize)
     {
     case 15: k2 ^= uint64_t(tail[14]) << 48;
     case 14: k2 ^= uint64_t(tail[13]) << 40;
@@ -138,7 +188,7 @@ void MurmurHash::append(const void* data, size_t bytes)
 
     // finalisation
 
-    h1 ^= bytes; h2 ^= bytes;
+    h1 ^= m_length; h2 ^= m_length;
 
     h1 += h2;
     h2 += h1;
@@ -149,36 +199,51 @@ void MurmurHash::append(const void* data, size_t bytes)
     h1 += h2;
     h2 += h1;
 
-    m_h1 = h1;
-    m_h2 = h2;
+    m_f1 = h1;
+    m_f2 = h2;
+    m_finalized = true;
 }
 
 bool MurmurHash::operator==(const MurmurHash& other) const
 {
-    return m_h1 == other.m_h1 && m_h2 == other.m_h2;
+    finalize();
+    other.finalize();
+    return m_f1 == other.m_f1 && m_f2 == other.m_f2;
 }
 
 bool MurmurHash::operator!=(const MurmurHash& other) const
 {
-    return m_h1 != other.m_h1 || m_h2 != other.m_h2;
+    return !(*this == other);
 }
 
 bool MurmurHash::operator<(const MurmurHash& other) const
 {
-    return m_h1 < other.m_h1 ||(m_h1 == other.m_h1 && m_h2 < other.m_h2);
+    finalize();
+    other.finalize();
+    return m_f1 < other.m_f1 ||(m_f1 == other.m_f1 && m_f2 < other.m_f2);
+}
+
+void MurmurHash::appendString(const char* str, const size_t length)
+{
+    append(static_cast<uint64_t>(length));
+    appendBytes(str, length);
 }
 
 std::string MurmurHash::toString() const
 {
+    finalize();
+
     std::stringstream s;
     s << std::hex << std::setfill('0')
-      << std::setw(16) << m_h1
-      << std::setw(16) << m_h2;
+      << std::setw(16) << m_f1
+      << std::setw(16) << m_f2;
     return s.str();
 }
 
 void MurmurHash::append(const asf::StringDictionary& dictionary)
 {
+    append(static_cast<uint64_t>(dictionary.size()));
+
     for (auto it = dictionary.begin(), e = dictionary.end(); it != e; ++it)
     {
         append(it.key());
@@ -189,6 +254,7 @@ void MurmurHash::append(const asf::StringDictionary& dictionary)
 void MurmurHash::append(const asf::Dictionary& dictionary)
 {
     append(dictionary.strings());
+    append(static_cast<uint64_t>(dictionary.dictionaries().size()));
 
     for (auto it = dictionary.dictionaries().begin(), e = dictionary.dictionaries().end(); it != e; ++it)
     {
@@ -52,6 +52,9 @@ namespace renderer   { class ParamArray; }
 // A nice class for hashing arbitrary chunks of data, based on
 // code available at http://code.google.com/p/smhasher.
 //
+// The data is hashed as a single stream: appended bytes are processed
+// in 16 bytes blocks and the hash is finalized only when queried.
+//
 // From that page :
 //
 // "All MurmurHash versions are public domain software, and the
@@ -75,22 +78,31 @@ class MurmurHash
     template <typename T>
     void append(const T& x)
     {
-        append(&x, sizeof(T));
+        appendBytes(&x, sizeof(T));
+    }
+
+    // Append a contiguous array of count elements.
+    template <typename T>
+    void append(const T* data, const size_t count)
+    {
+        appendBytes(data, count * sizeof(T));
     }
 
+    // Strings are prefixed by their length, so that consecutive
+    // strings hash differently when split at different places.
     void append(const char* str)
     {
-        append(str, strlen(str));
+        appendString(str, strlen(str));
     }
 
     void append(const std::string& str)
     {
-        append(str.c_str(), str.size());
+        appendString(str.c_str(), str.size());
     }
 
     void append(const MString& str)
     {
-        append(str.asChar(), str.length());
+        appendString(str.asChar(), str.length());
     }
 
     void append(const foundation::StringDictionary& dictionary);
@@ -100,10 +112,22 @@ class MurmurHash
     void append(const renderer::ParamArray& params);
 
   private:
-    void append(const void* data, size_t bytes);
-
-    uint64_t m_h1;
-    uint64_t m_h2;
+    void appendString(const char* str, size_t length);
+    void appendBytes(const void* data, size_t bytes);
+    void processBlock(const uint8_t* block);
+    void finalize() const;
+
+    // Streaming state.
+    uint64_t            m_h1;
+    uint64_t            m_h2;
+    uint64_t            m_length;
+    uint8_t             m_tail[16];
+    size_t              m_tailSize;
+
+    // Finalized hash, computed on demand.
+    mutable bool        m_finalized;
+    mutable uint64_t    m_f1;
+    mutable uint64_t    m_f2;
 };
 
 std::ostream& operator<<(std::ostream& o, const MurmurHash& hash);
@@ -287,12 +287,7 @@ void PhysicalSkyLightNode::draw(
       break;
     }
 
-    if (style == M3dView::kFlatShaded || style == M3dView::kGouraudShaded)
-        drawSphereWireframe(size);
-    else
-        drawSphereWireframe(size);
-
-    drawAppleseedLogo(size);
+    drawSphereAndLogo(size);
 
     glPopAttrib();
     view.endGL();
@@ -305,6 +300,7 @@ MStatus PhysicalSkyLightNode::compute(const MPlug& plug, MDataBlock& dataBlock)
 
 PhysicalSkyLightData::PhysicalSkyLightData()
   : MUserData(false) // don't delete after draw
+  , m_size(0.0f)
 {
 }
 
@@ -314,13 +310,18 @@ MHWRender::MPxDrawOverride* PhysicalSkyLightDrawOverride::creator(const MObject&
 }
 
 PhysicalSkyLightDrawOverride::PhysicalSkyLightDrawOverride(const MObject& obj)
-  : MHWRender::MPxDrawOverride(obj, PhysicalSkyLightDrawOverride::draw)
+  : MHWRender::MPxDrawOverride(obj, nullptr)
 {
 }
 
 MHWRender::DrawAPI PhysicalSkyLightDrawOverride::supportedDrawAPIs() const
 {
-    return MHWRender::kOpenGL | MHWRender::kOpenGLCoreProfile;
+    return MHWRender::kAllDevices;
+}
+
+bool PhysicalSkyLightDrawOverride::hasUIDrawables() const
+{
+    return true;
 }
 
 bool PhysicalSkyLightDrawOverride::isBounded(const MDagPath& objPath, const MDagPath& cameraPath) const
@@ -349,63 +350,32 @@ MUserData* PhysicalSkyLightDrawOverride::prepareForDraw(
     if (!data)
         data = new PhysicalSkyLightData();
 
-    data->m_size = 1.0f;
-    AttributeUtils::get(objPath.node(), "size", data->m_size);
+    float size = 1.0f;
+    AttributeUtils::get(objPath.node(), "size", size);
+
+    // Only regenerate the geometry when the size changes.
+    if (size != data->m_size || data->m_lines.length() == 0)
+    {
+        data->m_size = size;
+        sphereAndLogoLines(size, data->m_lines);
+    }
+
     data->m_color = MHWRender::MGeometryUtilities::wireframeColor(objPath);
     return data;
 }
 
-void PhysicalSkyLightDrawOverride::draw(
-    const MHWRender::MDrawContext&  context,
+void PhysicalSkyLightDrawOverride::addUIDrawables(
+    const MDagPath&                 objPath,
+    MHWRender::MUIDrawManager&      drawManager,
+    const MHWRender::MFrameContext& frameContext,
     const MUserData*                data)
 {
     const PhysicalSkyLightData* drawData = dynamic_cast<const PhysicalSkyLightData*>(data);
     if (!drawData)
         return;
 
-    MStatus status;
-
-    const MMatrix transform = context.getMatrix(MHWRender::MDrawContext::kWorldViewMtx, &status);
-    if (status != MStatus::kSuccess)
-        return;
-
-    const MMatrix projection = context.getMatrix(MHWRender::MDrawContext::kProjectionMtx, &status);
-    if (status != MStatus::kSuccess)
-        return;
-
-    const unsigned int displayStyle = context.getDisplayStyle();
-
-    MHWRender::MRenderer* renderer = MHWRender::MRenderer::theRenderer();
-    if (!renderer)
-        return;
-
-    if (renderer->drawAPIIsOpenGL())
-    {
-        float color [3] = { drawData->m_color.r, drawData->m_color.g, drawData->m_color.b};
-        glColor3fv(color);
-
-        glMatrixMode(GL_MODELVIEW);
-        glPushMatrix();
-        glLoadMatrixd(transform.matrix[0]);
-
-        glMatrixMode (GL_PROJECTION);
-        glPushMatrix();
-        glLoadMatrixd(projection.matrix[0]);
-
-        glPushAttrib(GL_CURRENT_BIT);
-
-        if (displayStyle & MHWRender::MDrawContext::kGouraudShaded)
-            drawSphereWireframe(drawData->m_size);
-
-        if (displayStyle & MHWRender::MDrawContext::kWireFrame)
-            drawSphereWireframe(drawData->m_size);
-
-        drawAppleseedLogo(drawData->m_size);
-
-        glPopAttrib();
-
-        glPopMatrix();
-        glMatrixMode(GL_MODELVIEW);
-        glPopMatrix();
-    }
+    drawManager.beginDrawable();
+    drawManager.setColor(drawData->m_color);
+    drawManager.mesh(MHWRender::MUIDrawManager::kLines, drawData->m_lines);
+    drawManager.endDrawable();
 }
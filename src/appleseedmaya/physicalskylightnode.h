@@ -40,6 +40,7 @@
 #include <maya/MPxLocatorNode.h>
 #include <maya/MString.h>
 #include <maya/MTypeId.h>
+#include <maya/MUIDrawManager.h>
 #include <maya/MUserData.h>
 #include <maya/MViewport2Renderer.h>
 #include "appleseedmaya/_endmayaheaders.h"
@@ -89,8 +90,9 @@ class PhysicalSkyLightData
   public:
     PhysicalSkyLightData();
 
-    float   m_size;
-    MColor  m_color;
+    float       m_size;
+    MColor      m_color;
+    MPointArray m_lines;
 };
 
 class PhysicalSkyLightDrawOverride
@@ -115,8 +117,12 @@ class PhysicalSkyLightDrawOverride
         const MHWRender::MFrameContext& frameContext,
         MUserData*                      oldData) override;
 
-    static void draw(
-        const MHWRender::MDrawContext&  context,
-        const MUserData*                data);
+    bool hasUIDrawables() const override;
+
+    void addUIDrawables(
+        const MDagPath&                 objPath,
+        MHWRender::MUIDrawManager&      drawManager,
+        const MHWRender::MFrameContext& frameContext,
+        const MUserData*                data) override;
 };
 
@@ -28,25 +28,33 @@
 
 #pragma once
 
+// appleseed-maya headers.
+#include "appleseedmaya/attributeutils.h"
+#include "appleseedmaya/shaderparamencoder.h"
+
+// appleseed.renderer headers.
+#include "renderer/api/utility.h"
+
 // Maya headers.
 #include "appleseedmaya/_beginmayaheaders.h"
 #include <maya/MColor.h>
 #include <maya/MColorArray.h>
 #include <maya/MFloatArray.h>
+#include <maya/MPlug.h>
 #include "appleseedmaya/_endmayaheaders.h"
 
 // Standard headers.
-#include <sstream>
 #include <string>
 #include <vector>
 
 template <typename T>
 struct RampEntry
 {
-    RampEntry(int index, float pos, const T& value)
+    RampEntry(int index, float pos, const T& value, int interp = 0)
       : m_index(index)
       , m_pos(pos)
       , m_value(value)
+      , m_interp(interp)
     {
     }
 
@@ -58,6 +66,7 @@ struct RampEntry
     int     m_index;
     float   m_pos;
     T       m_value;
+    int     m_interp;
 };
 
 template <typename T> struct RampEntryTraits {};
@@ -71,9 +80,9 @@ template <> struct RampEntryTraits<MColor>
         return "color[]";
     }
 
-    static void outputValue(std::stringstream& ss, const MColor& value)
+    static MColor defaultValue()
     {
-        ss << value.r << " " << value.g << " " << value.b << " ";
+        return MColor(0.0f, 0.0f, 0.0f);
     }
 };
 
@@ -86,31 +95,82 @@ template <> struct RampEntryTraits<float>
         return "float[]";
     }
 
-    static void outputValue(std::stringstream& ss, const float& value)
+    static float defaultValue()
     {
-        ss << value << " ";
+        return 0.0f;
     }
 };
 
+// Read the entries of a Maya ramp array attribute. Each element is a compound
+// of a position, a value and optionally an interpolation, like the value
+// attribute of the remapValue node.
+template <typename T>
+void getRampEntries(const MPlug& plug, std::vector<RampEntry<T>>& entries)
+{
+    entries.clear();
+    entries.reserve(plug.numElements());
+
+    for (unsigned int i = 0, e = plug.numElements(); i < e; ++i)
+    {
+        const MPlug entry = plug.elementByPhysicalIndex(i);
+
+        float position = 0.0f;
+        AttributeUtils::get(entry.child(0), position);
+
+        T value = RampEntryTraits<T>::defaultValue();
+        AttributeUtils::get(entry.child(1), value);
+
+        int interp = 0;
+        if (entry.numChildren() > 2)
+            AttributeUtils::get(entry.child(2), interp);
+
+        entries.push_back(RampEntry<T>(static_cast<int>(i), position, value, interp));
+    }
+}
+
 template <typename T>
 void serializeRamp(
     const std::vector<RampEntry<T>>& entries,
     std::string&                     outValues,
     std::string&                     outPositions)
 {
-    std::stringstream ssp;
-    ssp << "float[] ";
-
-    std::stringstream ssv;
-    ssv << RampEntryTraits<T>::paramValueTypeName() << " ";
+    ShaderParamEncoder positions("float[]");
+    ShaderParamEncoder values(RampEntryTraits<T>::paramValueTypeName());
 
     for (size_t i = 0, e = entries.size(); i < e; ++i)
     {
-        ssp << entries[i].m_pos << " ";
-        RampEntryTraits<T>::outputValue(ssv, entries[i].m_value);
+        positions.add(entries[i].m_pos);
+        values.add(entries[i].m_value);
     }
 
-    outValues = ssv.str();
-    outPositions = ssp.str();
+    outValues = values.c_str();
+    outPositions = positions.c_str();
 }
 
+// Export the positions, values and interpolations of ramp entries as shader parameters.
+// The interpolations are not exported if interpsParamName is null.
+template <typename T>
+void exportRamp(
+    const std::vector<RampEntry<T>>& entries,
+    const char*                      positionsParamName,
+    const char*                      valuesParamName,
+    const char*                      interpsParamName,
+    renderer::ParamArray&            params)
+{
+    std::string values;
+    std::string positions;
+    serializeRamp(entries, values, positions);
+
+    params.insert(positionsParamName, positions.c_str());
+    params.insert(valuesParamName, values.c_str());
+
+    if (interpsParamName)
+    {
+        ShaderParamEncoder interps("int[]");
+
+        for (size_t i = 0, e = entries.size(); i < e; ++i)
+            interps.add(entries[i].m_interp);
+
+        params.insert(interpsParamName, interps.c_str());
+    }
+}
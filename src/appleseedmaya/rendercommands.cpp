@@ -157,42 +157,43 @@ void* ProgressiveRenderCommand::creator()
 
 MStatus ProgressiveRenderCommand::doIt(const MArgList& args)
 {
-    // Maybe we should check and fail instead of asserting?
-    //assert(MRenderView::doesRenderEditorExist());
-
-    /*
-    // In case we were rendering.
-    AppleseedSession::endSession();
-
-    AppleseedSession::Options options;
-
     MStatus status;
     MArgDatabase argData(syntax(), args, &status);
 
-    if (argData.isFlagSet("-width", &status))
-        status = argData.getFlagArgument("-width", 0, options.m_width);
-
-    if (argData.isFlagSet("-height", &status))
-        status = argData.getFlagArgument("-height", 0, options.m_height);
-
-    if (argData.isFlagSet("-camera", &status))
-        status = argData.getFlagArgument("-camera", 0, options.m_camera);
-
     MString action;
     if (argData.isFlagSet("-action", &status))
         status = argData.getFlagArgument("-action", 0, action);
 
-    if (action == "start")
+    if (action == "start" || action == "render")
     {
-        // ...
+        // Initialize options from the render globals.
+        AppleseedSession::Options options;
+
+        MCommonRenderSettingsData renderSettings;
+        MRenderUtil::getCommonRenderSettings(renderSettings);
+
+        options.m_width = renderSettings.width;
+        options.m_height = renderSettings.height;
+
+        if (argData.isFlagSet("-width", &status))
+            status = argData.getFlagArgument("-width", 0, options.m_width);
+
+        if (argData.isFlagSet("-height", &status))
+            status = argData.getFlagArgument("-height", 0, options.m_height);
+
+        if (argData.isFlagSet("-camera", &status))
+            status = argData.getFlagArgument("-camera", 0, options.m_camera);
+
+        return AppleseedSession::progressiveRender(options);
     }
     else if (action == "stop")
     {
-        // ...
+        if (AppleseedSession::sessionMode() == AppleseedSession::ProgressiveRenderSession)
+            AppleseedSession::endSession();
     }
     else if (action == "refresh")
     {
-        // ...
+        AppleseedSession::refreshProgressiveRender();
     }
     else if (action == "running")
     {
@@ -202,22 +203,21 @@ MStatus ProgressiveRenderCommand::doIt(const MArgList& args)
     }
     else if (action == "pause")
     {
-        // ...
+        AppleseedSession::pauseProgressiveRender(true);
     }
-    else if (action == "region")
+    else if (action == "resume")
     {
-        // ...
+        AppleseedSession::pauseProgressiveRender(false);
     }
-    else if (action.length() == 0)
+    else if (action == "region")
     {
-        // default action here
+        AppleseedSession::updateProgressiveRenderRegion();
     }
     else
     {
         MGlobal::displayError("appleseedProgressiveRender: Unknown action argument.");
         return MS::kFailure;
     }
-    */
 
     return MS::kSuccess;
 }
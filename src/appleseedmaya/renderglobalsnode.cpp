@@ -137,8 +137,15 @@ MObject RenderGlobalsNode::m_shutterClose;
 
 MObject RenderGlobalsNode::m_renderingThreads;
 MObject RenderGlobalsNode::m_maxTextureCacheSize;
+MObject RenderGlobalsNode::m_prepareTextures;
+MObject RenderGlobalsNode::m_textureCacheDirectory;
+MObject RenderGlobalsNode::m_xgenFrustumCulling;
+MObject RenderGlobalsNode::m_xgenFrustumMargin;
+MObject RenderGlobalsNode::m_xgenFullDensityPixels;
+MObject RenderGlobalsNode::m_xgenMinDensity;
 
 MObject RenderGlobalsNode::m_useEmbree;
+MObject RenderGlobalsNode::m_incrementalBatchRender;
 
 MObject RenderGlobalsNode::m_denoiserMode;
 MStringArray RenderGlobalsNode::m_denoiserModeKeys;
@@ -181,6 +188,7 @@ MObject RenderGlobalsNode::m_renderStampString;
 
 MObject RenderGlobalsNode::m_logLevel;
 MObject RenderGlobalsNode::m_logFilename;
+MObject RenderGlobalsNode::m_exportTraceFilename;
 
 namespace
 {
@@ -563,10 +571,41 @@ MStatus RenderGlobalsNode::initialize()
     numAttrFn.setMin(16);
     CHECKED_ADD_ATTRIBUTE(m_maxTextureCacheSize, "maxTexCacheSize")
 
+    // Texture preparation.
+    m_prepareTextures = numAttrFn.create("prepareTextures", "prepareTextures", MFnNumericData::kBoolean, false, &status);
+    CHECKED_ADD_ATTRIBUTE(m_prepareTextures, "prepareTextures")
+
+    m_textureCacheDirectory = typedAttrFn.create("textureCacheDirectory", "textureCacheDirectory", MFnData::kString, &status);
+    typedAttrFn.setUsedAsFilename(true);
+    CHECKED_ADD_ATTRIBUTE(m_textureCacheDirectory, "textureCacheDirectory")
+
+    // XGen level of detail.
+    m_xgenFrustumCulling = numAttrFn.create("xgenFrustumCulling", "xgenFrustumCulling", MFnNumericData::kBoolean, false, &status);
+    CHECKED_ADD_ATTRIBUTE(m_xgenFrustumCulling, "xgenFrustumCulling")
+
+    m_xgenFrustumMargin = numAttrFn.create("xgenFrustumMargin", "xgenFrustumMargin", MFnNumericData::kFloat, 0.1, &status);
+    numAttrFn.setMin(0.0);
+    numAttrFn.setSoftMax(1.0);
+    CHECKED_ADD_ATTRIBUTE(m_xgenFrustumMargin, "xgenFrustumMargin")
+
+    m_xgenFullDensityPixels = numAttrFn.create("xgenFullDensityPixels", "xgenFullDensityPixels", MFnNumericData::kFloat, 0.0, &status);
+    numAttrFn.setMin(0.0);
+    numAttrFn.setSoftMax(100.0);
+    CHECKED_ADD_ATTRIBUTE(m_xgenFullDensityPixels, "xgenFullDensityPixels")
+
+    m_xgenMinDensity = numAttrFn.create("xgenMinDensity", "xgenMinDensity", MFnNumericData::kFloat, 0.01, &status);
+    numAttrFn.setMin(0.0);
+    numAttrFn.setMax(1.0);
+    CHECKED_ADD_ATTRIBUTE(m_xgenMinDensity, "xgenMinDensity")
+
     // Embree.
     m_useEmbree = numAttrFn.create("useEmbree", "useEmbree", MFnNumericData::kBoolean, false, &status);
     CHECKED_ADD_ATTRIBUTE(m_useEmbree, "useEmbree")
 
+    // Incremental batch render.
+    m_incrementalBatchRender = numAttrFn.create("incrementalBatchRender", "incrementalBatchRender", MFnNumericData::kBoolean, false, &status);
+    CHECKED_ADD_ATTRIBUTE(m_incrementalBatchRender, "incrementalBatchRender")
+
     // Environment light connection.
     m_envLightNode = msgAttrFn.create("envLight", "env", &status);
     CHECKED_ADD_ATTRIBUTE(m_envLightNode, "envLight")
@@ -712,6 +751,11 @@ MStatus RenderGlobalsNode::initialize()
     typedAttrFn.setUsedAsFilename(true);
     CHECKED_ADD_ATTRIBUTE(m_logFilename, "logFilename")
 
+    // Export trace filename.
+    m_exportTraceFilename = typedAttrFn.create("exportTraceFilename", "exportTraceFilename", MFnData::kString, &status);
+    typedAttrFn.setUsedAsFilename(true);
+    CHECKED_ADD_ATTRIBUTE(m_exportTraceFilename, "exportTraceFilename")
+
     #undef CHECKED_ADD_ATTRIBUTE
 
     return status;
@@ -1312,3 +1356,52 @@ MString RenderGlobalsNode::logFilename(const MObject& globals)
     AttributeUtils::get(MPlug(globals, m_logFilename), filename);
     return filename;
 }
+
+MString RenderGlobalsNode::exportTraceFilename(const MObject& globals)
+{
+    MString filename;
+    AttributeUtils::get(MPlug(globals, m_exportTraceFilename), filename);
+    return filename;
+}
+
+bool RenderGlobalsNode::incrementalBatchRender(const MObject& globals)
+{
+    bool incremental = false;
+    AttributeUtils::get(MPlug(globals, m_incrementalBatchRender), incremental);
+    return incremental;
+}
+
+bool RenderGlobalsNode::prepareTextures(const MObject& globals)
+{
+    bool prepare = false;
+    AttributeUtils::get(MPlug(globals, m_prepareTextures), prepare);
+    return prepare;
+}
+
+MString RenderGlobalsNode::textureCacheDirectory(const MObject& globals)
+{
+    MString directory;
+    AttributeUtils::get(MPlug(globals, m_textureCacheDirectory), directory);
+    return directory;
+}
+
+void RenderGlobalsNode::collectXGenLodParameters(
+    const MObject&                              globals,
+    asr::ParamArray&                            params)
+{
+    bool frustumCulling = false;
+    if (AttributeUtils::get(MPlug(globals, m_xgenFrustumCulling), frustumCulling))
+        params.insert("lod_frustum_culling", frustumCulling);
+
+    float frustumMargin = 0.1f;
+    if (AttributeUtils::get(MPlug(globals, m_xgenFrustumMargin), frustumMargin))
+        params.insert("lod_frustum_margin", frustumMargin);
+
+    float fullDensityPixels = 0.0f;
+    if (AttributeUtils::get(MPlug(globals, m_xgenFullDensityPixels), fullDensityPixels))
+        params.insert("lod_full_density_pixels", fullDensityPixels);
+
+    float minDensity = 0.01f;
+    if (AttributeUtils::get(MPlug(globals, m_xgenMinDensity), minDensity))
+        params.insert("lod_min_density", minDensity);
+}
@@ -47,6 +47,7 @@
 #include "appleseedmaya/_endmayaheaders.h"
 
 // Forward declarations.
+namespace renderer { class ParamArray; }
 namespace renderer { class Project; }
 
 class RenderGlobalsNode
@@ -77,6 +78,17 @@ class RenderGlobalsNode
 
     static foundation::LogMessage::Category logLevel(const MObject& globals);
     static MString logFilename(const MObject& globals);
+    static MString exportTraceFilename(const MObject& globals);
+
+    static bool incrementalBatchRender(const MObject& globals);
+
+    static bool prepareTextures(const MObject& globals);
+    static MString textureCacheDirectory(const MObject& globals);
+
+    // Parameters of the XGen procedural level of detail.
+    static void collectXGenLodParameters(
+        const MObject&                              globals,
+        renderer::ParamArray&                       params);
 
   private:
     static MObject      m_passes;
@@ -162,9 +174,18 @@ class RenderGlobalsNode
     // System settings.
     static MObject      m_renderingThreads;
     static MObject      m_maxTextureCacheSize;
+    static MObject      m_prepareTextures;
+    static MObject      m_textureCacheDirectory;
+
+    // XGen level of detail.
+    static MObject      m_xgenFrustumCulling;
+    static MObject      m_xgenFrustumMargin;
+    static MObject      m_xgenFullDensityPixels;
+    static MObject      m_xgenMinDensity;
 
     // Experimental.
     static MObject      m_useEmbree;
+    static MObject      m_incrementalBatchRender;
 
     // Denoiser.
     static MObject      m_denoiserMode;
@@ -211,5 +232,6 @@ class RenderGlobalsNode
     // Logging.
     static MObject      m_logLevel;
     static MObject      m_logFilename;
+    static MObject      m_exportTraceFilename;
 };
 
@@ -55,7 +55,12 @@
 // Standard headers.
 #include <cassert>
 #include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <map>
 #include <memory>
+#include <mutex>
+#include <vector>
 
 namespace asf = foundation;
 namespace asr = renderer;
@@ -64,6 +69,258 @@ namespace
 {
     const int MaxHighlightSize = 8;
 
+    // RV_PIXEL and appleseed's RGBA float tiles share the same layout.
+    static_assert(sizeof(RV_PIXEL) == 4 * sizeof(float), "Unexpected RV_PIXEL layout");
+
+    //
+    // Pool of pixel buffers used to send tiles to the render view.
+    //  Buffers are returned to the pool when the render view job using them is done.
+    //
+
+    class PixelBufferPool
+    {
+      public:
+        PixelBufferPool()
+          : m_freeBytes(0)
+        {
+        }
+
+        ~PixelBufferPool()
+        {
+            for (auto it = m_freeBuffers.begin(), e = m_freeBuffers.end(); it != e; ++it)
+                delete[] it->m_pixels;
+        }
+
+        std::shared_ptr<RV_PIXEL> acquire(const size_t size)
+        {
+            RV_PIXEL* pixels = nullptr;
+            size_t capacity = size;
+
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+
+                // Most tiles have the same size, look at the most recently released buffers first.
+                for (auto it = m_freeBuffers.rbegin(), e = m_freeBuffers.rend(); it != e; ++it)
+                {
+                    if (it->m_size >= size)
+                    {
+                        pixels = it->m_pixels;
+                        capacity = it->m_size;
+                        m_freeBytes -= capacity * sizeof(RV_PIXEL);
+                        m_freeBuffers.erase(std::next(it).base());
+                        break;
+                    }
+                }
+            }
+
+            if (pixels == nullptr)
+                pixels = new RV_PIXEL[size];
+
+            return std::shared_ptr<RV_PIXEL>(
+                pixels,
+                [this, capacity](RV_PIXEL* p) { release(p, capacity); });
+        }
+
+      private:
+        struct Buffer
+        {
+            RV_PIXEL*   m_pixels;
+            size_t      m_size;
+        };
+
+        // Maximum amount of memory kept in unused buffers.
+        static const size_t MaxFreeBytes = 64 * 1024 * 1024;
+
+        void release(RV_PIXEL* pixels, const size_t size)
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+
+                if (m_freeBytes + size * sizeof(RV_PIXEL) <= MaxFreeBytes)
+                {
+                    Buffer buffer = { pixels, size };
+                    m_freeBuffers.push_back(buffer);
+                    m_freeBytes += size * sizeof(RV_PIXEL);
+                    return;
+                }
+            }
+
+            delete[] pixels;
+        }
+
+        std::mutex          m_mutex;
+        std::vector<Buffer> m_freeBuffers;
+        size_t              m_freeBytes;
+    };
+
+    PixelBufferPool& pixelBufferPool()
+    {
+        // Buffers can outlive the tile callbacks, in pending render view jobs.
+        static PixelBufferPool pool;
+        return pool;
+    }
+
+    // Copy a row of RGBA float pixels to the render view format.
+    void copyPixelRow(const float* src, RV_PIXEL* dst, const size_t count)
+    {
+        std::memcpy(dst, src, count * sizeof(RV_PIXEL));
+    }
+}
+
+//
+// Pending render view updates.
+//  Tiles rendered since the last update are kept here, newer pixels replacing
+//  older ones, and sent to the render view in a single idle job.
+//
+
+class RenderViewUpdates
+  : public std::enable_shared_from_this<RenderViewUpdates>
+{
+  public:
+    RenderViewUpdates(
+        RendererController& rendererController,
+        ComputationPtr      computation)
+      : m_rendererController(rendererController)
+      , m_computation(computation)
+      , m_updateScheduled(false)
+    {
+    }
+
+    void push(
+        const int                   xmin,
+        const int                   ymin,
+        const int                   xmax,
+        const int                   ymax,
+        std::shared_ptr<RV_PIXEL>   pixels)
+    {
+        const Tile tile = { xmin, ymin, xmax, ymax, pixels };
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_tiles[std::make_pair(ymin, xmin)] = tile;
+
+        if (!m_updateScheduled)
+        {
+            m_updateScheduled = true;
+
+            // Keep the pending tiles alive until the job runs.
+            RenderViewUpdatesPtr self = shared_from_this();
+            IdleJobQueue::pushJob([self]() { self->update(); });
+        }
+    }
+
+  private:
+    struct Tile
+    {
+        int                         m_xmin;
+        int                         m_ymin;
+        int                         m_xmax;
+        int                         m_ymax;
+        std::shared_ptr<RV_PIXEL>   m_pixels;
+    };
+
+    // Tiles sorted by row, then by column.
+    typedef std::map<std::pair<int, int>, Tile> TileMap;
+
+    void update()
+    {
+        TileMap tiles;
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            tiles.swap(m_tiles);
+            m_updateScheduled = false;
+        }
+
+        if (m_computation && m_computation->isInterruptRequested())
+        {
+            m_rendererController.set_status(RendererController::AbortRendering);
+            return;
+        }
+
+        asf::AABB2i bbox;
+        bbox.invalidate();
+
+        // Merge horizontally adjacent tiles of the same height into spans.
+        for (auto first = tiles.begin(), e = tiles.end(); first != e;)
+        {
+            auto last = first;
+            auto next = std::next(first);
+            int width = first->second.m_xmax - first->second.m_xmin + 1;
+
+            while (next != e &&
+                   next->second.m_ymin == first->second.m_ymin &&
+                   next->second.m_ymax == first->second.m_ymax &&
+                   next->second.m_xmin == last->second.m_xmax + 1)
+            {
+                width += next->second.m_xmax - next->second.m_xmin + 1;
+                last = next++;
+            }
+
+            updateSpan(first, next, width);
+
+            bbox.insert(asf::Vector2i(first->second.m_xmin, first->second.m_ymin));
+            bbox.insert(asf::Vector2i(last->second.m_xmax, last->second.m_ymax));
+            first = next;
+        }
+
+        if (bbox.is_valid())
+        {
+            MRenderView::refresh(
+                static_cast<unsigned int>(bbox.min.x),
+                static_cast<unsigned int>(bbox.max.x),
+                static_cast<unsigned int>(bbox.min.y),
+                static_cast<unsigned int>(bbox.max.y));
+        }
+    }
+
+    void updateSpan(
+        TileMap::const_iterator     first,
+        TileMap::const_iterator     last,
+        const int                   width)
+    {
+        const Tile& firstTile = first->second;
+        const unsigned int xmin = static_cast<unsigned int>(firstTile.m_xmin);
+        const unsigned int ymin = static_cast<unsigned int>(firstTile.m_ymin);
+        const unsigned int ymax = static_cast<unsigned int>(firstTile.m_ymax);
+        const unsigned int xmax = xmin + static_cast<unsigned int>(width) - 1;
+
+        // Single tile, no copy needed.
+        if (std::next(first) == last)
+        {
+            MRenderView::updatePixels(xmin, xmax, ymin, ymax, firstTile.m_pixels.get(), true);
+            return;
+        }
+
+        // Interleave the rows of the tiles in a single buffer.
+        const size_t height = ymax - ymin + 1;
+        std::shared_ptr<RV_PIXEL> pixels = pixelBufferPool().acquire(width * height);
+
+        size_t offset = 0;
+        for (auto it = first; it != last; ++it)
+        {
+            const size_t tileWidth = it->second.m_xmax - it->second.m_xmin + 1;
+            const RV_PIXEL* src = it->second.m_pixels.get();
+            RV_PIXEL* dst = pixels.get() + offset;
+
+            for (size_t y = 0; y < height; ++y, src += tileWidth, dst += width)
+                copyPixelRow(reinterpret_cast<const float*>(src), dst, tileWidth);
+
+            offset += tileWidth;
+        }
+
+        MRenderView::updatePixels(xmin, xmax, ymin, ymax, pixels.get(), true);
+    }
+
+    RendererController& m_rendererController;
+    ComputationPtr      m_computation;
+    std::mutex          m_mutex;
+    TileMap             m_tiles;
+    bool                m_updateScheduled;
+};
+
+namespace
+{
+
     class RenderViewTileCallback
       : public renderer::TileCallbackBase
     {
@@ -72,11 +329,13 @@ namespace
             const asf::AABB2i&      displayWindow,
             const asf::AABB2i&      dataWindow,
             RendererController&     rendererController,
-            ComputationPtr&         computation)
+            ComputationPtr&         computation,
+            RenderViewUpdatesPtr    updates)
           : m_displayWindow(displayWindow)
           , m_dataWindow(dataWindow)
           , m_rendererController(rendererController)
           , m_computation(computation)
+          , m_updates(updates)
         {
             for (int i = 0; i < MaxHighlightSize; ++i)
             {
@@ -204,47 +463,6 @@ namespace
             ComputationPtr      m_computation;
         };
 
-        struct WriteTileToRenderView
-        {
-            WriteTileToRenderView(
-                const size_t                    xmin,
-                const size_t                    ymin,
-                const size_t                    xmax,
-                const size_t                    ymax,
-                std::shared_ptr<RV_PIXEL>       pixels,
-                RendererController&             rendererController,
-                ComputationPtr                  computation)
-              : m_xmin(static_cast<unsigned int>(xmin))
-              , m_ymin(static_cast<unsigned int>(ymin))
-              , m_xmax(static_cast<unsigned int>(xmax))
-              , m_ymax(static_cast<unsigned int>(ymax))
-              , m_pixels(pixels)
-              , m_rendererController(rendererController)
-              , m_computation(computation)
-            {
-            }
-
-            void operator()()
-            {
-                if (m_computation && m_computation->isInterruptRequested())
-                {
-                    m_rendererController.set_status(RendererController::AbortRendering);
-                    return;
-                }
-
-                MRenderView::updatePixels(m_xmin, m_xmax, m_ymin, m_ymax, m_pixels.get(), true);
-                MRenderView::refresh(m_xmin, m_xmax, m_ymin, m_ymax);
-            }
-
-            const unsigned int              m_xmin;
-            const unsigned int              m_ymin;
-            const unsigned int              m_xmax;
-            const unsigned int              m_ymax;
-            std::shared_ptr<RV_PIXEL>       m_pixels;
-            RendererController&             m_rendererController;
-            ComputationPtr                  m_computation;
-        };
-
         void pre_render(
             const size_t        x,
             const size_t        y,
@@ -293,28 +511,19 @@ namespace
 
             const size_t w = xmax - xmin + 1;
             const size_t h = ymax - ymin + 1;
-            std::shared_ptr<RV_PIXEL> pixels(new RV_PIXEL[w * h], ArrayDeleter<RV_PIXEL>());
+            std::shared_ptr<RV_PIXEL> pixels = pixelBufferPool().acquire(w * h);
             RV_PIXEL* p = pixels.get();
 
             // Copy and flip the tile verticaly (Maya's renderview is y up).
-            for (int j = ymax; j >= ymin; --j)
+            const size_t x = xmin - x0;
+            for (int j = ymax; j >= ymin; --j, p += w)
             {
-                size_t y = j - y0;
-
-                for (int i = xmin; i <= xmax; ++i)
-                {
-                    const size_t x = i - x0;
-                    p->r = tile.get_component<float>(x, y, 0);
-                    p->g = tile.get_component<float>(x, y, 1);
-                    p->b = tile.get_component<float>(x, y, 2);
-                    p->a = tile.get_component<float>(x, y, 3);
-                    p++;
-                }
+                const size_t y = j - y0;
+                copyPixelRow(reinterpret_cast<const float*>(tile.pixel(x, y)), p, w);
             }
 
             flip_pixel_interval(displayWindowHeight(), ymin, ymax);
-            WriteTileToRenderView tileJob(xmin, ymin, xmax, ymax, pixels, m_rendererController, m_computation);
-            IdleJobQueue::pushJob(tileJob);
+            m_updates->push(xmin, ymin, xmax, ymax, pixels);
         }
 
         int displayWindowHeight() const
@@ -339,11 +548,12 @@ namespace
             return true;
         }
 
-        RV_PIXEL            m_highlightPixels[MaxHighlightSize];
-        const asf::AABB2i   m_displayWindow;
-        const asf::AABB2i   m_dataWindow;
-        RendererController& m_rendererController;
-        ComputationPtr      m_computation;
+        RV_PIXEL                m_highlightPixels[MaxHighlightSize];
+        const asf::AABB2i       m_displayWindow;
+        const asf::AABB2i       m_dataWindow;
+        RendererController&     m_rendererController;
+        ComputationPtr          m_computation;
+        RenderViewUpdatesPtr    m_updates;
     };
 }
 
@@ -352,6 +562,7 @@ RenderViewTileCallbackFactory::RenderViewTileCallbackFactory(
     ComputationPtr       computation)
   : m_rendererController(rendererController)
   , m_computation(computation)
+  , m_updates(std::make_shared<RenderViewUpdates>(rendererController, computation))
 {
 }
 
@@ -371,7 +582,8 @@ renderer::ITileCallback* RenderViewTileCallbackFactory::create()
         m_displayWindow,
         m_dataWindow,
         m_rendererController,
-        m_computation);
+        m_computation,
+        m_updates);
 }
 
 void RenderViewTileCallbackFactory::renderViewStart(const renderer::Frame& frame)
@@ -48,10 +48,14 @@
 
 // Standard headers.
 #include <cstddef>
+#include <memory>
 
 // Forward declarations.
 namespace foundation    { class Tile; }
 namespace renderer      { class Frame; }
+class RenderViewUpdates;
+
+typedef std::shared_ptr<RenderViewUpdates> RenderViewUpdatesPtr;
 
 
 class RenderViewTileCallbackFactory
@@ -71,9 +75,10 @@ class RenderViewTileCallbackFactory
     void renderViewStart(const renderer::Frame& frame);
 
   private:
-    RendererController& m_rendererController;
-    ComputationPtr      m_computation;
-    foundation::AABB2i  m_displayWindow;
-    foundation::AABB2i  m_dataWindow;
+    RendererController&     m_rendererController;
+    ComputationPtr          m_computation;
+    foundation::AABB2i      m_displayWindow;
+    foundation::AABB2i      m_dataWindow;
+    RenderViewUpdatesPtr    m_updates;
 };
 
@@ -0,0 +1,246 @@
+
+//
+// This source file is part of appleseed.
+// Visit https://appleseedhq.net/ for additional information and resources.
+//
+// This software is released under the MIT license.
+//
+// Copyright (c) 2019 Esteban Tovagliari, The appleseedhq Organization
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// Interface header.
+#include "shaderparamencoder.h"
+
+// appleseed-maya headers.
+#include "appleseedmaya/logger.h"
+
+// Standard headers.
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+namespace
+{
+    const double PowersOf10[] =
+    {
+        1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,
+        1e8,  1e9,  1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+        1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+
+    // Numbers outside of this range are written in scientific notation.
+    const int MinFixedExponent = -6;
+    const int MaxFixedExponent = 15;
+
+    void appendInteger(std::string& s, std::uint64_t value)
+    {
+        char digits[24];
+        int n = 0;
+
+        do
+        {
+            digits[n++] = static_cast<char>('0' + value % 10);
+            value /= 10;
+        } while (value != 0);
+
+        while (n != 0)
+            s += digits[--n];
+    }
+
+    // Append value * 10^-decimals, without trailing zeros.
+    void appendFixed(std::string& s, const std::uint64_t scaled, const int decimals)
+    {
+        std::string digits;
+        appendInteger(digits, scaled);
+
+        const int length = static_cast<int>(digits.size());
+
+        if (length <= decimals)
+        {
+            s += '0';
+            digits.insert(0, static_cast<size_t>(decimals - length), '0');
+        }
+        else
+            s.append(digits, 0, static_cast<size_t>(length - decimals));
+
+        size_t fractionBegin = digits.size() - static_cast<size_t>(decimals);
+        size_t fractionEnd = digits.size();
+
+        while (fractionEnd > fractionBegin && digits[fractionEnd - 1] == '0')
+            --fractionEnd;
+
+        if (fractionEnd > fractionBegin)
+        {
+            s += '.';
+            s.append(digits, fractionBegin, fractionEnd - fractionBegin);
+        }
+    }
+
+    void appendScientific(std::string& s, const double value, const int significantDigits)
+    {
+        char buffer[32];
+        std::snprintf(buffer, sizeof(buffer), "%.*e", significantDigits - 1, value);
+
+        // Some locales use a comma as decimal separator.
+        std::replace(buffer, buffer + std::strlen(buffer), ',', '.');
+        s += buffer;
+    }
+
+    template <typename T>
+    void appendNumber(std::string& s, T value, const int minDigits, const int maxDigits)
+    {
+        if (!std::isfinite(value) || value == T(0))
+        {
+            s += '0';
+            return;
+        }
+
+        if (value < T(0))
+        {
+            s += '-';
+            value = -value;
+        }
+
+        const double v = static_cast<double>(value);
+        const int exponent = static_cast<int>(std::floor(std::log10(v)));
+
+        if (exponent < MinFixedExponent || exponent >= MaxFixedExponent)
+        {
+            appendScientific(s, v, maxDigits);
+            return;
+        }
+
+        // Find the fewest significant digits that read back to the same value.
+        std::uint64_t scaled = 0;
+        int decimals = 0;
+
+        for (int digits = minDigits; digits <= maxDigits; ++digits)
+        {
+            decimals = std::max(0, digits - 1 - exponent);
+            scaled = static_cast<std::uint64_t>(std::llround(v * PowersOf10[decimals]));
+
+            if (static_cast<T>(static_cast<double>(scaled) / PowersOf10[decimals]) == value)
+                break;
+        }
+
+        appendFixed(s, scaled, decimals);
+    }
+}
+
+void appendNumber(std::string& s, const float value)
+{
+    appendNumber<float>(s, value, 6, 9);
+}
+
+void appendNumber(std::string& s, const double value)
+{
+    appendNumber<double>(s, value, 6, 15);
+}
+
+ShaderParamEncoder::ShaderParamEncoder(const char* typeName)
+{
+    reset(typeName);
+}
+
+void ShaderParamEncoder::reset(const char* typeName)
+{
+    m_value = typeName;
+    m_typeLength = m_value.size();
+}
+
+void ShaderParamEncoder::add(const float value)
+{
+    if (!std::isfinite(value))
+        warnNonFinite();
+
+    separator();
+    appendNumber(m_value, value);
+}
+
+void ShaderParamEncoder::add(const double value)
+{
+    if (!std::isfinite(value))
+        warnNonFinite();
+
+    separator();
+    appendNumber(m_value, value);
+}
+
+void ShaderParamEncoder::add(const int value)
+{
+    separator();
+
+    if (value < 0)
+    {
+        m_value += '-';
+        appendInteger(m_value, static_cast<std::uint64_t>(-static_cast<std::int64_t>(value)));
+    }
+    else
+        appendInteger(m_value, static_cast<std::uint64_t>(value));
+}
+
+void ShaderParamEncoder::add(const bool value)
+{
+    separator();
+    m_value += value ? '1' : '0';
+}
+
+void ShaderParamEncoder::add(const char* value)
+{
+    separator();
+    m_value += value;
+}
+
+void ShaderParamEncoder::add(const MString& value)
+{
+    add(value.asChar());
+}
+
+void ShaderParamEncoder::add(const MColor& value)
+{
+    add(value.r);
+    add(value.g);
+    add(value.b);
+}
+
+bool ShaderParamEncoder::empty() const
+{
+    return m_value.size() == m_typeLength;
+}
+
+const char* ShaderParamEncoder::c_str() const
+{
+    return m_value.c_str();
+}
+
+void ShaderParamEncoder::separator()
+{
+    m_value += ' ';
+}
+
+void ShaderParamEncoder::warnNonFinite() const
+{
+    // OSL can't parse infinities and NaNs.
+    RENDERER_LOG_WARNING(
+        "Non-finite value in %s shader parameter, writing 0 instead.",
+        m_value.substr(0, m_typeLength).c_str());
+}
@@ -0,0 +1,82 @@
+
+//
+// This source file is part of appleseed.
+// Visit https://appleseedhq.net/ for additional information and resources.
+//
+// This software is released under the MIT license.
+//
+// Copyright (c) 2019 Esteban Tovagliari, The appleseedhq Organization
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+#pragma once
+
+// Maya headers.
+#include "appleseedmaya/_beginmayaheaders.h"
+#include <maya/MColor.h>
+#include <maya/MString.h>
+#include "appleseedmaya/_endmayaheaders.h"
+
+// Standard headers.
+#include <string>
+
+//
+// ShaderParamEncoder.
+//
+// Formats OSL shader parameter values, like "color 1 0.5 0",
+// without going through streams and locales.
+//
+// Floats are written with the fewest digits that read back
+// to the same value. OSL can't read infinities and NaNs: they
+// are written as 0 and a warning is logged.
+//
+
+class ShaderParamEncoder
+{
+  public:
+    // Start a value of the given OSL type, for example "color" or "float[]".
+    explicit ShaderParamEncoder(const char* typeName);
+
+    // Discard the current value and start a new one.
+    void reset(const char* typeName);
+
+    void add(const float value);
+    void add(const double value);
+    void add(const int value);
+    void add(const bool value);
+    void add(const char* value);
+    void add(const MString& value);
+    void add(const MColor& value);
+
+    // Return true if no values were added.
+    bool empty() const;
+
+    const char* c_str() const;
+
+  private:
+    std::string m_value;
+    size_t      m_typeLength;
+
+    void separator();
+    void warnNonFinite() const;
+};
+
+// Append the shortest decimal representation of a number to a string.
+void appendNumber(std::string& s, const float value);
+void appendNumber(std::string& s, const double value);
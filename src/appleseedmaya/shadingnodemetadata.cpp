@@ -44,12 +44,17 @@
 
 // Maya headers.
 #include "appleseedmaya/_beginmayaheaders.h"
+#include <maya/MNodeClass.h>
+#include <maya/MObjectHandle.h>
 #include <maya/MPlug.h>
 #include "appleseedmaya/_endmayaheaders.h"
 
 // Standard headers.
+#include <cstdint>
 #include <cstdlib>
 #include <map>
+#include <string>
+#include <utility>
 #include <vector>
 
 namespace asr = renderer;
@@ -91,6 +96,80 @@ bool OSLMetadataExtractor::getValue(const char* key, bool& value)
 
 namespace
 {
+    template <typename T>
+    void writeValue(std::ostream& os, const T& value)
+    {
+        os.write(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    void writeValue(std::ostream& os, const bool value)
+    {
+        writeValue(os, static_cast<std::uint8_t>(value ? 1 : 0));
+    }
+
+    void writeValue(std::ostream& os, const MString& value)
+    {
+        writeValue(os, static_cast<std::uint32_t>(value.length()));
+        os.write(value.asChar(), value.length());
+    }
+
+    void writeValue(std::ostream& os, const std::vector<double>& values)
+    {
+        writeValue(os, static_cast<std::uint32_t>(values.size()));
+        for (size_t i = 0, e = values.size(); i < e; ++i)
+            writeValue(os, values[i]);
+    }
+
+    template <typename T>
+    bool readValue(std::istream& is, T& value)
+    {
+        is.read(reinterpret_cast<char*>(&value), sizeof(T));
+        return is.good();
+    }
+
+    bool readValue(std::istream& is, bool& value)
+    {
+        std::uint8_t tmp;
+        if (!readValue(is, tmp))
+            return false;
+
+        value = tmp != 0;
+        return true;
+    }
+
+    // Upper bound for strings and arrays, to detect corrupted data.
+    const std::uint32_t MaxSerializedSize = 1 << 20;
+
+    bool readValue(std::istream& is, MString& value)
+    {
+        std::uint32_t length;
+        if (!readValue(is, length) || length > MaxSerializedSize)
+            return false;
+
+        std::string tmp(length, '\0');
+        if (length != 0)
+            is.read(&tmp[0], length);
+
+        value = MString(tmp.c_str(), static_cast<int>(length));
+        return is.good();
+    }
+
+    bool readValue(std::istream& is, std::vector<double>& values)
+    {
+        std::uint32_t size;
+        if (!readValue(is, size) || size > MaxSerializedSize)
+            return false;
+
+        values.resize(size);
+        for (size_t i = 0, e = values.size(); i < e; ++i)
+        {
+            if (!readValue(is, values[i]))
+                return false;
+        }
+
+        return true;
+    }
+
     void getFloat3Default(const asf::Dictionary& paramInfo, std::vector<double>& defaultValue)
     {
         const asf::Vector3f v = paramInfo.get<asf::Vector3f>("default");
@@ -100,10 +179,42 @@ namespace
     }
 }
 
+OSLParamInfo::OSLParamInfo()
+  : isOutput(false)
+  , isClosure(false)
+  , isStruct(false)
+  , isArray(false)
+  , arrayLen(-1)
+  , lockGeom(true)
+  , validDefault(false)
+  , hasDefault(false)
+  , hasMin(false)
+  , minValue(0.0)
+  , hasMax(false)
+  , maxValue(0.0)
+  , hasSoftMin(false)
+  , softMinValue(0.0)
+  , hasSoftMax(false)
+  , softMaxValue(0.0)
+  , divider(false)
+  , mayaAttributeConnectable(true)
+  , mayaAttributeHidden(false)
+  , mayaAttributeKeyable(true)
+{
+}
+
 OSLParamInfo::OSLParamInfo(const asf::Dictionary& paramInfo)
   : arrayLen(-1)
   , lockGeom(true)
   , hasDefault(false)
+  , hasMin(false)
+  , minValue(0.0)
+  , hasMax(false)
+  , maxValue(0.0)
+  , hasSoftMin(false)
+  , softMinValue(0.0)
+  , hasSoftMax(false)
+  , softMaxValue(0.0)
   , divider(false)
 {
     paramName = paramInfo.get("name");
@@ -116,8 +227,50 @@ OSLParamInfo::OSLParamInfo(const asf::Dictionary& paramInfo)
     paramType = paramInfo.get("type");
     validDefault = paramInfo.get<bool>("validdefault");
 
+    isOutput = paramInfo.get<bool>("isoutput");
+    isClosure = paramInfo.get<bool>("isclosure");
+    isStruct = paramInfo.get<bool>("isstruct");
+
+    if (isStruct)
+        structName = paramInfo.get("structname");
+
+    isArray = paramInfo.get<bool>("isarray");
+
+    if (isArray)
+        arrayLen = paramInfo.get<int>("arraylen");
+    else
+        arrayLen = -1;
+
+    if (paramInfo.dictionaries().exist("metadata"))
+    {
+        OSLMetadataExtractor metadata(paramInfo.dictionary("metadata"));
+
+        metadata.getValue("lockgeom", lockGeom);
+        metadata.getValue("units", units);
+        metadata.getValue("page", page);
+        metadata.getValue("label", label);
+        metadata.getValue("widget", widget);
+        metadata.getValue("options", options);
+        metadata.getValue("help", help);
+        hasMin = metadata.getValue("min", minValue);
+        hasMax = metadata.getValue("max", maxValue);
+        hasSoftMin = metadata.getValue("softmin", softMinValue);
+        hasSoftMax = metadata.getValue("softmax", softMaxValue);
+        metadata.getValue("divider", divider);
+
+        metadata.getValue("as_widget", asWidget);
+
+        metadata.getValue("as_maya_attribute_name", mayaAttributeName);
+        metadata.getValue("as_maya_attribute_short_name", mayaAttributeShortName);
+        metadata.getValue("as_maya_attribute_connectable", mayaAttributeConnectable);
+        metadata.getValue("as_maya_attribute_hidden", mayaAttributeHidden);
+        metadata.getValue("as_maya_attribute_keyable", mayaAttributeKeyable);
+    }
+
+    // The defaults are kept even if lockgeom is off: they are still the
+    // defaults of the Maya attributes, isDefaultValue() checks lockGeom.
     // todo: lots of refactoring possibilities here...
-    if (validDefault && lockGeom)
+    if (validDefault)
     {
         if (paramInfo.strings().exist("default"))
         {
@@ -166,46 +319,114 @@ OSLParamInfo::OSLParamInfo(const asf::Dictionary& paramInfo)
             }
         }
     }
+}
 
-    isOutput = paramInfo.get<bool>("isoutput");
-    isClosure = paramInfo.get<bool>("isclosure");
-    isStruct = paramInfo.get<bool>("isstruct");
-
-    if (isStruct)
-        structName = paramInfo.get("structname");
+void OSLParamInfo::write(std::ostream& os) const
+{
+    writeValue(os, paramName);
+    writeValue(os, paramType);
+    writeValue(os, isOutput);
+    writeValue(os, isClosure);
+    writeValue(os, isStruct);
+    writeValue(os, structName);
+    writeValue(os, isArray);
+    writeValue(os, static_cast<std::int32_t>(arrayLen));
+    writeValue(os, lockGeom);
+
+    writeValue(os, validDefault);
+    writeValue(os, hasDefault);
+    writeValue(os, defaultValue);
+    writeValue(os, defaultStringValue);
+
+    writeValue(os, units);
+    writeValue(os, page);
+    writeValue(os, label);
+    writeValue(os, widget);
+    writeValue(os, options);
+    writeValue(os, help);
+    writeValue(os, hasMin);
+    writeValue(os, minValue);
+    writeValue(os, hasMax);
+    writeValue(os, maxValue);
+    writeValue(os, hasSoftMin);
+    writeValue(os, softMinValue);
+    writeValue(os, hasSoftMax);
+    writeValue(os, softMaxValue);
+    writeValue(os, divider);
+
+    writeValue(os, asWidget);
+
+    writeValue(os, mayaAttributeName);
+    writeValue(os, mayaAttributeShortName);
+    writeValue(os, mayaAttributeConnectable);
+    writeValue(os, mayaAttributeHidden);
+    writeValue(os, mayaAttributeKeyable);
+}
 
-    isArray = paramInfo.get<bool>("isarray");
+bool OSLParamInfo::read(std::istream& is)
+{
+    std::int32_t len;
+
+    return
+        readValue(is, paramName) &&
+        readValue(is, paramType) &&
+        readValue(is, isOutput) &&
+        readValue(is, isClosure) &&
+        readValue(is, isStruct) &&
+        readValue(is, structName) &&
+        readValue(is, isArray) &&
+        readValue(is, len) && ((arrayLen = len), true) &&
+        readValue(is, lockGeom) &&
+
+        readValue(is, validDefault) &&
+        readValue(is, hasDefault) &&
+        readValue(is, defaultValue) &&
+        readValue(is, defaultStringValue) &&
+
+        readValue(is, units) &&
+        readValue(is, page) &&
+        readValue(is, label) &&
+        readValue(is, widget) &&
+        readValue(is, options) &&
+        readValue(is, help) &&
+        readValue(is, hasMin) &&
+        readValue(is, minValue) &&
+        readValue(is, hasMax) &&
+        readValue(is, maxValue) &&
+        readValue(is, hasSoftMin) &&
+        readValue(is, softMinValue) &&
+        readValue(is, hasSoftMax) &&
+        readValue(is, softMaxValue) &&
+        readValue(is, divider) &&
+
+        readValue(is, asWidget) &&
+
+        readValue(is, mayaAttributeName) &&
+        readValue(is, mayaAttributeShortName) &&
+        readValue(is, mayaAttributeConnectable) &&
+        readValue(is, mayaAttributeHidden) &&
+        readValue(is, mayaAttributeKeyable);
+}
 
-    if (isArray)
-        arrayLen = paramInfo.get<int>("arraylen");
-    else
-        arrayLen = -1;
+bool OSLParamInfo::isDefaultValue(const float* values, const size_t count) const
+{
+    // Parameters that are not locked can be overridden by geometry attributes,
+    // their values must always be written.
+    if (!lockGeom || !hasDefault || defaultValue.size() != count)
+        return false;
 
-    if (paramInfo.dictionaries().exist("metadata"))
+    for (size_t i = 0; i < count; ++i)
     {
-        OSLMetadataExtractor metadata(paramInfo.dictionary("metadata"));
-
-        metadata.getValue("lockgeom", lockGeom);
-        metadata.getValue("units", units);
-        metadata.getValue("page", page);
-        metadata.getValue("label", label);
-        metadata.getValue("widget", widget);
-        metadata.getValue("options", options);
-        metadata.getValue("help", help);
-        hasMin = metadata.getValue("min", minValue);
-        hasMax = metadata.getValue("max", maxValue);
-        hasSoftMin = metadata.getValue("softmin", softMinValue);
-        hasSoftMax = metadata.getValue("softmax", softMaxValue);
-        metadata.getValue("divider", divider);
+        if (static_cast<float>(defaultValue[i]) != values[i])
+            return false;
+    }
 
-        metadata.getValue("as_widget", asWidget);
+    return true;
+}
 
-        metadata.getValue("as_maya_attribute_name", mayaAttributeName);
-        metadata.getValue("as_maya_attribute_short_name", mayaAttributeShortName);
-        metadata.getValue("as_maya_attribute_connectable", mayaAttributeConnectable);
-        metadata.getValue("as_maya_attribute_hidden", mayaAttributeHidden);
-        metadata.getValue("as_maya_attribute_keyable", mayaAttributeKeyable);
-    }
+bool OSLParamInfo::isDefaultValue(const MString& value) const
+{
+    return lockGeom && hasDefault && paramType == "string" && value == defaultStringValue;
 }
 
 std::ostream& operator<<(std::ostream& os, const OSLParamInfo& paramInfo)
@@ -228,50 +449,115 @@ std::ostream& operator<<(std::ostream& os, const OSLParamInfo& paramInfo)
     return os;
 }
 
+OSLShaderQueryData::OSLShaderQueryData(const asr::ShaderQuery& q)
+  : shaderName(q.get_shader_name())
+  , shaderType(q.get_shader_type())
+  , metadata(q.get_metadata())
+{
+    paramInfo.reserve(q.get_param_count());
+    for (size_t i = 0, e = q.get_param_count(); i < e; ++i)
+        paramInfo.push_back(q.get_param_info(i));
+}
+
 OSLShaderInfo::OSLShaderInfo()
     : typeId(0)
 {
 }
 
 OSLShaderInfo::OSLShaderInfo(
-    const asr::ShaderQuery&     q,
+    const OSLShaderQueryData&   q,
     const MString&              filename)
     : typeId(0)
 {
-    shaderName = q.get_shader_name();
-    shaderType = q.get_shader_type();
+    shaderName = q.shaderName.c_str();
+    shaderType = q.shaderType.c_str();
     shaderFileName = filename;
-    OSLMetadataExtractor metadata(q.get_metadata());
+    OSLMetadataExtractor metadata(q.metadata);
 
     metadata.getValue("as_node_name", mayaName);
     metadata.getValue("as_maya_classification", mayaClassification);
     metadata.getValue<unsigned int>("as_maya_type_id", typeId);
     metadata.getValue("URL", shaderHelpURL);
 
-    paramInfo.reserve(q.get_param_count());
-    for (size_t i = 0, e = q.get_param_count(); i < e; ++i)
-        paramInfo.push_back(OSLParamInfo(q.get_param_info(i)));
+    paramInfo.reserve(q.paramInfo.size());
+    for (size_t i = 0, e = q.paramInfo.size(); i < e; ++i)
+        paramInfo.push_back(OSLParamInfo(q.paramInfo[i]));
 
     // Apply some defaults.
 
     // If the shader is a custom node, we can default its name to the shader name.
     if (typeId != 0 && mayaName.length() == 0)
         mayaName = shaderName;
+
+    buildParamIndex();
 }
 
-const OSLParamInfo* OSLShaderInfo::findParam(const MString& mayaAttrName) const
+void OSLShaderInfo::write(std::ostream& os) const
 {
+    writeValue(os, shaderName);
+    writeValue(os, shaderType);
+    writeValue(os, shaderFileName);
+    writeValue(os, shaderHelpURL);
+
+    writeValue(os, mayaName);
+    writeValue(os, mayaClassification);
+    writeValue(os, static_cast<std::uint32_t>(typeId));
+
+    writeValue(os, static_cast<std::uint32_t>(paramInfo.size()));
     for (size_t i = 0, e = paramInfo.size(); i < e; ++i)
+        paramInfo[i].write(os);
+}
+
+bool OSLShaderInfo::read(std::istream& is)
+{
+    std::uint32_t id, paramCount;
+
+    if (!readValue(is, shaderName) ||
+        !readValue(is, shaderType) ||
+        !readValue(is, shaderFileName) ||
+        !readValue(is, shaderHelpURL) ||
+        !readValue(is, mayaName) ||
+        !readValue(is, mayaClassification) ||
+        !readValue(is, id) ||
+        !readValue(is, paramCount) ||
+        paramCount > MaxSerializedSize)
     {
-        if (paramInfo[i].mayaAttributeName == mayaAttrName)
-            return &paramInfo[i];
+        return false;
     }
 
-    return nullptr;
+    typeId = id;
+
+    paramInfo.resize(paramCount);
+    for (size_t i = 0, e = paramInfo.size(); i < e; ++i)
+    {
+        if (!paramInfo[i].read(is))
+            return false;
+    }
+
+    buildParamIndex();
+    return true;
+}
+
+const OSLParamInfo* OSLShaderInfo::findParam(const MString& mayaAttrName) const
+{
+    const ParamIndex::const_iterator it = m_paramIndex.find(mayaAttrName);
+
+    if (it == m_paramIndex.end())
+        return nullptr;
+
+    return &paramInfo[it->second];
 }
 
 const OSLParamInfo* OSLShaderInfo::findParam(const MPlug& plug) const
 {
+    const MObject attr = plug.attribute();
+    const AttributeIndex::const_iterator it =
+        m_attributeIndex.find(MObjectHandle(attr).hashCode());
+
+    if (it != m_attributeIndex.end() && it->second.m_attribute == attr)
+        return &paramInfo[it->second.m_paramIndex];
+
+    // The attribute is not in the index, for example a dynamic attribute.
     MStatus status;
     const MString attrName =
         plug.partialName(
@@ -284,3 +570,49 @@ const OSLParamInfo* OSLShaderInfo::findParam(const MPlug& plug) const
             &status);
     return findParam(attrName);
 }
+
+void OSLShaderInfo::buildAttributeIndex()
+{
+    m_attributeIndex.clear();
+    m_paramAttributes.assign(paramInfo.size(), MObject::kNullObj);
+
+    MNodeClass nodeClass(mayaName);
+
+    for (size_t i = 0, e = paramInfo.size(); i < e; ++i)
+    {
+        MStatus status;
+        const MObject attr = nodeClass.attribute(paramInfo[i].mayaAttributeName, &status);
+
+        if (!status || attr.isNull())
+            continue;
+
+        m_paramAttributes[i] = attr;
+
+        AttributeEntry entry;
+        entry.m_attribute = attr;
+        entry.m_paramIndex = i;
+
+        // In the unlikely event of a hash collision, the second
+        // attribute will be found through its name.
+        m_attributeIndex.insert(std::make_pair(MObjectHandle(attr).hashCode(), entry));
+    }
+}
+
+const MObject& OSLShaderInfo::paramAttribute(const size_t paramIndex) const
+{
+    if (paramIndex < m_paramAttributes.size())
+        return m_paramAttributes[paramIndex];
+
+    return MObject::kNullObj;
+}
+
+void OSLShaderInfo::buildParamIndex()
+{
+    m_paramIndex.clear();
+    m_attributeIndex.clear();
+    m_paramAttributes.clear();
+
+    // If names are duplicated, keep the first parameter.
+    for (size_t i = 0, e = paramInfo.size(); i < e; ++i)
+        m_paramIndex.insert(std::make_pair(paramInfo[i].mayaAttributeName, i));
+}
@@ -40,12 +40,18 @@
 
 // Maya headers.
 #include "appleseedmaya/_beginmayaheaders.h"
+#include <maya/MObject.h>
 #include <maya/MPlug.h>
 #include <maya/MString.h>
 #include "appleseedmaya/_endmayaheaders.h"
 
 // Standard headers.
+#include <cstddef>
 #include <iostream>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <unordered_map>
 #include <vector>
 
 // Forward declarations.
@@ -91,8 +97,18 @@ class OSLMetadataExtractor
 class OSLParamInfo
 {
   public:
+    OSLParamInfo();
+
     explicit OSLParamInfo(const foundation::Dictionary& paramInfo);
 
+    // Binary serialization, used by the shader metadata cache.
+    void write(std::ostream& os) const;
+    bool read(std::istream& is);
+
+    // Returns true if the values are equal to the declared default of the parameter.
+    bool isDefaultValue(const float* values, const size_t count) const;
+    bool isDefaultValue(const MString& value) const;
+
     // Query info.
     MString paramName;
     MString paramType;
@@ -140,6 +156,22 @@ class OSLParamInfo
 
 std::ostream& operator<<(std::ostream& os, const OSLParamInfo& paramInfo);
 
+//
+// The OSLShaderQueryData class holds the raw result of an OSL shader query.
+// It does not use the Maya API and can be built in worker threads.
+//
+
+class OSLShaderQueryData
+{
+  public:
+    explicit OSLShaderQueryData(const renderer::ShaderQuery& q);
+
+    std::string                         shaderName;
+    std::string                         shaderType;
+    foundation::Dictionary              metadata;
+    std::vector<foundation::Dictionary> paramInfo;
+};
+
 //
 // The OSLShaderInfo class holds information about an OSL shader.
 //
@@ -149,15 +181,29 @@ class OSLShaderInfo
   public:
     OSLShaderInfo();
 
+    // Must be called from the main thread.
     OSLShaderInfo(
-        const renderer::ShaderQuery&    q,
+        const OSLShaderQueryData&       q,
         const MString&                  filename);
 
+    // Binary serialization, used by the shader metadata cache.
+    void write(std::ostream& os) const;
+    bool read(std::istream& is);
+
     // Returns a pointer to an OSLParamInfo for a shader parameter.
     // If the parameter is not found, returns a null pointer.
     const OSLParamInfo* findParam(const MString& mayaAttrName) const;
     const OSLParamInfo* findParam(const MPlug& plug) const;
 
+    // Map the attributes of the Maya node type to shader parameters,
+    // to find the parameters of plugs without building their names.
+    // Must be called once the Maya node type is registered.
+    void buildAttributeIndex();
+
+    // Returns the Maya attribute of a shader parameter.
+    // If the attribute was not resolved, returns a null object.
+    const MObject& paramAttribute(const size_t paramIndex) const;
+
     // Shader info.
     MString shaderName;
     MString shaderType;
@@ -171,5 +217,21 @@ class OSLShaderInfo
 
     // Parameter information.
     std::vector<OSLParamInfo> paramInfo;
+
+  private:
+    struct AttributeEntry
+    {
+        MObject     m_attribute;
+        size_t      m_paramIndex;
+    };
+
+    typedef std::unordered_map<MString, size_t, MStringHash, MStringEqual> ParamIndex;
+    typedef std::unordered_map<unsigned int, AttributeEntry> AttributeIndex;
+
+    ParamIndex              m_paramIndex;
+    AttributeIndex          m_attributeIndex;
+    std::vector<MObject>    m_paramAttributes;
+
+    void buildParamIndex();
 };
 
@@ -30,7 +30,9 @@
 #include "shadingnoderegistry.h"
 
 // appleseed-maya headers.
+#include "appleseedmaya/config.h"
 #include "appleseedmaya/logger.h"
+#include "appleseedmaya/murmurhash.h"
 #include "appleseedmaya/shadingnode.h"
 #include "appleseedmaya/shadingnodemetadata.h"
 #include "appleseedmaya/shadingnodetemplatebuilder.h"
@@ -44,6 +46,7 @@
 
 // appleseed.foundation headers.
 #include "foundation/containers/dictionary.h"
+#include "foundation/core/appleseed.h"
 #include "foundation/memory/autoreleaseptr.h"
 #include "foundation/string/string.h"
 #include "foundation/utility/searchpaths.h"
@@ -66,9 +69,13 @@
 #include "boost/filesystem.hpp"
 
 // Standard headers.
+#include <cstdint>
 #include <cstdlib>
+#include <fstream>
 #include <map>
+#include <memory>
 #include <string>
+#include <utility>
 #include <vector>
 
 namespace bfs = boost::filesystem;
@@ -120,128 +127,300 @@ namespace
     typedef std::map<MString, OSLShaderInfo, MStringCompareLess> OSLShaderInfoMap;
     OSLShaderInfoMap gShadersInfo;
 
-    bool doRegisterShader(
-        const bfs::path&    shaderPath,
-        MFnPlugin&          pluginFn,
-        asr::ShaderQuery&   query)
+    // Content hashes of the .oso files, keyed by shader name.
+    std::map<std::string, std::string> gShaderFileHashes;
+
+    bool registerShaderInfo(
+        OSLShaderInfo&      shaderInfo,
+        MFnPlugin&          pluginFn)
     {
-        if (query.open(shaderPath.string().c_str()))
+        if (shaderInfo.mayaName.length() == 0)
         {
-            // Get the shader filename without the .oso extension.
-            const MString shaderFilename(shaderPath.filename().replace_extension().c_str());
-            OSLShaderInfo shaderInfo(query, shaderFilename);
+            RENDERER_LOG_DEBUG(
+                "Skipping registration for OSL shader %s. No maya name metadata found.",
+                shaderInfo.shaderName.asChar());
+            return false;
+        }
 
-            if (shaderInfo.mayaName.length() == 0)
-            {
-                RENDERER_LOG_DEBUG(
-                    "Skipping registration for OSL shader %s. No maya name metadata found.",
-                    shaderInfo.shaderName.asChar());
-                return false;
-            }
+        if (gShadersInfo.count(shaderInfo.mayaName) != 0)
+        {
+            RENDERER_LOG_DEBUG(
+                "Skipping registration for OSL shader %s. Already registered.",
+                shaderInfo.shaderName.asChar());
+            return false;
+        }
 
-            if (gShadersInfo.count(shaderInfo.mayaName) != 0)
+        if (shaderInfo.typeId != 0)
+        {
+            if (shaderInfo.mayaClassification.length() == 0)
             {
                 RENDERER_LOG_DEBUG(
-                    "Skipping registration for OSL shader %s. Already registered.",
+                    "Skipping registration for OSL shader %s. No maya classification metadata found.",
                     shaderInfo.shaderName.asChar());
                 return false;
             }
+        }
 
-            if (shaderInfo.typeId != 0)
-            {
-                if (shaderInfo.mayaClassification.length() == 0)
-                {
-                    RENDERER_LOG_DEBUG(
-                        "Skipping registration for OSL shader %s. No maya classification metadata found.",
-                        shaderInfo.shaderName.asChar());
-                    return false;
-                }
-            }
+        RENDERER_LOG_DEBUG(
+            "Registered OSL shader %s",
+            shaderInfo.shaderName.asChar());
 
+        #if 0
+            logShader(shaderInfo);
+        #endif
+
+        gShadersInfo[shaderInfo.mayaName] = shaderInfo;
+
+        if (shaderInfo.typeId != 0)
+        {
+            // This shader is not a builtin node or a node from other plugin.
+            // Create a MPxNode for this shader.
             RENDERER_LOG_DEBUG(
-                "Registered OSL shader %s",
+                "Registering MPxNode for OSL shader %s.",
                 shaderInfo.shaderName.asChar());
 
-            #if 0
-                logShader(shaderInfo);
-            #endif
-
-            gShadersInfo[shaderInfo.mayaName] = shaderInfo;
+            ShadingNode::setCurrentShaderInfo(&shaderInfo);
+            MStatus status = pluginFn.registerNode(
+                shaderInfo.mayaName,
+                MTypeId(shaderInfo.typeId),
+                &ShadingNode::creator,
+                &ShadingNode::initialize,
+                MPxNode::kDependNode,
+                &shaderInfo.mayaClassification);
 
-            if (shaderInfo.typeId != 0)
+            if (!status)
             {
-                // This shader is not a builtin node or a node from other plugin.
-                // Create a MPxNode for this shader.
-                RENDERER_LOG_DEBUG(
-                    "Registering MPxNode for OSL shader %s.",
-                    shaderInfo.shaderName.asChar());
+                RENDERER_LOG_WARNING(
+                    "Registration of OSL shader %s failed, error = %s.",
+                    shaderInfo.shaderName.asChar(),
+                    status.errorString().asChar());
 
-                ShadingNode::setCurrentShaderInfo(&shaderInfo);
-                MStatus status = pluginFn.registerNode(
-                    shaderInfo.mayaName,
-                    MTypeId(shaderInfo.typeId),
-                    &ShadingNode::creator,
-                    &ShadingNode::initialize,
-                    MPxNode::kDependNode,
-                    &shaderInfo.mayaClassification);
+                gShadersInfo.erase(shaderInfo.mayaName);
+                return false;
+            }
 
-                if (!status)
-                {
-                    RENDERER_LOG_WARNING(
-                        "Registration of OSL shader %s failed, error = %s.",
-                        shaderInfo.shaderName.asChar(),
-                        status.errorString().asChar());
+            buildAndRegisterAETemplate(shaderInfo);
+        }
 
-                    gShadersInfo.erase(shaderInfo.mayaName);
-                    return false;
-                }
+        gShadersInfo[shaderInfo.mayaName].buildAttributeIndex();
+        return true;
+    }
 
-                buildAndRegisterAETemplate(shaderInfo);
-            }
+    //
+    // Shader metadata cache.
+    //
+    // Querying .oso files is slow, so the parsed metadata is stored on disk,
+    // keyed by the shader path, file size and a hash of the file contents.
+    // Modification times are not used, as their resolution can be too coarse
+    // to see a shader compiled twice in a row.
+    // Only new or modified shaders are queried when the plugin is loaded.
+    //
 
-            return true;
+    const char* ShaderCacheMagic = "ASMAYAOSLCACHE";
+    const std::uint32_t ShaderCacheFormatVersion = 2;
+
+    struct ShaderFile
+    {
+        bfs::path       m_path;
+        std::uint64_t   m_size;
+        std::string     m_contentHash;
+    };
+
+    struct ShaderCacheEntry
+    {
+        ShaderCacheEntry()
+          : m_size(0)
+          , m_valid(false)
+        {
         }
 
-        return false;
+        std::uint64_t   m_size;
+        std::string     m_contentHash;
+        bool            m_valid;        // false if the shader could not be queried
+        OSLShaderInfo   m_shaderInfo;
+    };
+
+    typedef std::map<std::string, ShaderCacheEntry> ShaderCache;
+
+    template <typename T>
+    void writeCacheValue(std::ostream& os, const T& value)
+    {
+        os.write(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    void writeCacheString(std::ostream& os, const std::string& value)
+    {
+        writeCacheValue(os, static_cast<std::uint32_t>(value.size()));
+        os.write(value.data(), value.size());
     }
 
-    bool registerShader(
-        const bfs::path&    shaderPath,
-        MFnPlugin&          pluginFn,
-        asr::ShaderQuery&   query)
+    template <typename T>
+    bool readCacheValue(std::istream& is, T& value)
     {
+        is.read(reinterpret_cast<char*>(&value), sizeof(T));
+        return is.good();
+    }
+
+    bool readCacheString(std::istream& is, std::string& value)
+    {
+        std::uint32_t length;
+        if (!readCacheValue(is, length) || length > 64 * 1024)
+            return false;
+
+        value.resize(length);
+        if (length != 0)
+            is.read(&value[0], length);
+
+        return is.good();
+    }
+
+    std::string shaderCacheVersionString()
+    {
+        std::string version(APPLESEED_MAYA_VERSION_STRING);
+        version += " / ";
+        version += asf::Appleseed::get_lib_version();
+        return version;
+    }
+
+    bfs::path shaderCachePath(const std::vector<bfs::path>& shaderPaths)
+    {
+        if (const char* envCachePath = getenv("APPLESEED_MAYA_SHADER_CACHE"))
+            return bfs::path(envCachePath);
+
         try
         {
-            return doRegisterShader(shaderPath, pluginFn, query);
+            // Sessions with different shader search paths find different shaders,
+            // give them their own cache file so they don't overwrite each other's.
+            MurmurHash hash;
+            for (const bfs::path& shaderPath : shaderPaths)
+                hash.append(bfs::absolute(shaderPath).string());
+
+            return bfs::temp_directory_path() / ("appleseedmaya_oslshaders_" + hash.toString() + ".cache");
         }
-        catch (const asf::StringException& e)
+        catch (const bfs::filesystem_error& e)
         {
-            RENDERER_LOG_ERROR(
-                "OSL shader query for shader %s failed, error = %s.",
-                shaderPath.string().c_str(),
-                e.string());
+            RENDERER_LOG_WARNING(
+                "Could not find a temporary directory for the OSL shader cache, error = %s.",
+                e.what());
         }
-        catch (const std::exception& e)
+
+        return bfs::path();
+    }
+
+    void loadShaderCache(const bfs::path& cachePath, ShaderCache& cache)
+    {
+        std::ifstream is(cachePath.string().c_str(), std::ios::in | std::ios::binary);
+
+        if (!is)
+            return;
+
+        std::string magic, version;
+        std::uint32_t formatVersion, entryCount;
+
+        if (!readCacheString(is, magic) || magic != ShaderCacheMagic ||
+            !readCacheValue(is, formatVersion) || formatVersion != ShaderCacheFormatVersion ||
+            !readCacheString(is, version) || version != shaderCacheVersionString() ||
+            !readCacheValue(is, entryCount))
         {
-            RENDERER_LOG_ERROR(
-                "OSL shader query for shader %s failed, error = %s.",
-                shaderPath.string().c_str(),
-                e.what());
+            RENDERER_LOG_DEBUG(
+                "Ignoring outdated OSL shader cache %s.",
+                cachePath.string().c_str());
+            return;
         }
-        catch (...)
+
+        for (std::uint32_t i = 0; i < entryCount; ++i)
         {
-            RENDERER_LOG_ERROR(
-                "OSL shader query for shader %s failed.",
-                shaderPath.string().c_str());
+            std::string path;
+            ShaderCacheEntry entry;
+
+            if (!readCacheString(is, path) ||
+                !readCacheValue(is, entry.m_size) ||
+                !readCacheString(is, entry.m_contentHash) ||
+                !readCacheValue(is, entry.m_valid) ||
+                (entry.m_valid && !entry.m_shaderInfo.read(is)))
+            {
+                RENDERER_LOG_WARNING(
+                    "Corrupted OSL shader cache %s, ignoring it.",
+                    cachePath.string().c_str());
+
+                cache.clear();
+                return;
+            }
+
+            cache[path] = entry;
         }
 
-        return false;
+        RENDERER_LOG_DEBUG(
+            "Loaded %u entries from OSL shader cache %s.",
+            entryCount,
+            cachePath.string().c_str());
     }
 
-    void registerShadersInDirectory(
-        const bfs::path&    shaderDir,
-        MFnPlugin&          pluginFn,
-        asr::ShaderQuery&   query)
+    void saveShaderCache(
+        const bfs::path&                        cachePath,
+        const std::vector<ShaderFile>&          shaderFiles,
+        const std::vector<ShaderCacheEntry>&    entries)
+    {
+        // Write to a temporary file first, then rename it,
+        // so that concurrent Maya sessions never see a partial cache.
+        bfs::path tmpPath(cachePath);
+        tmpPath += bfs::unique_path(".%%%%-%%%%");
+
+        try
+        {
+            {
+                std::ofstream os(tmpPath.string().c_str(), std::ios::out | std::ios::binary);
+
+                writeCacheString(os, ShaderCacheMagic);
+                writeCacheValue(os, ShaderCacheFormatVersion);
+                writeCacheString(os, shaderCacheVersionString());
+                writeCacheValue(os, static_cast<std::uint32_t>(entries.size()));
+
+                for (size_t i = 0, e = entries.size(); i < e; ++i)
+                {
+                    writeCacheString(os, shaderFiles[i].m_path.string());
+                    writeCacheValue(os, entries[i].m_size);
+                    writeCacheString(os, entries[i].m_contentHash);
+                    writeCacheValue(os, entries[i].m_valid);
+
+                    if (entries[i].m_valid)
+                        entries[i].m_shaderInfo.write(os);
+                }
+
+                os.close();
+
+                if (!os)
+                {
+                    RENDERER_LOG_WARNING(
+                        "Could not write OSL shader cache %s.",
+                        tmpPath.string().c_str());
+
+                    bfs::remove(tmpPath);
+                    return;
+                }
+            }
+
+            bfs::rename(tmpPath, cachePath);
+
+            RENDERER_LOG_DEBUG(
+                "Saved OSL shader cache %s.",
+                cachePath.string().c_str());
+        }
+        catch (const bfs::filesystem_error& e)
+        {
+            RENDERER_LOG_WARNING(
+                "Could not save OSL shader cache %s, error = %s.",
+                cachePath.string().c_str(),
+                e.what());
+
+            boost::system::error_code ec;
+            bfs::remove(tmpPath, ec);
+        }
+    }
+
+    void collectShadersInDirectory(
+        const bfs::path&            shaderDir,
+        std::vector<ShaderFile>&    shaderFiles)
     {
         try
         {
@@ -259,7 +438,10 @@ namespace
                                 "Found OSL shader %s.",
                                 shaderPath.string().c_str());
 
-                            registerShader(shaderPath, pluginFn, query);
+                            ShaderFile shaderFile;
+                            shaderFile.m_path = shaderPath;
+                            shaderFile.m_size = bfs::file_size(shaderPath);
+                            shaderFiles.push_back(shaderFile);
                         }
                     }
 
@@ -275,6 +457,61 @@ namespace
                 e.what());
         }
     }
+
+    // Called from worker threads: must not use the Maya API.
+    void hashShaderFile(ShaderFile& shaderFile)
+    {
+        std::ifstream is(shaderFile.m_path.string().c_str(), std::ios::in | std::ios::binary);
+
+        MurmurHash hash;
+        char buffer[64 * 1024];
+
+        while (is)
+        {
+            is.read(buffer, sizeof(buffer));
+            hash.append(buffer, static_cast<size_t>(is.gcount()));
+        }
+
+        // An unreadable shader never matches a cache entry.
+        shaderFile.m_contentHash = is.eof() ? hash.toString() : std::string();
+    }
+
+    // Called from worker threads: must not use the Maya API.
+    void queryShader(
+        const ShaderFile&                       shaderFile,
+        std::unique_ptr<OSLShaderQueryData>&    queryData)
+    {
+        const bfs::path& shaderPath = shaderFile.m_path;
+
+        try
+        {
+            asf::auto_release_ptr<asr::ShaderQuery> query =
+                asr::ShaderQueryFactory::create();
+
+            if (query->open(shaderPath.string().c_str()))
+                queryData.reset(new OSLShaderQueryData(*query));
+        }
+        catch (const asf::StringException& e)
+        {
+            RENDERER_LOG_ERROR(
+                "OSL shader query for shader %s failed, error = %s.",
+                shaderPath.string().c_str(),
+                e.string());
+        }
+        catch (const std::exception& e)
+        {
+            RENDERER_LOG_ERROR(
+                "OSL shader query for shader %s failed, error = %s.",
+                shaderPath.string().c_str(),
+                e.what());
+        }
+        catch (...)
+        {
+            RENDERER_LOG_ERROR(
+                "OSL shader query for shader %s failed.",
+                shaderPath.string().c_str());
+        }
+    }
 }
 
 namespace ShadingNodeRegistry
@@ -307,19 +544,102 @@ MStatus registerShadingNodes(MObject plugin)
             shaderPaths.push_back(bfs::path(paths[i]));
     }
 
-    asf::auto_release_ptr<asr::ShaderQuery> query =
-        asr::ShaderQueryFactory::create();
-
     // Iterate in reverse order to allow overriding of shaders.
+    std::vector<ShaderFile> shaderFiles;
     for (int i = static_cast<int>(shaderPaths.size()) - 1; i >= 0; --i)
     {
         RENDERER_LOG_DEBUG(
             "Looking for OSL shaders in path %s.",
             shaderPaths[i].string().c_str());
 
-        registerShadersInDirectory(shaderPaths[i], pluginFn, *query);
+        collectShadersInDirectory(shaderPaths[i], shaderFiles);
+    }
+
+    // Reuse the cached metadata of unchanged shaders.
+    const bfs::path cachePath = shaderCachePath(shaderPaths);
+    ShaderCache cache;
+
+    if (!cachePath.empty())
+        loadShaderCache(cachePath, cache);
+
+    parallelFor(
+        shaderFiles.size(),
+        [&](const size_t i)
+        {
+            hashShaderFile(shaderFiles[i]);
+        });
+
+    // Shaders found first override the others, as for registration.
+    for (size_t i = 0, e = shaderFiles.size(); i < e; ++i)
+    {
+        gShaderFileHashes.insert(
+            std::make_pair(shaderFiles[i].m_path.stem().string(), shaderFiles[i].m_contentHash));
+    }
+
+    std::vector<ShaderCacheEntry> entries(shaderFiles.size());
+    std::vector<size_t> staleShaders;
+
+    for (size_t i = 0, e = shaderFiles.size(); i < e; ++i)
+    {
+        ShaderCache::const_iterator it = cache.find(shaderFiles[i].m_path.string());
+
+        if (it != cache.end() &&
+            !shaderFiles[i].m_contentHash.empty() &&
+            it->second.m_size == shaderFiles[i].m_size &&
+            it->second.m_contentHash == shaderFiles[i].m_contentHash)
+        {
+            entries[i] = it->second;
+        }
+        else
+            staleShaders.push_back(i);
+    }
+
+    // Query new and modified shaders in parallel.
+    RENDERER_LOG_DEBUG(
+        "Querying %u OSL shaders, %u found in cache.",
+        static_cast<unsigned int>(staleShaders.size()),
+        static_cast<unsigned int>(shaderFiles.size() - staleShaders.size()));
+
+    // The query results are plain data, converted to Maya types below.
+    std::vector<std::unique_ptr<OSLShaderQueryData>> queryData(staleShaders.size());
+
+    parallelFor(
+        staleShaders.size(),
+        [&](const size_t i)
+        {
+            queryShader(shaderFiles[staleShaders[i]], queryData[i]);
+        });
+
+    for (size_t i = 0, e = staleShaders.size(); i < e; ++i)
+    {
+        const ShaderFile& shaderFile = shaderFiles[staleShaders[i]];
+        ShaderCacheEntry& entry = entries[staleShaders[i]];
+
+        entry.m_size = shaderFile.m_size;
+        entry.m_contentHash = shaderFile.m_contentHash;
+        entry.m_valid = false;
+
+        if (queryData[i])
+        {
+            // Get the shader filename without the .oso extension.
+            bfs::path shaderFilename = shaderFile.m_path.filename();
+            shaderFilename.replace_extension();
+
+            entry.m_shaderInfo = OSLShaderInfo(*queryData[i], MString(shaderFilename.string().c_str()));
+            entry.m_valid = true;
+        }
+    }
+
+    // Register the shaders in order; this calls the Maya API.
+    for (size_t i = 0, e = entries.size(); i < e; ++i)
+    {
+        if (entries[i].m_valid)
+            registerShaderInfo(entries[i].m_shaderInfo, pluginFn);
     }
 
+    if (!cachePath.empty() && (!staleShaders.empty() || cache.size() != shaderFiles.size()))
+        saveShaderCache(cachePath, shaderFiles, entries);
+
     // Refresh the hypershade window.
     MString command("if (`window -exists createRenderNodeWindow`) {refreshCreateRenderNodeWindow(\"\");}\n");
     MGlobal::executeCommand(command);
@@ -341,6 +661,8 @@ MStatus unregisterShadingNodes(MObject plugin)
             pluginFn.deregisterNode(MTypeId(shaderInfo.typeId));
     }
 
+    gShaderFileHashes.clear();
+
     // Refresh the hypershade.
     MString command("if (`window -exists createRenderNodeWindow`) {refreshCreateRenderNodeWindow(\"\");}\n");
     MGlobal::executeCommand(command);
@@ -369,4 +691,14 @@ bool isShaderSupported(const MString& nodeName)
     return getShaderInfo(nodeName) != nullptr;
 }
 
+std::string getShaderFileHash(const std::string& shaderName)
+{
+    auto it = gShaderFileHashes.find(shaderName);
+
+    if (it == gShaderFileHashes.end())
+        return std::string();
+
+    return it->second;
+}
+
 } // namespace ShadingNodeRegistry
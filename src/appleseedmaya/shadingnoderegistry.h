@@ -36,6 +36,9 @@
 #include <maya/MStringArray.h>
 #include "appleseedmaya/_endmayaheaders.h"
 
+// Standard headers.
+#include <string>
+
 // Forward declarations.
 class OSLShaderInfo;
 
@@ -60,5 +63,9 @@ namespace ShadingNodeRegistry
 
     // Return true if a shading node is supported (is registered).
     bool isShaderSupported(const MString& nodeName);
+
+    // Return a hash of the contents of the .oso file of a shader, as found
+    // when the shading nodes were registered, or an empty string if unknown.
+    std::string getShaderFileHash(const std::string& shaderName);
 } // namespace ShadingNodeRegistry
 
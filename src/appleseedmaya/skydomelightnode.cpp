@@ -197,12 +197,7 @@ void SkyDomeLightNode::draw(
       break;
     }
 
-    if (style == M3dView::kFlatShaded || style == M3dView::kGouraudShaded)
-        drawSphereWireframe(size);
-    else
-        drawSphereWireframe(size);
-
-    drawAppleseedLogo(size);
+    drawSphereAndLogo(size);
 
     glPopAttrib();
     view.endGL();
@@ -254,6 +249,7 @@ void SkyDomeLightNode::setExternalContent(const MExternalContentLocationTable& t
 
 SkyDomeLightData::SkyDomeLightData()
   : MUserData(false) // don't delete after draw
+  , m_size(0.0f)
 {
 }
 
@@ -263,13 +259,18 @@ MHWRender::MPxDrawOverride* SkyDomeLightDrawOverride::creator(const MObject& obj
 }
 
 SkyDomeLightDrawOverride::SkyDomeLightDrawOverride(const MObject& obj)
-  : MHWRender::MPxDrawOverride(obj, SkyDomeLightDrawOverride::draw)
+  : MHWRender::MPxDrawOverride(obj, nullptr)
 {
 }
 
 MHWRender::DrawAPI SkyDomeLightDrawOverride::supportedDrawAPIs() const
 {
-    return MHWRender::kOpenGL | MHWRender::kOpenGLCoreProfile;
+    return MHWRender::kAllDevices;
+}
+
+bool SkyDomeLightDrawOverride::hasUIDrawables() const
+{
+    return true;
 }
 
 bool SkyDomeLightDrawOverride::isBounded(const MDagPath& objPath, const MDagPath& cameraPath) const
@@ -298,63 +299,32 @@ MUserData* SkyDomeLightDrawOverride::prepareForDraw(
     if (!data)
         data = new SkyDomeLightData();
 
-    data->m_size = 1.0f;
-    AttributeUtils::get(objPath.node(), "size", data->m_size);
+    float size = 1.0f;
+    AttributeUtils::get(objPath.node(), "size", size);
+
+    // Only regenerate the geometry when the size changes.
+    if (size != data->m_size || data->m_lines.length() == 0)
+    {
+        data->m_size = size;
+        sphereAndLogoLines(size, data->m_lines);
+    }
+
     data->m_color = MHWRender::MGeometryUtilities::wireframeColor(objPath);
     return data;
 }
 
-void SkyDomeLightDrawOverride::draw(
-    const MHWRender::MDrawContext&  context,
+void SkyDomeLightDrawOverride::addUIDrawables(
+    const MDagPath&                 objPath,
+    MHWRender::MUIDrawManager&      drawManager,
+    const MHWRender::MFrameContext& frameContext,
     const MUserData*                data)
 {
     const SkyDomeLightData* drawData = dynamic_cast<const SkyDomeLightData*>(data);
     if (!drawData)
         return;
 
-    MStatus status;
-
-    const MMatrix transform = context.getMatrix(MHWRender::MDrawContext::kWorldViewMtx, &status);
-    if (status != MStatus::kSuccess)
-        return;
-
-    const MMatrix projection = context.getMatrix(MHWRender::MDrawContext::kProjectionMtx, &status);
-    if (status != MStatus::kSuccess)
-        return;
-
-    const unsigned int displayStyle = context.getDisplayStyle();
-
-    MHWRender::MRenderer* renderer = MHWRender::MRenderer::theRenderer();
-    if (!renderer)
-        return;
-
-    if (renderer->drawAPIIsOpenGL())
-    {
-        float color [3] = { drawData->m_color.r, drawData->m_color.g, drawData->m_color.b};
-        glColor3fv(color);
-
-        glMatrixMode(GL_MODELVIEW);
-        glPushMatrix();
-        glLoadMatrixd(transform.matrix[0]);
-
-        glMatrixMode (GL_PROJECTION);
-        glPushMatrix();
-        glLoadMatrixd(projection.matrix[0]);
-
-        glPushAttrib(GL_CURRENT_BIT);
-
-        if (displayStyle & MHWRender::MDrawContext::kGouraudShaded)
-            drawSphereWireframe(drawData->m_size);
-
-        if (displayStyle & MHWRender::MDrawContext::kWireFrame)
-            drawSphereWireframe(drawData->m_size);
-
-        drawAppleseedLogo(drawData->m_size);
-
-        glPopAttrib();
-
-        glPopMatrix();
-        glMatrixMode(GL_MODELVIEW);
-        glPopMatrix();
-    }
+    drawManager.beginDrawable();
+    drawManager.setColor(drawData->m_color);
+    drawManager.mesh(MHWRender::MUIDrawManager::kLines, drawData->m_lines);
+    drawManager.endDrawable();
 }
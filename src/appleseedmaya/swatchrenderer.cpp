@@ -32,6 +32,8 @@
 // appleseed-maya headers.
 #include "appleseedmaya/appleseedsession.h"
 #include "appleseedmaya/logger.h"
+#include "appleseedmaya/murmurhash.h"
+#include "appleseedmaya/renderercontroller.h"
 #include "appleseedmaya/utils.h"
 
 // Build options header.
@@ -68,10 +70,25 @@
 #include <maya/MPlug.h>
 #include "appleseedmaya/_endmayaheaders.h"
 
+// Boost headers.
+#include "boost/filesystem.hpp"
+
 // Standard headers.
+#include <cstdint>
+#include <cstdlib>
 #include <cstring>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <future>
+#include <list>
+#include <map>
 #include <memory>
+#include <string>
+#include <thread>
+#include <vector>
 
+namespace bfs = boost::filesystem;
 namespace asf = foundation;
 namespace asr = renderer;
 
@@ -257,11 +274,9 @@ namespace
             m_mainAssembly->object_instances().insert(objInstance);
         }
 
-        void render(const size_t resolution, MImage& dstImage)
+        // Render the swatch to a BGRA 8 bit buffer. Can be called from any thread.
+        void render(const size_t resolution, uint8_t* dstPixels)
         {
-            // Disable logging while rendering the swatch.
-            ScopedSetLoggerVerbosity logLevel(asf::LogMessage::Error);
-
             // Recreate the frame.
             asr::ParamArray frameParams = m_project->get_frame()->get_parameters();
             frameParams.insert("resolution", asf::Vector2u(resolution, resolution));
@@ -270,7 +285,20 @@ namespace
 
             // Render.
             m_renderer->render(m_rendererController);
-            copySwatchImage(dstImage);
+            copySwatchImage(dstPixels);
+        }
+
+        // Clear a previous abort request. Must be called before the render is
+        // queued, so that an abort requested in between is not lost.
+        void resetStatus()
+        {
+            m_rendererController.set_status(asr::IRendererController::ContinueRendering);
+        }
+
+        // Ask a running render to stop as soon as possible.
+        void abort()
+        {
+            m_rendererController.set_status(asr::IRendererController::AbortRendering);
         }
 
       private:
@@ -279,7 +307,7 @@ namespace
             return static_cast<uint8_t>(asf::saturate(c) * 255.0f);
         }
 
-        void copySwatchImage(MImage& dstImage) const
+        void copySwatchImage(uint8_t* dstPixels) const
         {
             const asf::Image& srcImage = m_project->get_frame()->image();
             const asf::CanvasProperties& props = srcImage.properties();
@@ -301,7 +329,7 @@ namespace
                     {
                         // For swatches, we assume 4 8 bit channels.
                         const size_t y = y0 + j;
-                        uint8_t* dst = dstImage.pixels() + (y * width * 4) + (x0 * 4);
+                        uint8_t* dst = dstPixels + (y * width * 4) + (x0 * 4);
 
                         for (size_t i = 0, ie = tile.get_width(); i < ie; ++i)
                         {
@@ -321,12 +349,521 @@ namespace
         asr::Assembly*                       m_mainAssembly;
         asr::Material*                       m_material;
         std::unique_ptr<asr::MasterRenderer> m_renderer;
-        asr::DefaultRendererController       m_rendererController;
+        RendererController                   m_rendererController;
+    };
+
+    //
+    // Cache of rendered swatches.
+    //
+    // Swatches are keyed by a hash of the exported shading network, the swatch
+    // type and the resolution. The most recently used swatches are kept in memory.
+    // If the APPLESEED_MAYA_SWATCH_CACHE environment variable points to a directory,
+    // swatches are also stored there and reused across Maya sessions.
+    //
+
+    class SwatchCache
+      : public asf::NonCopyable
+    {
+      public:
+        SwatchCache()
+          : m_memoryUsed(0)
+        {
+        }
+
+        void initialize()
+        {
+            m_diskCacheDir.clear();
+
+            if (const char* cacheDir = getenv("APPLESEED_MAYA_SWATCH_CACHE"))
+            {
+                boost::system::error_code ec;
+                bfs::create_directories(bfs::path(cacheDir), ec);
+
+                if (bfs::is_directory(bfs::path(cacheDir), ec))
+                    m_diskCacheDir = cacheDir;
+                else
+                {
+                    RENDERER_LOG_WARNING(
+                        "Swatch cache directory %s is not valid, disk cache disabled.",
+                        cacheDir);
+                }
+            }
+        }
+
+        void clear()
+        {
+            m_entries.clear();
+            m_lru.clear();
+            m_memoryUsed = 0;
+        }
+
+        // Copy a cached swatch to dstImage. Returns false if the swatch is not cached.
+        bool get(const MurmurHash& key, const size_t resolution, MImage& dstImage)
+        {
+            EntryMap::iterator it = m_entries.find(key);
+
+            if (it == m_entries.end())
+            {
+                PixelBuffer pixels;
+                if (!loadFromDisk(key, resolution, pixels))
+                    return false;
+
+                it = insertEntry(key, pixels);
+            }
+            else
+            {
+                // Move the entry to the front of the LRU list.
+                m_lru.splice(m_lru.begin(), m_lru, it->second.m_lruPos);
+            }
+
+            const PixelBuffer& pixels = it->second.m_pixels;
+            assert(pixels.size() == resolution * resolution * 4);
+            memcpy(dstImage.pixels(), &pixels[0], pixels.size());
+            return true;
+        }
+
+        void insert(const MurmurHash& key, const size_t resolution, const uint8_t* srcPixels)
+        {
+            PixelBuffer pixels(srcPixels, srcPixels + resolution * resolution * 4);
+
+            saveToDisk(key, resolution, pixels);
+            insertEntry(key, pixels);
+        }
+
+      private:
+        typedef std::vector<uint8_t> PixelBuffer;
+
+        struct Entry
+        {
+            PixelBuffer                         m_pixels;
+            std::list<MurmurHash>::iterator     m_lruPos;
+        };
+
+        typedef std::map<MurmurHash, Entry> EntryMap;
+
+        // Upper bound for the memory used by cached swatches.
+        static const size_t MaxMemoryUsed = 64 * 1024 * 1024;
+
+        EntryMap::iterator insertEntry(const MurmurHash& key, PixelBuffer& pixels)
+        {
+            EntryMap::iterator it = m_entries.find(key);
+
+            if (it != m_entries.end())
+            {
+                m_memoryUsed -= it->second.m_pixels.size();
+                m_lru.splice(m_lru.begin(), m_lru, it->second.m_lruPos);
+            }
+            else
+            {
+                m_lru.push_front(key);
+                it = m_entries.insert(std::make_pair(key, Entry())).first;
+                it->second.m_lruPos = m_lru.begin();
+            }
+
+            it->second.m_pixels.swap(pixels);
+            m_memoryUsed += it->second.m_pixels.size();
+
+            // Evict the least recently used swatches.
+            while (m_memoryUsed > MaxMemoryUsed && m_lru.size() > 1)
+            {
+                EntryMap::iterator lastIt = m_entries.find(m_lru.back());
+                m_memoryUsed -= lastIt->second.m_pixels.size();
+                m_entries.erase(lastIt);
+                m_lru.pop_back();
+            }
+
+            return it;
+        }
+
+        bfs::path diskCachePath(const MurmurHash& key) const
+        {
+            return bfs::path(m_diskCacheDir) / (key.toString() + ".swatch");
+        }
+
+        bool loadFromDisk(const MurmurHash& key, const size_t resolution, PixelBuffer& pixels) const
+        {
+            if (m_diskCacheDir.empty())
+                return false;
+
+            std::ifstream is(diskCachePath(key).string().c_str(), std::ios::in | std::ios::binary);
+
+            if (!is)
+                return false;
+
+            std::uint32_t magic, res;
+            is.read(reinterpret_cast<char*>(&magic), sizeof(magic));
+            is.read(reinterpret_cast<char*>(&res), sizeof(res));
+
+            if (!is || magic != DiskCacheMagic || res != resolution)
+                return false;
+
+            pixels.resize(resolution * resolution * 4);
+            is.read(reinterpret_cast<char*>(&pixels[0]), pixels.size());
+            return is.good();
+        }
+
+        void saveToDisk(const MurmurHash& key, const size_t resolution, const PixelBuffer& pixels) const
+        {
+            if (m_diskCacheDir.empty())
+                return;
+
+            const std::string path = diskCachePath(key).string();
+            std::ofstream os(path.c_str(), std::ios::out | std::ios::binary);
+
+            const std::uint32_t magic = DiskCacheMagic;
+            const std::uint32_t res = static_cast<std::uint32_t>(resolution);
+            os.write(reinterpret_cast<const char*>(&magic), sizeof(magic));
+            os.write(reinterpret_cast<const char*>(&res), sizeof(res));
+            os.write(reinterpret_cast<const char*>(&pixels[0]), pixels.size());
+            os.close();
+
+            if (!os)
+            {
+                RENDERER_LOG_WARNING("Could not write swatch cache file %s.", path.c_str());
+
+                boost::system::error_code ec;
+                bfs::remove(bfs::path(path), ec);
+            }
+        }
+
+        static const std::uint32_t DiskCacheMagic = 0x41535357; // "ASSW"
+
+        EntryMap                m_entries;
+        std::list<MurmurHash>   m_lru;
+        size_t                  m_memoryUsed;
+        std::string             m_diskCacheDir;
+    };
+
+    SwatchCache g_swatchCache;
+
+    enum SwatchType
+    {
+        MaterialSwatch,
+        TextureSwatch
+    };
+
+    bool exportSwatch(
+        asr::Project&       project,
+        const SwatchType    type,
+        const MObject&      node,
+        const size_t        resolution,
+        MurmurHash&         key)
+    {
+        const bool exported = type == MaterialSwatch
+            ? AppleseedSession::exportMaterialSwatch(project, node, key)
+            : AppleseedSession::exportTextureSwatch(project, node, key);
+
+        key.append(resolution);
+        return exported;
+    }
+
+    //
+    // Swatch render scheduler.
+    //
+    // Swatches are exported on Maya's main thread and rendered by a pool of
+    // workers, each owning its own material and texture swatch projects.
+    // The newest requests are served first, as they usually correspond to the
+    // swatches currently visible in Hypershade or in the Attribute Editor.
+    // The number of workers can be set using the APPLESEED_MAYA_SWATCH_WORKERS
+    // environment variable.
+    //
+
+    class SwatchScheduler
+      : public asf::NonCopyable
+    {
+      public:
+        SwatchScheduler()
+          : m_nextSequence(0)
+        {
+        }
+
+        void initialize(const asf::SearchPaths& resourceSearchPaths)
+        {
+            size_t numWorkers = std::max(std::thread::hardware_concurrency() / 4, 1u);
+
+            if (const char* envNumWorkers = getenv("APPLESEED_MAYA_SWATCH_WORKERS"))
+            {
+                const int n = atoi(envNumWorkers);
+                if (n > 0)
+                    numWorkers = static_cast<size_t>(n);
+            }
+
+            // Disable logging from appleseed in this thread.
+            ScopedThreadLogFilter logFilter(asf::LogMessage::Error);
+
+            // Projects used to compute the cache keys of new requests.
+            m_keyProjects[MaterialSwatch].initialize(resourceSearchPaths);
+            m_keyProjects[MaterialSwatch].createMaterialSceneGeometry();
+            m_keyProjects[TextureSwatch].initialize(resourceSearchPaths);
+            m_keyProjects[TextureSwatch].createTextureSceneGeometry();
+
+            for (size_t i = 0; i < numWorkers; ++i)
+            {
+                std::unique_ptr<Worker> worker(new Worker());
+                worker->m_projects[MaterialSwatch].initialize(resourceSearchPaths);
+                worker->m_projects[MaterialSwatch].createMaterialSceneGeometry();
+                worker->m_projects[TextureSwatch].initialize(resourceSearchPaths);
+                worker->m_projects[TextureSwatch].createTextureSceneGeometry();
+                m_workers.push_back(std::move(worker));
+            }
+
+            RENDERER_LOG_DEBUG(
+                "Created %u swatch render workers.",
+                static_cast<unsigned int>(numWorkers));
+        }
+
+        void uninitialize()
+        {
+            // Abort running renders and wait for them.
+            for (size_t i = 0, e = m_workers.size(); i < e; ++i)
+            {
+                Worker& worker = *m_workers[i];
+
+                if (worker.m_future.valid())
+                {
+                    worker.m_projects[worker.m_type].abort();
+                    worker.m_future.wait();
+                    worker.m_future = std::future<void>();
+                }
+            }
+
+            m_requests.clear();
+
+            // Disable logging from appleseed in this thread.
+            ScopedThreadLogFilter logFilter(asf::LogMessage::Error);
+
+            for (size_t i = 0, e = m_workers.size(); i < e; ++i)
+            {
+                m_workers[i]->m_projects[MaterialSwatch].uninitialize();
+                m_workers[i]->m_projects[TextureSwatch].uninitialize();
+            }
+
+            m_workers.clear();
+
+            m_keyProjects[MaterialSwatch].uninitialize();
+            m_keyProjects[TextureSwatch].uninitialize();
+        }
+
+        // Called repeatedly by the swatch renderer, on the main thread.
+        // Returns true once the swatch has been copied to image.
+        bool update(
+            SwatchRenderer*     renderer,
+            const SwatchType    type,
+            const MObject&      node,
+            const size_t        resolution,
+            MImage&             image)
+        {
+            RequestMap::iterator it = m_requests.find(renderer);
+
+            if (it == m_requests.end())
+            {
+                image.create(static_cast<unsigned int>(resolution), static_cast<unsigned int>(resolution));
+
+                // New request: try the cache first.
+                MurmurHash key;
+                if (!exportSwatch(m_keyProjects[type].getProject(), type, node, resolution, key))
+                {
+                    // Returning false would make Maya ask again forever.
+                    memset(image.pixels(), 0, resolution * resolution * 4);
+                    return true;
+                }
+
+                if (g_swatchCache.get(key, resolution, image))
+                    return true;
+
+                Request& request = m_requests[renderer];
+                request.m_type = type;
+                request.m_node = node;
+                request.m_resolution = resolution;
+                request.m_sequence = m_nextSequence++;
+                request.m_worker = nullptr;
+                request.m_done = false;
+
+                it = m_requests.find(renderer);
+            }
+
+            schedule();
+
+            Request& request = it->second;
+
+            if (!request.m_done)
+                return false;
+
+            image.create(static_cast<unsigned int>(resolution), static_cast<unsigned int>(resolution));
+            memcpy(image.pixels(), &request.m_pixels[0], request.m_pixels.size());
+            m_requests.erase(it);
+            return true;
+        }
+
+        // Called when a swatch renderer is destroyed.
+        void cancel(SwatchRenderer* renderer)
+        {
+            RequestMap::iterator it = m_requests.find(renderer);
+
+            if (it == m_requests.end())
+                return;
+
+            if (Worker* worker = it->second.m_worker)
+            {
+                // The worker stays busy until its render is aborted.
+                worker->m_request = nullptr;
+                worker->m_projects[worker->m_type].abort();
+            }
+
+            m_requests.erase(it);
+        }
+
+      private:
+        struct Worker;
+
+        struct Request
+        {
+            SwatchType              m_type;
+            MObject                 m_node;
+            size_t                  m_resolution;
+            size_t                  m_sequence;
+            Worker*                 m_worker;
+            bool                    m_done;
+            std::vector<uint8_t>    m_pixels;
+        };
+
+        struct Worker
+        {
+            Worker()
+              : m_request(nullptr)
+            {
+            }
+
+            SwatchProject           m_projects[2];
+            SwatchType              m_type;
+            size_t                  m_resolution;
+            MurmurHash              m_key;
+            Request*                m_request;
+            std::vector<uint8_t>    m_pixels;
+            std::future<void>       m_future;
+        };
+
+        typedef std::map<SwatchRenderer*, Request> RequestMap;
+
+        void schedule()
+        {
+            // Collect finished renders.
+            for (size_t i = 0, e = m_workers.size(); i < e; ++i)
+            {
+                Worker& worker = *m_workers[i];
+
+                if (!worker.m_future.valid() ||
+                    worker.m_future.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+                    continue;
+
+                bool succeeded = true;
+
+                try
+                {
+                    worker.m_future.get();
+                }
+                catch (const std::exception& e)
+                {
+                    RENDERER_LOG_ERROR("Swatch render failed, error = %s.", e.what());
+                    succeeded = false;
+                }
+                catch (...)
+                {
+                    RENDERER_LOG_ERROR("Swatch render failed.");
+                    succeeded = false;
+                }
+
+                if (Request* request = worker.m_request)
+                {
+                    if (succeeded)
+                        g_swatchCache.insert(worker.m_key, worker.m_resolution, &worker.m_pixels[0]);
+                    else
+                        std::fill(worker.m_pixels.begin(), worker.m_pixels.end(), 0);
+
+                    request->m_pixels.swap(worker.m_pixels);
+                    request->m_worker = nullptr;
+                    request->m_done = true;
+                    worker.m_request = nullptr;
+                }
+            }
+
+            // Start the newest pending requests on idle workers.
+            for (size_t i = 0, e = m_workers.size(); i < e; ++i)
+            {
+                Worker& worker = *m_workers[i];
+
+                if (worker.m_future.valid())
+                    continue;
+
+                Request* request = newestPendingRequest();
+
+                if (request == nullptr)
+                    break;
+
+                startRender(worker, *request);
+            }
+        }
+
+        Request* newestPendingRequest()
+        {
+            Request* newest = nullptr;
+
+            for (RequestMap::iterator it = m_requests.begin(), e = m_requests.end(); it != e; ++it)
+            {
+                Request& request = it->second;
+
+                if (request.m_done || request.m_worker)
+                    continue;
+
+                if (newest == nullptr || request.m_sequence > newest->m_sequence)
+                    newest = &request;
+            }
+
+            return newest;
+        }
+
+        void startRender(Worker& worker, Request& request)
+        {
+            worker.m_type = request.m_type;
+            worker.m_resolution = request.m_resolution;
+            worker.m_pixels.assign(request.m_resolution * request.m_resolution * 4, 0);
+
+            SwatchProject& project = worker.m_projects[request.m_type];
+
+            // The network may have changed since the request was made.
+            if (!exportSwatch(project.getProject(), request.m_type, request.m_node, request.m_resolution, worker.m_key))
+            {
+                request.m_pixels.swap(worker.m_pixels);
+                request.m_done = true;
+                return;
+            }
+
+            worker.m_request = &request;
+            request.m_worker = &worker;
+
+            const size_t resolution = worker.m_resolution;
+            uint8_t* pixels = &worker.m_pixels[0];
+
+            project.resetStatus();
+
+            worker.m_future = std::async(
+                std::launch::async,
+                [&project, resolution, pixels]()
+                {
+                    // Silence appleseed in this worker only, other renders keep their messages.
+                    ScopedThreadLogFilter logFilter(asf::LogMessage::Error);
+                    project.render(resolution, pixels);
+                });
+        }
+
+        SwatchProject                               m_keyProjects[2];
+        std::vector<std::unique_ptr<Worker>>        m_workers;
+        RequestMap                                  m_requests;
+        size_t                                      m_nextSequence;
     };
 
-    SwatchProject       g_materialSwatchProject;
-    SwatchProject       g_textureSwatchProject;
     asf::SearchPaths    g_resourceSearchPaths;
+    SwatchScheduler     g_swatchScheduler;
 }
 
 const MString SwatchRenderer::name("AppleseedRenderSwatch");
@@ -334,29 +871,16 @@ const MString SwatchRenderer::fullName("swatch/AppleseedRenderSwatch");
 
 void SwatchRenderer::initialize(const MString& /*pluginPath*/)
 {
-    {
-        // Disable logging from appleseed.
-        ScopedSetLoggerVerbosity logLevel(asf::LogMessage::Error);
-
-        g_materialSwatchProject.initialize(g_resourceSearchPaths);
-        g_materialSwatchProject.createMaterialSceneGeometry();
-
-        g_textureSwatchProject.initialize(g_resourceSearchPaths);
-        g_textureSwatchProject.createTextureSceneGeometry();
-    }
+    g_swatchScheduler.initialize(g_resourceSearchPaths);
+    g_swatchCache.initialize();
 
     RENDERER_LOG_INFO("Initialized swatch renderer.");
 }
 
 void SwatchRenderer::uninitialize()
 {
-    {
-        // Disable logging from appleseed.
-        ScopedSetLoggerVerbosity logLevel(asf::LogMessage::Error);
-
-        g_materialSwatchProject.uninitialize();
-        g_textureSwatchProject.uninitialize();
-    }
+    g_swatchScheduler.uninitialize();
+    g_swatchCache.clear();
 
     RENDERER_LOG_INFO("Uninitialized swatch renderer.");
 }
@@ -377,6 +901,11 @@ SwatchRenderer::SwatchRenderer(
 {
 }
 
+SwatchRenderer::~SwatchRenderer()
+{
+    g_swatchScheduler.cancel(this);
+}
+
 bool SwatchRenderer::doIteration()
 {
     MFnDependencyNode depNodeFn(node());
@@ -393,25 +922,16 @@ bool SwatchRenderer::doIteration()
         resolution());
     */
 
-    // Allocate the pixels.
-    image().create(resolution(), resolution());
-
+    // Swatches are rendered in the background; Maya calls
+    // doIteration() again until it returns true.
     if (strstr(classification.asChar(), "rendernode/appleseed/surface") != nullptr)
-    {
-        if (AppleseedSession::exportMaterialSwatch(g_materialSwatchProject.getProject(), node()))
-        {
-            g_materialSwatchProject.render(resolution(), image());
-            return true;
-        }
-    }
+        return g_swatchScheduler.update(this, MaterialSwatch, node(), resolution(), image());
     else if (strstr(classification.asChar(), "rendernode/appleseed/texture") != nullptr)
-    {
-        AppleseedSession::exportTextureSwatch(g_textureSwatchProject.getProject(), node());
-        {
-            g_textureSwatchProject.render(resolution(), image());
-            return true;
-        }
-    }
+        return g_swatchScheduler.update(this, TextureSwatch, node(), resolution(), image());
 
-    return false;
+    // Not an appleseed node: complete the swatch with a blank image,
+    // otherwise Maya would keep asking for it.
+    image().create(resolution(), resolution());
+    memset(image().pixels(), 0, resolution() * resolution() * 4);
+    return true;
 }
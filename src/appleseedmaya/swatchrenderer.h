@@ -48,6 +48,8 @@ class SwatchRenderer
         MObject renderNode,
         int     imageResolution);
 
+    ~SwatchRenderer() override;
+
     bool doIteration() override;
 
   private:
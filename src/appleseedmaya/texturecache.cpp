@@ -0,0 +1,432 @@
+
+//
+// This source file is part of appleseed.
+// Visit https://appleseedhq.net/ for additional information and resources.
+//
+// This software is released under the MIT license.
+//
+// Copyright (c) 2019 Esteban Tovagliari, The appleseedhq Organization
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+// Interface header.
+#include "texturecache.h"
+
+// appleseed-maya headers.
+#include "appleseedmaya/logger.h"
+#include "appleseedmaya/murmurhash.h"
+#include "appleseedmaya/utils.h"
+
+// appleseed.foundation headers.
+#include "foundation/string/string.h"
+
+// Boost headers.
+#include "boost/filesystem/operations.hpp"
+#include "boost/filesystem/path.hpp"
+
+// Standard headers.
+#include <algorithm>
+#include <cstdint>
+#include <ctime>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <cerrno>
+#include <spawn.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+extern char** environ;
+#endif
+
+namespace bfs = boost::filesystem;
+namespace asf = foundation;
+
+namespace
+{
+    // maketx options used for the conversions. Part of the cache key.
+    const char* MakeTxOptions = "--oiio";
+
+#ifdef _WIN32
+    const char* MakeTxExecutable = "maketx.exe";
+#else
+    const char* MakeTxExecutable = "maketx";
+#endif
+
+    std::mutex g_mutex;
+    std::map<std::string, std::string> g_preparedFiles;
+    std::string g_makeTxPath = MakeTxExecutable;
+
+    std::uint32_t readUInt16(const unsigned char* p, const bool bigEndian)
+    {
+        return bigEndian
+            ? (p[0] << 8) | p[1]
+            : (p[1] << 8) | p[0];
+    }
+
+    std::uint32_t readUInt32(const unsigned char* p, const bool bigEndian)
+    {
+        return bigEndian
+            ? (std::uint32_t(p[0]) << 24) | (p[1] << 16) | (p[2] << 8) | p[3]
+            : (std::uint32_t(p[3]) << 24) | (p[2] << 16) | (p[1] << 8) | p[0];
+    }
+
+    bool isTiledAndMipmappedTiff(std::ifstream& file, const unsigned char* header)
+    {
+        const bool bigEndian = header[0] == 'M';
+
+        // BigTIFF files are not inspected.
+        if (readUInt16(header + 2, bigEndian) != 42)
+            return false;
+
+        file.seekg(readUInt32(header + 4, bigEndian));
+
+        unsigned char buffer[12];
+        if (!file.read(reinterpret_cast<char*>(buffer), 2))
+            return false;
+
+        // Look for the TileWidth tag in the first directory.
+        bool tiled = false;
+        for (std::uint32_t i = 0, e = readUInt16(buffer, bigEndian); i < e; ++i)
+        {
+            if (!file.read(reinterpret_cast<char*>(buffer), 12))
+                return false;
+
+            if (readUInt16(buffer, bigEndian) == 322)
+                tiled = true;
+        }
+
+        // Mip levels are stored in the following directories.
+        if (!file.read(reinterpret_cast<char*>(buffer), 4))
+            return false;
+
+        return tiled && readUInt32(buffer, bigEndian) != 0;
+    }
+
+    bool readString(std::ifstream& file, std::string& str)
+    {
+        str.clear();
+
+        char c;
+        while (file.get(c))
+        {
+            if (c == '\0')
+                return true;
+
+            if (str.size() == 255)
+                return false;
+
+            str.push_back(c);
+        }
+
+        return false;
+    }
+
+    bool isTiledAndMipmappedExr(std::ifstream& file, const unsigned char* header)
+    {
+        const std::uint32_t version = readUInt32(header + 4, false);
+
+        // Only single part, tiled files can be mipmapped.
+        if ((version & 0x200) == 0 || (version & 0x1000) != 0)
+            return false;
+
+        // Look for the tile description attribute in the header.
+        std::string name, type;
+        while (readString(file, name) && !name.empty())
+        {
+            unsigned char buffer[9];
+            if (!readString(file, type) || !file.read(reinterpret_cast<char*>(buffer), 4))
+                return false;
+
+            const std::uint32_t size = readUInt32(buffer, false);
+
+            if (name == "tiles" && type == "tiledesc" && size == 9)
+            {
+                if (!file.read(reinterpret_cast<char*>(buffer), 9))
+                    return false;
+
+                // Level mode: 0 = one level, 1 = mipmap, 2 = ripmap.
+                const int levelMode = buffer[8] & 0x0f;
+                return levelMode == 1 || levelMode == 2;
+            }
+
+            file.seekg(size, std::ios::cur);
+        }
+
+        return false;
+    }
+
+    bool isTiledAndMipmapped(const std::string& filename)
+    {
+        std::ifstream file(filename.c_str(), std::ios::in | std::ios::binary);
+
+        unsigned char header[8];
+        if (!file.read(reinterpret_cast<char*>(header), 8))
+            return false;
+
+        if ((header[0] == 'I' && header[1] == 'I') || (header[0] == 'M' && header[1] == 'M'))
+            return isTiledAndMipmappedTiff(file, header);
+
+        if (header[0] == 0x76 && header[1] == 0x2f && header[2] == 0x31 && header[3] == 0x01)
+            return isTiledAndMipmappedExr(file, header);
+
+        return false;
+    }
+
+    bool hasFilenameTokens(const std::string& filename)
+    {
+        // UDIM and frame number patterns are not resolved to a single file.
+        return filename.find_first_of("<#") != std::string::npos;
+    }
+
+    std::string cachedFilename(const bfs::path& source, const bfs::path& cacheDirectory)
+    {
+        boost::system::error_code ec;
+        const std::uintmax_t size = bfs::file_size(source, ec);
+        const std::time_t lastWriteTime = bfs::last_write_time(source, ec);
+
+        // Converted files are identified by their source file and its
+        // size and modification time, so edited images are converted again.
+        MurmurHash hash;
+        hash.append(bfs::absolute(source).string());
+        hash.append(size);
+        hash.append(lastWriteTime);
+        hash.append(MakeTxOptions);
+
+        const std::string filename = source.stem().string() + "_" + hash.toString() + ".tx";
+        return (cacheDirectory / filename).string();
+    }
+
+    // Run a program and wait for it to exit. Arguments are passed
+    // as they are, the command line is not interpreted by a shell.
+    bool runProcess(const char* const* args)
+    {
+#ifdef _WIN32
+        // _spawnvp joins the arguments with spaces: quote them.
+        // Quotes can't appear in Windows paths.
+        std::vector<std::string> quotedArgs;
+        for (const char* const* arg = args; *arg; ++arg)
+            quotedArgs.push_back(std::string("\"") + *arg + "\"");
+
+        std::vector<const char*> argv;
+        for (const std::string& arg : quotedArgs)
+            argv.push_back(arg.c_str());
+        argv.push_back(nullptr);
+
+        return _spawnvp(_P_WAIT, args[0], argv.data()) == 0;
+#else
+        pid_t pid;
+        if (posix_spawnp(&pid, args[0], nullptr, nullptr, const_cast<char* const*>(args), environ) != 0)
+            return false;
+
+        int status;
+        while (waitpid(pid, &status, 0) == -1)
+        {
+            if (errno != EINTR)
+                return false;
+        }
+
+        return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+#endif
+    }
+
+    bool convert(const std::string& source, const std::string& destination, const size_t numThreads)
+    {
+        boost::system::error_code ec;
+
+        // Convert to a temporary file first, so that interrupted or
+        // concurrent conversions never leave a partial file in the cache.
+        const bfs::path tempFile =
+            bfs::path(destination).parent_path() / bfs::unique_path("%%%%-%%%%-%%%%.tmp.tx", ec);
+
+        const std::string threads = asf::to_string(numThreads);
+        const std::string output = tempFile.string();
+        const std::string input = bfs::absolute(source).string();
+
+        const char* args[] =
+        {
+            g_makeTxPath.c_str(),
+            MakeTxOptions,
+            "--threads", threads.c_str(),
+            "-o", output.c_str(),
+            input.c_str(),
+            nullptr
+        };
+
+        if (!runProcess(args) || !bfs::exists(tempFile, ec))
+        {
+            bfs::remove(tempFile, ec);
+            return false;
+        }
+
+        bfs::rename(tempFile, destination, ec);
+
+        if (ec)
+        {
+            // Another session may have converted the same file meanwhile.
+            bfs::remove(tempFile, ec);
+            return bfs::exists(destination, ec);
+        }
+
+        return true;
+    }
+
+    struct ConversionJob
+    {
+        std::string     m_source;
+        std::string     m_destination;
+        bool            m_converted;
+    };
+}
+
+namespace TextureCache
+{
+
+void initialize(const MString& pluginPath)
+{
+    // Use the maketx shipped in the bin directory of the plugin package,
+    // or the one in the PATH if there is none.
+    const bfs::path makeTxPath =
+        bfs::path(pluginPath.asChar()).parent_path() / ".." / "bin" / MakeTxExecutable;
+
+    boost::system::error_code ec;
+    g_makeTxPath = bfs::is_regular_file(makeTxPath, ec)
+        ? makeTxPath.string()
+        : MakeTxExecutable;
+}
+
+void prepareTextures(
+    const std::vector<std::string>& filenames,
+    const MString&                  cacheDirectory)
+{
+    clear();
+
+    boost::system::error_code ec;
+    const bfs::path cacheDir = cacheDirectory.length() != 0
+        ? bfs::path(cacheDirectory.asChar())
+        : bfs::temp_directory_path(ec) / "appleseed-maya-textures";
+
+    bfs::create_directories(cacheDir, ec);
+    if (ec || !bfs::is_directory(cacheDir, ec))
+    {
+        RENDERER_LOG_ERROR(
+            "Could not create texture cache directory %s, textures will not be prepared.",
+            cacheDir.string().c_str());
+        return;
+    }
+
+    std::map<std::string, std::string> preparedFiles;
+    std::vector<ConversionJob> jobs;
+
+    const std::set<std::string> uniqueFilenames(filenames.begin(), filenames.end());
+    for (auto it = uniqueFilenames.begin(), e = uniqueFilenames.end(); it != e; ++it)
+    {
+        if (it->empty() || hasFilenameTokens(*it) || !bfs::is_regular_file(*it, ec))
+            continue;
+
+        if (isTiledAndMipmapped(*it))
+        {
+            RENDERER_LOG_DEBUG("Texture %s is already tiled and mipmapped.", it->c_str());
+            continue;
+        }
+
+        const std::string destination = cachedFilename(*it, cacheDir);
+
+        if (bfs::exists(destination, ec))
+            preparedFiles[*it] = destination;
+        else
+        {
+            ConversionJob job;
+            job.m_source = *it;
+            job.m_destination = destination;
+            job.m_converted = false;
+            jobs.push_back(job);
+        }
+    }
+
+    const size_t numReused = preparedFiles.size();
+
+    if (!jobs.empty())
+    {
+        RENDERER_LOG_INFO(
+            "Converting %s textures to tiled, mipmapped files in %s...",
+            asf::pretty_uint(jobs.size()).c_str(),
+            cacheDir.string().c_str());
+
+        // Split the hardware threads between the concurrent conversions.
+        const size_t numCores = std::max(std::thread::hardware_concurrency(), 1u);
+        const size_t numThreadsPerJob = std::max<size_t>(numCores / std::min(numCores, jobs.size()), 1);
+
+        parallelFor(
+            jobs.size(),
+            [&](const size_t i)
+            {
+                jobs[i].m_converted = convert(jobs[i].m_source, jobs[i].m_destination, numThreadsPerJob);
+            });
+    }
+
+    size_t numFailed = 0;
+    for (auto it = jobs.begin(), e = jobs.end(); it != e; ++it)
+    {
+        if (it->m_converted)
+            preparedFiles[it->m_source] = it->m_destination;
+        else
+        {
+            RENDERER_LOG_WARNING(
+                "Could not convert texture %s, using the original file.",
+                it->m_source.c_str());
+            ++numFailed;
+        }
+    }
+
+    RENDERER_LOG_INFO(
+        "Prepared textures: %s converted, %s reused from cache, %s failed.",
+        asf::pretty_uint(jobs.size() - numFailed).c_str(),
+        asf::pretty_uint(numReused).c_str(),
+        asf::pretty_uint(numFailed).c_str());
+
+    std::lock_guard<std::mutex> lock(g_mutex);
+    g_preparedFiles.swap(preparedFiles);
+}
+
+MString preparedFilename(const MString& filename)
+{
+    std::lock_guard<std::mutex> lock(g_mutex);
+
+    auto it = g_preparedFiles.find(filename.asChar());
+    if (it != g_preparedFiles.end())
+        return MString(it->second.c_str());
+
+    return filename;
+}
+
+void clear()
+{
+    std::lock_guard<std::mutex> lock(g_mutex);
+    g_preparedFiles.clear();
+}
+
+} // namespace TextureCache
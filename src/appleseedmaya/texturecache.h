@@ -0,0 +1,66 @@
+
+//
+// This source file is part of appleseed.
+// Visit https://appleseedhq.net/ for additional information and resources.
+//
+// This software is released under the MIT license.
+//
+// Copyright (c) 2019 Esteban Tovagliari, The appleseedhq Organization
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#pragma once
+
+// Maya headers.
+#include "appleseedmaya/_beginmayaheaders.h"
+#include <maya/MString.h>
+#include "appleseedmaya/_endmayaheaders.h"
+
+// Standard headers.
+#include <string>
+#include <vector>
+
+//
+// Texture preparation.
+//  Image files that are not tiled and mipmapped are converted by maketx
+//  into tiled, mipmapped files stored in a cache directory, so that the
+//  renderer can stream the mip levels it needs instead of whole images.
+//
+
+namespace TextureCache
+{
+
+// Locate the maketx executable.
+void initialize(const MString& pluginPath);
+
+// Convert the image files that are not already tiled and mipmapped.
+// Conversions run in parallel, files converted by previous sessions are reused.
+// If cacheDirectory is empty, a directory in the system temp directory is used.
+void prepareTextures(
+    const std::vector<std::string>& filenames,
+    const MString&                  cacheDirectory);
+
+// Return the converted file to use instead of filename, or filename if it was not converted.
+MString preparedFilename(const MString& filename);
+
+// Forget the converted files.
+void clear();
+
+} // namespace TextureCache
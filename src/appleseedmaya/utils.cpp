@@ -35,11 +35,22 @@
 // Maya headers.
 #include "appleseedmaya/_beginmayaheaders.h"
 #include <maya/MDagPath.h>
+#if MAYA_API_VERSION >= 201800
+#include <maya/MDGContextGuard.h>
+#endif
 #include <maya/MEventMessage.h>
+#include <maya/MFnDagNode.h>
+#include <maya/MFnMatrixData.h>
 #include <maya/MObject.h>
 #include <maya/MSelectionList.h>
+#include <maya/MTime.h>
 #include "appleseedmaya/_endmayaheaders.h"
 
+namespace
+{
+    const MDGContext* g_evaluationContext = &MDGContext::fsNormal;
+}
+
 MStatus getDependencyNodeByName(const MString& name, MObject& node)
 {
     MSelectionList selList;
@@ -87,3 +98,52 @@ void Computation::thowIfInterruptRequested()
     if (m_computation.isInterruptRequested())
         throw AbortRequested();
 }
+
+ScopedEvaluationTime::ScopedEvaluationTime(const double frame)
+  : m_context(MTime(frame, MTime::uiUnit()))
+  , m_previousContext(g_evaluationContext)
+{
+    g_evaluationContext = &m_context;
+}
+
+ScopedEvaluationTime::~ScopedEvaluationTime()
+{
+    g_evaluationContext = m_previousContext;
+}
+
+const MDGContext& ScopedEvaluationTime::context()
+{
+    return *g_evaluationContext;
+}
+
+MObject plugAsMObject(const MPlug& plug, MStatus* status)
+{
+#if MAYA_API_VERSION >= 201800
+    MDGContextGuard contextGuard(ScopedEvaluationTime::context());
+    return plug.asMObject(status);
+#else
+    return plug.asMObject(ScopedEvaluationTime::context(), status);
+#endif
+}
+
+MMatrix worldMatrix(const MDagPath& path)
+{
+    MStatus status;
+    MFnDagNode dagNodeFn(path);
+    MPlug plug = dagNodeFn.findPlug("worldMatrix", /*wantNetworkedPlug=*/ false, &status);
+
+    if (status)
+    {
+        plug = plug.elementByLogicalIndex(path.instanceNumber(), &status);
+
+        if (status)
+        {
+            MFnMatrixData matrixDataFn(plugAsMObject(plug, &status));
+
+            if (status)
+                return matrixDataFn.matrix();
+        }
+    }
+
+    return path.inclusiveMatrix();
+}
@@ -40,15 +40,24 @@
 #include "appleseedmaya/_beginmayaheaders.h"
 #include <maya/MComputation.h>
 #include <maya/MDagPath.h>
+#include <maya/MDGContext.h>
+#include <maya/MMatrix.h>
 #include <maya/MObject.h>
+#include <maya/MPlug.h>
 #include <maya/MStatus.h>
 #include <maya/MString.h>
 #include "appleseedmaya/_endmayaheaders.h"
 
 // Standard headers.
+#include <algorithm>
+#include <atomic>
 #include <cstring>
+#include <exception>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <vector>
 
 //
 // MStringCompareLess
@@ -65,6 +74,36 @@ struct MStringCompareLess
     }
 };
 
+//
+// MStringHash, MStringEqual
+//
+//  Function object classes to use MStrings as keys in unordered containers.
+//
+
+struct MStringHash
+{
+    size_t operator()(const MString& s) const
+    {
+        // FNV-1a.
+        size_t h = static_cast<size_t>(14695981039346656037ULL);
+        for (const char* p = s.asChar(); *p; ++p)
+        {
+            h ^= static_cast<unsigned char>(*p);
+            h *= static_cast<size_t>(1099511628211ULL);
+        }
+
+        return h;
+    }
+};
+
+struct MStringEqual
+{
+    bool operator()(const MString& a, const MString& b) const
+    {
+        return strcmp(a.asChar(), b.asChar()) == 0;
+    }
+};
+
 //
 // AppleseedEntityPtr.
 //
@@ -225,6 +264,35 @@ class Computation
 
 typedef std::shared_ptr<Computation> ComputationPtr;
 
+//
+// Set the time used to evaluate plugs without changing the current time of the scene.
+//  Only the helpers below and code using ScopedEvaluationTime::context() honor it.
+//
+
+class ScopedEvaluationTime
+  : public foundation::NonCopyable
+{
+  public:
+    // Evaluate plugs at the given frame, in UI time units.
+    explicit ScopedEvaluationTime(const double frame);
+
+    // Destructor, restores the previous evaluation context.
+    ~ScopedEvaluationTime();
+
+    // Return the current evaluation context.
+    static const MDGContext& context();
+
+  private:
+    MDGContext          m_context;
+    const MDGContext*   m_previousContext;
+};
+
+// Return the value of a plug in the current evaluation context.
+MObject plugAsMObject(const MPlug& plug, MStatus* status = nullptr);
+
+// Return the world matrix of a dag path in the current evaluation context.
+MMatrix worldMatrix(const MDagPath& path);
+
 // Convert image coordinates from Y down to Y up.
 template <typename T>
 inline T flip_pixel_coordinate(const T size, const T x)
@@ -255,3 +323,71 @@ struct ArrayDeleter
     }
 };
 
+//
+// Call func(i) for every i in [0, count) using a pool of worker threads.
+//  If numThreads is 0, one thread per hardware core is used.
+//  The first exception thrown by func is rethrown in the calling thread.
+//  func must not call the Maya API.
+//
+
+template <typename Func>
+void parallelFor(const size_t count, Func func, size_t numThreads = 0)
+{
+    if (numThreads == 0)
+        numThreads = std::max(std::thread::hardware_concurrency(), 1u);
+
+    numThreads = std::min(numThreads, count);
+
+    if (numThreads <= 1)
+    {
+        for (size_t i = 0; i < count; ++i)
+            func(i);
+
+        return;
+    }
+
+    std::atomic<size_t> nextIndex(0);
+    std::exception_ptr exception;
+    std::mutex exceptionMutex;
+
+    auto worker = [&]()
+    {
+        while (true)
+        {
+            const size_t i = nextIndex++;
+
+            if (i >= count)
+                break;
+
+            try
+            {
+                func(i);
+            }
+            catch (...)
+            {
+                std::lock_guard<std::mutex> lock(exceptionMutex);
+
+                if (!exception)
+                    exception = std::current_exception();
+
+                // Skip the remaining work items.
+                nextIndex = count;
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+    threads.reserve(numThreads - 1);
+
+    for (size_t i = 1; i < numThreads; ++i)
+        threads.emplace_back(worker);
+
+    // The calling thread is also a worker.
+    worker();
+
+    for (auto& thread : threads)
+        thread.join();
+
+    if (exception)
+        std::rethrow_exception(exception);
+}
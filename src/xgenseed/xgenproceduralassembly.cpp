@@ -32,12 +32,17 @@
 // appleseed.renderer headers.
 #include "renderer/api/camera.h"
 #include "renderer/api/frame.h"
+#include "renderer/api/object.h"
 #include "renderer/api/project.h"
 #include "renderer/api/scene.h"
 
 // appleseed.foundation headers.
 #include "foundation/containers/dictionary.h"
+#include "foundation/math/beziercurve.h"
 #include "foundation/math/matrix.h"
+#include "foundation/math/transform.h"
+#include "foundation/math/vector.h"
+#include "foundation/platform/system.h"
 #include "foundation/string/string.h"
 #include "foundation/utility/api/specializedapiarrays.h"
 
@@ -49,9 +54,26 @@
 #include <XGen/XgRenderAPIUtils.h>
 
 // Standard headers.
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
 #include <cstring>
+#include <fstream>
+#include <functional>
 #include <memory>
+#include <mutex>
+#include <random>
 #include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
 
 namespace asf = foundation;
 namespace asr = renderer;
@@ -62,18 +84,586 @@ namespace
 {
     const char* Model = "xgen_patch_assembly";
 
+    //
+    // Primitives generated by XGen, stored as a structure of arrays.
+    //
+    // Faces are expanded in parallel, each thread filling its own buffer;
+    // the buffers are merged once all faces have been expanded.
+    //
+
+    struct XGenPrimitiveBuffer
+    {
+        // Splines.
+        std::vector<std::uint32_t>  m_spline_vertex_counts;
+        std::vector<float>          m_spline_points;        // 3 floats per vertex
+        std::vector<float>          m_spline_widths;        // 1 float per vertex
+
+        size_t spline_count() const
+        {
+            return m_spline_vertex_counts.size();
+        }
+
+        void append(const XGenPrimitiveBuffer& other)
+        {
+            append_array(m_spline_vertex_counts, other.m_spline_vertex_counts);
+            append_array(m_spline_points, other.m_spline_points);
+            append_array(m_spline_widths, other.m_spline_widths);
+        }
+
+        void write(std::ostream& os) const
+        {
+            write_array(os, m_spline_vertex_counts);
+            write_array(os, m_spline_points);
+            write_array(os, m_spline_widths);
+        }
+
+        bool read(std::istream& is)
+        {
+            return
+                read_array(is, m_spline_vertex_counts) &&
+                read_array(is, m_spline_points) &&
+                read_array(is, m_spline_widths) &&
+                is_consistent();
+        }
+
+        // Return true if the arrays sizes match the spline vertex counts.
+        bool is_consistent() const
+        {
+            std::uint64_t vertex_count = 0;
+
+            for (size_t i = 0, e = m_spline_vertex_counts.size(); i < e; ++i)
+            {
+                if (m_spline_vertex_counts[i] == 0)
+                    return false;
+
+                vertex_count += m_spline_vertex_counts[i];
+            }
+
+            return
+                m_spline_points.size() == 3 * vertex_count &&
+                m_spline_widths.size() == vertex_count;
+        }
+
+      private:
+        template <typename T>
+        static void append_array(std::vector<T>& dst, const std::vector<T>& src)
+        {
+            dst.insert(dst.end(), src.begin(), src.end());
+        }
+
+        template <typename T>
+        static void write_array(std::ostream& os, const std::vector<T>& array)
+        {
+            const std::uint64_t size = array.size();
+            os.write(reinterpret_cast<const char*>(&size), sizeof(size));
+
+            if (size != 0)
+                os.write(reinterpret_cast<const char*>(array.data()), size * sizeof(T));
+        }
+
+        template <typename T>
+        static bool read_array(std::istream& is, std::vector<T>& array)
+        {
+            std::uint64_t size;
+            is.read(reinterpret_cast<char*>(&size), sizeof(size));
+
+            if (!is)
+                return false;
+
+            // Reject sizes larger than the rest of the file before allocating.
+            const std::istream::pos_type pos = is.tellg();
+            is.seekg(0, std::ios::end);
+            const std::istream::pos_type end = is.tellg();
+            is.seekg(pos);
+
+            if (!is || size > static_cast<std::uint64_t>(end - pos) / sizeof(T))
+                return false;
+
+            array.resize(static_cast<size_t>(size));
+
+            if (size != 0)
+                is.read(reinterpret_cast<char*>(array.data()), size * sizeof(T));
+
+            return is.good();
+        }
+    };
+
+    //
+    // Conversion of XGen splines to appleseed curves.
+    //
+    // XGen splines are uniform cubic B-splines; each span of four control
+    // vertices is converted to a cubic Bezier curve. Curves are batched into
+    // curve objects of a fixed maximum size instead of one object per strand.
+    //
+
+    typedef asr::CurveObject::Curve3Type Curve3Type;
+
+    const size_t DefaultMaxCurvesPerObject = 250000;
+
+    template <typename T>
+    void bspline_to_bezier(const T& p0, const T& p1, const T& p2, const T& p3, T bezier[4])
+    {
+        bezier[0] = (p0 + 4.0f * p1 + p2) * (1.0f / 6.0f);
+        bezier[1] = (4.0f * p1 + 2.0f * p2) * (1.0f / 6.0f);
+        bezier[2] = (2.0f * p1 + 4.0f * p2) * (1.0f / 6.0f);
+        bezier[3] = (p1 + 4.0f * p2 + p3) * (1.0f / 6.0f);
+    }
+
+    // Return the number of Bezier curves a spline with the given vertex count converts to.
+    size_t spline_curve_count(const size_t vertex_count)
+    {
+        return vertex_count < 4 ? 1 : vertex_count - 3;
+    }
+
+    void push_spline_curves(
+        asr::CurveObject&       object,
+        const float*            points,
+        const float*            widths,
+        const size_t            vertex_count)
+    {
+        // Fetch a control vertex, clamping the index to the spline ends.
+        auto point = [&](const size_t i)
+        {
+            const float* p = points + 3 * std::min(i, vertex_count - 1);
+            return asr::GVector3(p[0], p[1], p[2]);
+        };
+
+        auto width = [&](const size_t i)
+        {
+            return widths[std::min(i, vertex_count - 1)];
+        };
+
+        if (vertex_count < 4)
+        {
+            // Too short to be a cubic B-spline, use a straight Bezier segment.
+            const asr::GVector3 p0 = point(0);
+            const asr::GVector3 p1 = point(vertex_count - 1);
+            const asr::GVector3 ctrl_pts[4] = { p0, p0 + (p1 - p0) * (1.0f / 3.0f), p0 + (p1 - p0) * (2.0f / 3.0f), p1 };
+            const float w0 = width(0);
+            const float w1 = width(vertex_count - 1);
+            const float ctrl_widths[4] = { w0, w0 + (w1 - w0) * (1.0f / 3.0f), w0 + (w1 - w0) * (2.0f / 3.0f), w1 };
+            object.push_curve3(Curve3Type(ctrl_pts, ctrl_widths));
+            return;
+        }
+
+        for (size_t i = 0; i + 3 < vertex_count; ++i)
+        {
+            asr::GVector3 ctrl_pts[4];
+            bspline_to_bezier(point(i), point(i + 1), point(i + 2), point(i + 3), ctrl_pts);
+
+            float ctrl_widths[4];
+            bspline_to_bezier(width(i), width(i + 1), width(i + 2), width(i + 3), ctrl_widths);
+
+            object.push_curve3(Curve3Type(ctrl_pts, ctrl_widths));
+        }
+    }
+
+    //
+    // On-disk cache of expanded primitives.
+    //
+    // Entries are keyed by the xgen arguments, which include the frame, and by
+    // the assembly parameters. When the xgen_static_groom parameter is set, the
+    // frame is left out of the key so that all frames share the same entry.
+    //
+
+    const char* ExpansionCacheMagic = "XGENSEEDCACHE1";
+
+    std::string remove_frame_argument(const std::string& xgen_args)
+    {
+        std::vector<std::string> tokens;
+        asf::tokenize(xgen_args, " \t", tokens);
+
+        std::string result;
+        for (size_t i = 0, e = tokens.size(); i < e; ++i)
+        {
+            if (tokens[i] == "-frame")
+            {
+                ++i;
+                continue;
+            }
+
+            result += tokens[i];
+            result += ' ';
+        }
+
+        return result;
+    }
+
+    std::string expansion_cache_key(
+        const std::string&      xgen_args,
+        const asr::ParamArray&  params)
+    {
+        std::string key =
+            params.get_optional<bool>("xgen_static_groom", false)
+                ? remove_frame_argument(xgen_args)
+                : xgen_args;
+
+        for (auto it = params.strings().begin(), e = params.strings().end(); it != e; ++it)
+        {
+            if (strcmp(it.key(), "xgen_args") == 0)
+                continue;
+
+            key += '\n';
+            key += it.key();
+            key += '=';
+            key += it.value();
+        }
+
+        return key;
+    }
+
+    void key_append(std::string& key, const double value)
+    {
+        std::stringstream ss;
+        ss << '\n' << value;
+        key += ss.str();
+    }
+
+    std::string expansion_cache_path(
+        const std::string&      cache_dir,
+        const std::string&      key)
+    {
+        std::stringstream ss;
+        ss << cache_dir << "/xgenseed_" << std::hex << std::hash<std::string>()(key) << ".cache";
+        return ss.str();
+    }
+
+    bool load_expansion_cache(
+        const std::string&      path,
+        const std::string&      key,
+        XGenPrimitiveBuffer&    buffer)
+    {
+        std::ifstream is(path.c_str(), std::ios::in | std::ios::binary);
+
+        if (!is)
+            return false;
+
+        // The full key is stored in the file to detect hash collisions.
+        std::string magic(strlen(ExpansionCacheMagic), '\0');
+        is.read(&magic[0], magic.size());
+
+        std::uint64_t key_size;
+        is.read(reinterpret_cast<char*>(&key_size), sizeof(key_size));
+
+        if (!is || magic != ExpansionCacheMagic || key_size != key.size())
+            return false;
+
+        std::string file_key(key.size(), '\0');
+        if (!file_key.empty())
+            is.read(&file_key[0], file_key.size());
+
+        if (!is || file_key != key)
+            return false;
+
+        return buffer.read(is);
+    }
+
+    void save_expansion_cache(
+        const std::string&          path,
+        const std::string&          key,
+        const XGenPrimitiveBuffer&  buffer)
+    {
+        // Write to a temporary file first, so that concurrent renders never
+        // read a partially written entry. The name is unique across processes.
+#ifdef _WIN32
+        const int pid = _getpid();
+#else
+        const int pid = static_cast<int>(getpid());
+#endif
+        std::random_device random;
+        std::stringstream tmp_path;
+        tmp_path << path << "." << pid << "." << std::hex << random() << random() << ".tmp";
+
+        {
+            std::ofstream os(tmp_path.str().c_str(), std::ios::out | std::ios::binary);
+
+            os.write(ExpansionCacheMagic, strlen(ExpansionCacheMagic));
+
+            const std::uint64_t key_size = key.size();
+            os.write(reinterpret_cast<const char*>(&key_size), sizeof(key_size));
+            os.write(key.data(), key.size());
+
+            buffer.write(os);
+            os.close();
+
+            if (!os)
+            {
+                RENDERER_LOG_WARNING("XGen procedural: could not write expansion cache %s", path.c_str());
+                std::remove(tmp_path.str().c_str());
+                return;
+            }
+        }
+
+        std::remove(path.c_str());
+        if (std::rename(tmp_path.str().c_str(), path.c_str()) != 0)
+            std::remove(tmp_path.str().c_str());
+    }
+
+    //
+    // Camera information used by XGen and by the level of detail code.
+    //
+
+    struct XGenCamera
+    {
+        explicit XGenCamera(const asr::Project& project)
+          : m_valid(false)
+          , m_perspective(false)
+          , m_transform(asf::Transformd::identity())
+          , m_resolution_x(0.0)
+          , m_aspect_ratio(1.0)
+          , m_horizontal_fov(54.0)
+          , m_tan_half_fov_x(0.0)
+          , m_tan_half_fov_y(0.0)
+        {
+            const asr::Frame* frame = project.get_frame();
+            const asr::Camera* camera =
+                frame != nullptr && project.get_scene() != nullptr
+                    ? project.get_scene()->cameras().get_by_name(frame->get_active_camera_name())
+                    : nullptr;
+
+            // Without a camera, level of detail is disabled.
+            if (camera == nullptr)
+                return;
+
+            m_valid = true;
+            m_perspective =
+                strcmp(camera->get_model(), "pinhole_camera") == 0 ||
+                strcmp(camera->get_model(), "thinlens_camera") == 0;
+
+            m_transform = camera->transform_sequence().get_earliest_transform();
+
+            const asf::CanvasProperties& props = frame->image().properties();
+            m_resolution_x = static_cast<double>(props.m_canvas_width);
+            m_aspect_ratio = static_cast<double>(props.m_canvas_width) / props.m_canvas_height;
+
+            const asr::ParamArray& params = camera->get_parameters();
+            double hfov = params.get_optional<double>("horizontal_fov", 0.0);
+
+            if (hfov <= 0.0)
+            {
+                const double focal_length = params.get_optional<double>("focal_length", 0.035);
+                const asf::Vector2d film_dims =
+                    params.get_optional<asf::Vector2d>("film_dimensions", asf::Vector2d(0.025, 0.025));
+                hfov = asf::rad_to_deg(2.0 * std::atan(film_dims[0] / (2.0 * focal_length)));
+            }
+
+            m_horizontal_fov = hfov;
+            m_tan_half_fov_x = std::tan(asf::deg_to_rad(hfov) * 0.5);
+            m_tan_half_fov_y = m_tan_half_fov_x / m_aspect_ratio;
+        }
+
+        bool                m_valid;            // false if the scene has no camera
+        bool                m_perspective;
+        asf::Transformd     m_transform;        // camera to world
+        double              m_resolution_x;     // in pixels
+        double              m_aspect_ratio;
+        double              m_horizontal_fov;   // in degrees
+        double              m_tan_half_fov_x;
+        double              m_tan_half_fov_y;
+    };
+
+    // Compose the transform sequences of the instances of an assembly and their parents.
+    asr::TransformSequence world_transform_sequence(const asr::Assembly& assembly)
+    {
+        const asr::Assembly* parent_assembly =
+            static_cast<const asr::Assembly*>(assembly.get_parent());
+
+        const asr::AssemblyInstance* assembly_instance = nullptr;
+        for (const auto& i : parent_assembly->assembly_instances())
+        {
+            if (strcmp(assembly.get_name(), i.get_assembly_name()) == 0)
+            {
+                assembly_instance = &i;
+                break;
+            }
+        }
+
+        assert(assembly_instance != nullptr);
+
+        asr::TransformSequence transform_sequence;
+
+        while (assembly_instance)
+        {
+            transform_sequence =
+                assembly_instance->transform_sequence() * transform_sequence;
+
+            assembly_instance = static_cast<const asr::AssemblyInstance*>(
+                assembly_instance->get_parent());
+        }
+
+        return transform_sequence;
+    }
+
+    //
+    // Camera based level of detail.
+    //
+    // Faces entirely outside of the view frustum are culled when the
+    // lod_frustum_culling parameter is set. When lod_full_density_pixels is
+    // positive, faces whose projected size is smaller than that many pixels
+    // only keep a fraction of their strands, proportional to their projected
+    // area. The kept strands are widened by the inverse of that fraction to
+    // preserve the coverage of the face, strand count times width. Widening
+    // is capped at MaxLodWidthScale so that strands don't turn into ribbons:
+    // below a fraction of 1 / MaxLodWidthScale faces lose some coverage.
+    //
+
+    const float MaxLodWidthScale = 10.0f;
+
+    class XGenLod
+    {
+      public:
+        XGenLod(
+            const XGenCamera&               camera,
+            const asr::ParamArray&          params,
+            const asf::Transformd&          object_transform)
+          : m_camera(camera)
+          , m_object_transform(object_transform)
+        {
+            m_frustum_culling = params.get_optional<bool>("lod_frustum_culling", false);
+            m_frustum_margin = params.get_optional<double>("lod_frustum_margin", 0.1);
+            m_full_density_pixels = params.get_optional<double>("lod_full_density_pixels", 0.0);
+            m_min_density = asf::clamp(params.get_optional<double>("lod_min_density", 0.01), 0.0, 1.0);
+
+            // Orthographic cameras are not supported, and
+            // strands are kept at full density without a camera.
+            if (!m_camera.m_valid || !m_camera.m_perspective)
+            {
+                m_frustum_culling = false;
+                m_full_density_pixels = 0.0;
+            }
+        }
+
+        bool enabled() const
+        {
+            return m_frustum_culling || m_full_density_pixels > 0.0;
+        }
+
+        // Return the fraction of strands to generate for a face, 0 if it is culled.
+        float face_density(const bbox& face_bbox) const
+        {
+            if (!enabled())
+                return 1.0f;
+
+            // Transform the corners of the face bounding box to camera space.
+            asf::Vector3d corners[8];
+            for (size_t i = 0; i < 8; ++i)
+            {
+                const asf::Vector3d p(
+                    (i & 1) ? face_bbox.xmax : face_bbox.xmin,
+                    (i & 2) ? face_bbox.ymax : face_bbox.ymin,
+                    (i & 4) ? face_bbox.zmax : face_bbox.zmin);
+
+                corners[i] = m_camera.m_transform.point_to_local(
+                    m_object_transform.point_to_parent(p));
+            }
+
+            if (m_frustum_culling && outside_frustum(corners))
+                return 0.0f;
+
+            if (m_full_density_pixels <= 0.0)
+                return 1.0f;
+
+            // Bounding sphere of the face in camera space.
+            asf::Vector3d center(0.0);
+            for (size_t i = 0; i < 8; ++i)
+                center += corners[i];
+            center /= 8.0;
+
+            const double radius = 0.5 * asf::norm(corners[7] - corners[0]);
+            const double depth = -center.z;
+
+            if (depth <= radius)
+                return 1.0f;
+
+            // Projected diameter in pixels.
+            const double pixels =
+                radius / (depth * m_camera.m_tan_half_fov_x) * m_camera.m_resolution_x;
+
+            const double ratio = pixels / m_full_density_pixels;
+            return static_cast<float>(asf::clamp(ratio * ratio, m_min_density, 1.0));
+        }
+
+      private:
+        const XGenCamera&   m_camera;
+        asf::Transformd     m_object_transform;
+        bool                m_frustum_culling;
+        double              m_frustum_margin;
+        double              m_full_density_pixels;
+        double              m_min_density;
+
+        bool outside_frustum(const asf::Vector3d corners[8]) const
+        {
+            // The camera looks down -Z. A box is outside if all
+            // its corners are on the outer side of a single plane.
+            const double tx = m_camera.m_tan_half_fov_x * (1.0 + m_frustum_margin);
+            const double ty = m_camera.m_tan_half_fov_y * (1.0 + m_frustum_margin);
+
+            bool behind = true, left = true, right = true, below = true, above = true;
+
+            for (size_t i = 0; i < 8; ++i)
+            {
+                const asf::Vector3d& p = corners[i];
+                const double depth = -p.z;
+
+                behind = behind && depth <= 0.0;
+                left = left && p.x < -depth * tx;
+                right = right && p.x > depth * tx;
+                below = below && p.y < -depth * ty;
+                above = above && p.y > depth * ty;
+            }
+
+            return behind || left || right || below || above;
+        }
+    };
+
+    // Map a strand to a uniformly distributed value in [0, 1), stable across renders.
+    float strand_random(const unsigned int face_id, const unsigned int strand_index)
+    {
+        std::uint64_t x = (static_cast<std::uint64_t>(face_id) << 32) | strand_index;
+        x ^= x >> 33;
+        x *= 0xff51afd7ed558ccdULL;
+        x ^= x >> 33;
+        x *= 0xc4ceb9fe1a85ec53ULL;
+        x ^= x >> 33;
+        return static_cast<float>(x >> 40) / static_cast<float>(1 << 24);
+    }
+
     class XGenCallbacks
       : public ProceduralCallbacks
     {
       public:
         XGenCallbacks(
-            const asr::Project& project,
-            asr::Assembly&      assembly)
+            const asr::Project&     project,
+            asr::Assembly&          assembly,
+            XGenPrimitiveBuffer&    primitives)
           : m_assembly(assembly)
           , m_params(assembly.get_parameters())
+          , m_primitives(primitives)
+          , m_transform_sequence(world_transform_sequence(assembly))
+          , m_face_id(0)
+          , m_face_density(1.0f)
+          , m_face_strand_index(0)
         {
             add_xgen_params(project);
-            compute_transform_sequence(assembly);
+
+            parse_float_array("DensityFalloff", m_density_falloff);
+            parse_float_array("LodHi", m_lod_hi);
+            parse_float_array("LodMed", m_lod_med);
+            parse_float_array("LodLow", m_lod_low);
+        }
+
+        const asr::TransformSequence& transform_sequence() const
+        {
+            return m_transform_sequence;
+        }
+
+        // Set the face the next flushed primitives belong to and
+        // the fraction of its strands to keep.
+        void begin_face(const unsigned int face_id, const float density)
+        {
+            m_face_id = face_id;
+            m_face_density = density;
+            m_face_strand_index = 0;
         }
 
         void flush(const char* in_geom, PrimitiveCache* in_cache) override
@@ -102,22 +692,65 @@ namespace
 
         void flush_splines(const char* in_geom, PrimitiveCache* in_cache)
         {
-            RENDERER_LOG_DEBUG("XGenCallbacks: flush_splines called");
+            const unsigned int num_samples = in_cache->get(PrimitiveCache::NumMotionSamples);
+            const unsigned int cache_count = in_cache->get(PrimitiveCache::CacheCount);
+            const float constant_width = in_cache->get(PrimitiveCache::ConstantWidth);
+            const float width_scale = std::min(1.0f / m_face_density, MaxLodWidthScale);
+
+            for (unsigned int i = 0; i < cache_count; ++i)
+            {
+                // Only the first motion sample is used for now.
+                const vec3* points = in_cache->get(PrimitiveCache::Points, i * num_samples);
+                const unsigned int num_points = in_cache->getSize2(PrimitiveCache::Points, i * num_samples);
+
+                const float* widths = in_cache->get(PrimitiveCache::Widths, i);
+                const unsigned int num_widths = in_cache->getSize2(PrimitiveCache::Widths, i);
+
+                // Pairs of (first vertex, vertex count) for each spline.
+                const int* infos = in_cache->get(PrimitiveCache::PrimitiveInfos, i);
+                const unsigned int num_splines = in_cache->getSize2(PrimitiveCache::PrimitiveInfos, i) / 2;
+
+                for (unsigned int j = 0; j < num_splines; ++j)
+                {
+                    const unsigned int first = static_cast<unsigned int>(infos[2 * j]);
+                    const unsigned int count = static_cast<unsigned int>(infos[2 * j + 1]);
+
+                    if (count < 2 || first + count > num_points)
+                        continue;
+
+                    // Level of detail: drop strands and widen the remaining ones.
+                    if (strand_random(m_face_id, m_face_strand_index++) >= m_face_density)
+                        continue;
+
+                    m_primitives.m_spline_vertex_counts.push_back(count);
+
+                    for (unsigned int k = first; k < first + count; ++k)
+                    {
+                        m_primitives.m_spline_points.push_back(points[k].x);
+                        m_primitives.m_spline_points.push_back(points[k].y);
+                        m_primitives.m_spline_points.push_back(points[k].z);
+                        m_primitives.m_spline_widths.push_back(
+                            width_scale * (k < num_widths ? widths[k] : constant_width));
+                    }
+                }
+            }
         }
 
+        // Cards, spheres and archives are not supported yet.
+
         void flush_cards(const char* in_geom, PrimitiveCache* in_cache)
         {
-            RENDERER_LOG_DEBUG("XGenCallbacks: flush_cards called");
+            RENDERER_LOG_DEBUG("XGenCallbacks: flush_cards called, card primitives are not supported");
         }
 
         void flush_spheres(const char* in_geom, PrimitiveCache* in_cache)
         {
-            RENDERER_LOG_DEBUG("XGenCallbacks: flush_spheres called");
+            RENDERER_LOG_DEBUG("XGenCallbacks: flush_spheres called, sphere primitives are not supported");
         }
 
         void flush_archives(const char* in_geom, PrimitiveCache* in_cache)
         {
-            RENDERER_LOG_DEBUG("XGenCallbacks: flush_archives called");
+            RENDERER_LOG_DEBUG("XGenCallbacks: flush_archives called, archive primitives are not supported");
         }
 
         void log(const char* in_str)  override
@@ -202,32 +835,14 @@ namespace
 
         const float* get(EFloatArrayAttribute attr) const override
         {
-            switch (attr)
-            {
-                case DensityFalloff:
-                case LodHi:
-                case LodLow:
-                case LodMed:
-                case Shutter:
-                    return nullptr;
-            }
-
-            return nullptr;
+            const std::vector<float>* array = get_float_array(attr);
+            return array && !array->empty() ? array->data() : nullptr;
         }
 
         unsigned int getSize(EFloatArrayAttribute attr) const override
         {
-            switch (attr)
-            {
-                case DensityFalloff:
-                case LodHi:
-                case LodLow:
-                case LodMed:
-                case Shutter:
-                    return 0;
-            }
-
-            return 0;
+            const std::vector<float>* array = get_float_array(attr);
+            return array ? static_cast<unsigned int>(array->size()) : 0;
         }
 
         const char* getOverride(const char* name) const override
@@ -258,7 +873,60 @@ namespace
       private:
         asr::Assembly&          m_assembly;
         asr::ParamArray         m_params;
+        XGenPrimitiveBuffer&    m_primitives;
         asr::TransformSequence  m_transform_sequence;
+        std::vector<float>      m_density_falloff;
+        std::vector<float>      m_lod_hi;
+        std::vector<float>      m_lod_med;
+        std::vector<float>      m_lod_low;
+        unsigned int            m_face_id;
+        float                   m_face_density;
+        unsigned int            m_face_strand_index;
+
+        const std::vector<float>* get_float_array(EFloatArrayAttribute attr) const
+        {
+            switch (attr)
+            {
+                case DensityFalloff:
+                    return &m_density_falloff;
+
+                case LodHi:
+                    return &m_lod_hi;
+
+                case LodLow:
+                    return &m_lod_low;
+
+                case LodMed:
+                    return &m_lod_med;
+
+                case Shutter:
+                    return nullptr;
+            }
+
+            return nullptr;
+        }
+
+        // Parse a comma or space separated list of floats from a parameter.
+        void parse_float_array(const char* key, std::vector<float>& array) const
+        {
+            if (!m_params.strings().exist(key))
+                return;
+
+            std::vector<std::string> tokens;
+            asf::tokenize(m_params.get(key), ", \t", tokens);
+
+            for (size_t i = 0, e = tokens.size(); i < e; ++i)
+            {
+                try
+                {
+                    array.push_back(asf::from_string<float>(tokens[i]));
+                }
+                catch (const asf::ExceptionStringConversionError&)
+                {
+                    RENDERER_LOG_WARNING("XGen procedural: invalid value %s in parameter %s", tokens[i].c_str(), key);
+                }
+            }
+        }
 
         const asr::ParamArray& get_parameters() const
         {
@@ -281,20 +949,10 @@ namespace
 
         void add_xgen_params(const asr::Project& project)
         {
-            // Fetch the camera.
-            const asr::Frame* frame = project.get_frame();
-            const asr::Camera *camera = project.get_scene()->cameras().get_by_name(
-                frame->get_active_camera_name());
-
-            bool camera_is_persp = false;
-            if (strcmp(camera->get_model(), "pinhole_camera") == 0)
-                camera_is_persp = true;
-            else if (strcmp(camera->get_model(), "thinlens_camera") == 0)
-                camera_is_persp = true;
-
-            // Get the camera transform.
-            const asf::Transformd& transform =
-                camera->transform_sequence().get_earliest_transform();
+            // Fetch the camera. Without one, XGen sees an orthographic camera at the origin.
+            const XGenCamera xgen_camera(project);
+            const bool camera_is_persp = xgen_camera.m_perspective;
+            const asf::Transformd& transform = xgen_camera.m_transform;
 
             if (!m_params.strings().exist("irRenderCam"))
             {
@@ -318,17 +976,13 @@ namespace
             if (!m_params.strings().exist("irRenderCamFOV"))
             {
                 if (camera_is_persp)
-                {
-                    m_params.insert_path("irRenderCamFOV", "54.0");
-                }
+                    m_params.insert_path("irRenderCamFOV", xgen_camera.m_horizontal_fov);
                 else
                     m_params.insert_path("irRenderCamFOV", "90.0");
             }
 
             if (!m_params.strings().exist("irRenderCamRatio"))
-            {
-                m_params.insert_path("irRenderCamRatio", "1.0");
-            }
+                m_params.insert_path("irRenderCamRatio", xgen_camera.m_aspect_ratio);
 
             if (!m_params.strings().exist("irRenderCamXform"))
             {
@@ -341,34 +995,6 @@ namespace
                 m_params.insert_path("irRenderCamXform", ss.str().c_str());
             }
         }
-
-        void compute_transform_sequence(const asr::Assembly& assembly)
-        {
-            const asr::Assembly* parent_assembly =
-                static_cast<const asr::Assembly*>(assembly.get_parent());
-
-            const asr::AssemblyInstance* assembly_instance = nullptr;
-            for (const auto& i : parent_assembly->assembly_instances())
-            {
-                if (strcmp(assembly.get_name(), i.get_assembly_name()) == 0)
-                {
-                    assembly_instance = &i;
-                    break;
-                }
-            }
-
-            assert(assembly_instance != nullptr);
-
-            // Compose all the transformation sequences.
-            while (assembly_instance)
-            {
-                m_transform_sequence =
-                    assembly_instance->transform_sequence() * m_transform_sequence;
-
-                assembly_instance = static_cast<const asr::AssemblyInstance*>(
-                    assembly_instance->get_parent());
-            }
-        }
     };
 
     class XGenPatchAssembly
@@ -407,7 +1033,160 @@ namespace
                 return false;
             }
 
-            XGenCallbacks xgen_callbacks(project, *this);
+            // Look for a previous expansion of the same groom.
+            const char* cache_dir = getenv("APPLESEED_XGEN_EXPANSION_CACHE");
+            std::string cache_key, cache_path;
+            bool loaded_from_cache = false;
+
+            if (cache_dir != nullptr && cache_dir[0] != '\0')
+            {
+                cache_key = expansion_cache_key(xgen_args, get_parameters());
+
+                // With level of detail, the expansion depends on the camera
+                // and on the placement of the groom, even for static grooms.
+                const XGenCamera camera(project);
+                const asf::Transformd object_transform =
+                    world_transform_sequence(*this).get_earliest_transform();
+
+                if (XGenLod(camera, get_parameters(), object_transform).enabled())
+                {
+                    const asf::Matrix4d& m = camera.m_transform.get_local_to_parent();
+                    for (size_t i = 0; i < 16; ++i)
+                        key_append(cache_key, m[i]);
+
+                    const asf::Matrix4d& o = object_transform.get_local_to_parent();
+                    for (size_t i = 0; i < 16; ++i)
+                        key_append(cache_key, o[i]);
+
+                    key_append(cache_key, camera.m_horizontal_fov);
+                    key_append(cache_key, camera.m_resolution_x);
+                }
+
+                cache_path = expansion_cache_path(cache_dir, cache_key);
+
+                loaded_from_cache = load_expansion_cache(cache_path, cache_key, m_primitives);
+
+                if (loaded_from_cache)
+                {
+                    RENDERER_LOG_DEBUG(
+                        "XGen procedural: loaded %s splines from expansion cache %s",
+                        asf::pretty_uint(m_primitives.spline_count()).c_str(),
+                        cache_path.c_str());
+                }
+                else
+                    m_primitives = XGenPrimitiveBuffer();
+            }
+
+            // An empty expansion is a valid cache entry too.
+            if (!loaded_from_cache)
+            {
+                if (!expand_faces(project, xgen_args, abort_switch))
+                    return false;
+
+                if (!cache_path.empty())
+                    save_expansion_cache(cache_path, cache_key, m_primitives);
+            }
+
+            create_curve_objects();
+
+            // The primitives now live in the curve objects.
+            m_primitives = XGenPrimitiveBuffer();
+
+            return true;
+        }
+
+      private:
+        XGenPrimitiveBuffer m_primitives;
+
+        void create_curve_objects()
+        {
+            const XGenPrimitiveBuffer& prims = m_primitives;
+            const size_t spline_count = prims.spline_count();
+
+            const size_t max_curves_per_object =
+                std::max<size_t>(
+                    get_parameters().get_optional<size_t>("max_curves_per_object", DefaultMaxCurvesPerObject),
+                    1);
+
+            const std::string material = get_parameters().get_optional<std::string>("material", "");
+
+            size_t spline_index = 0;
+            size_t vertex_index = 0;
+            size_t object_count = 0;
+            size_t curve_count = 0;
+
+            while (spline_index < spline_count)
+            {
+                // Find the splines of this chunk and count their curves.
+                const size_t first_spline = spline_index;
+                const size_t first_vertex = vertex_index;
+                size_t chunk_curve_count = 0;
+
+                while (spline_index < spline_count)
+                {
+                    const size_t n = spline_curve_count(prims.m_spline_vertex_counts[spline_index]);
+
+                    if (chunk_curve_count != 0 && chunk_curve_count + n > max_curves_per_object)
+                        break;
+
+                    chunk_curve_count += n;
+                    vertex_index += prims.m_spline_vertex_counts[spline_index];
+                    ++spline_index;
+                }
+
+                const std::string object_name = asf::format("xgen_curves_{0}", object_count++);
+
+                asf::auto_release_ptr<asr::CurveObject> object(
+                    asr::CurveObjectFactory().create(object_name.c_str(), asr::ParamArray()));
+                object->reserve_curves3(chunk_curve_count);
+
+                size_t v = first_vertex;
+                for (size_t i = first_spline; i < spline_index; ++i)
+                {
+                    const size_t n = prims.m_spline_vertex_counts[i];
+
+                    push_spline_curves(
+                        object.ref(),
+                        &prims.m_spline_points[3 * v],
+                        &prims.m_spline_widths[v],
+                        n);
+
+                    v += n;
+                }
+
+                objects().insert(asf::auto_release_ptr<asr::Object>(object.release()));
+
+                asf::StringDictionary materials;
+                if (!material.empty())
+                    materials.insert("default", material);
+
+                object_instances().insert(
+                    asr::ObjectInstanceFactory().create(
+                        (object_name + "_inst").c_str(),
+                        asr::ParamArray(),
+                        object_name.c_str(),
+                        asf::Transformd::identity(),
+                        materials,
+                        materials));
+
+                curve_count += chunk_curve_count;
+            }
+
+            RENDERER_LOG_DEBUG(
+                "XGen procedural: created %s curves in %s curve objects",
+                asf::pretty_uint(curve_count).c_str(),
+                asf::pretty_uint(object_count).c_str());
+        }
+
+        // Patch renderers are not thread safe: the faces are collected using one
+        // patch renderer and each thread expands its faces using its own.
+        bool expand_faces(
+            const asr::Project&     project,
+            const std::string&      xgen_args,
+            asf::IAbortSwitch*      abort_switch)
+        {
+            XGenPrimitiveBuffer patch_primitives;
+            XGenCallbacks xgen_callbacks(project, *this, patch_primitives);
             std::unique_ptr<PatchRenderer> patch_renderer(
                 PatchRenderer::init(&xgen_callbacks, xgen_args.c_str()));
 
@@ -417,31 +1196,133 @@ namespace
                 return false;
             }
 
+            // Collect the faces to expand, culling and computing the density of each.
+            const XGenCamera camera(project);
+            const XGenLod lod(
+                camera,
+                get_parameters(),
+                xgen_callbacks.transform_sequence().get_earliest_transform());
+
+            std::vector<unsigned int> face_ids;
+            std::vector<float> face_densities;
+            size_t culled_faces = 0;
             bbox bbox;
             unsigned int face_id;
-            bool success = true;
 
             while (patch_renderer->nextFace(bbox, face_id))
             {
                 if (isEmpty(bbox))
                     continue;
 
-                std::unique_ptr<FaceRenderer> face_renderer(FaceRenderer::init(
-                    patch_renderer.get(),
-                    face_id,
-                    &xgen_callbacks));
+                const float density = lod.face_density(bbox);
 
-                if (face_renderer)
+                if (density <= 0.0f)
                 {
-                    success = success && face_renderer->render();
+                    ++culled_faces;
+                    continue;
                 }
-                else
+
+                face_ids.push_back(face_id);
+                face_densities.push_back(density);
+            }
+
+            if (lod.enabled())
+            {
+                RENDERER_LOG_DEBUG(
+                    "XGen procedural: culled %s faces",
+                    asf::pretty_uint(culled_faces).c_str());
+            }
+
+            // Expand the faces using as many threads as appleseed renders with.
+            const size_t thread_count =
+                std::max<size_t>(
+                    std::min<size_t>(asf::System::get_logical_cpu_core_count(), face_ids.size()),
+                    1);
+
+            std::vector<XGenPrimitiveBuffer> thread_primitives(thread_count);
+            std::atomic<size_t> next_face(0);
+            std::atomic<bool> success(true);
+
+            auto worker = [&](const size_t thread_index)
+            {
+                XGenCallbacks thread_callbacks(project, *this, thread_primitives[thread_index]);
+
+                // The first thread reuses the patch renderer used to collect the faces.
+                std::unique_ptr<PatchRenderer> thread_patch_renderer;
+                PatchRenderer* thread_patch = patch_renderer.get();
+
+                if (thread_index != 0)
                 {
-                    RENDERER_LOG_ERROR("Error creating XGen face renderer");
-                    success = false;
+                    thread_patch_renderer.reset(
+                        PatchRenderer::init(&thread_callbacks, xgen_args.c_str()));
+                    thread_patch = thread_patch_renderer.get();
+
+                    if (thread_patch == nullptr)
+                    {
+                        RENDERER_LOG_ERROR("Error creating XGen patch renderer");
+                        success = false;
+                        return;
+                    }
                 }
+
+                while (true)
+                {
+                    if (abort_switch && abort_switch->is_aborted())
+                    {
+                        success = false;
+                        break;
+                    }
+
+                    const size_t i = next_face++;
+
+                    if (i >= face_ids.size())
+                        break;
+
+                    thread_callbacks.begin_face(face_ids[i], face_densities[i]);
+
+                    std::unique_ptr<FaceRenderer> face_renderer(FaceRenderer::init(
+                        thread_patch,
+                        face_ids[i],
+                        &thread_callbacks));
+
+                    if (face_renderer)
+                    {
+                        if (!face_renderer->render())
+                            success = false;
+                    }
+                    else
+                    {
+                        RENDERER_LOG_ERROR("Error creating XGen face renderer");
+                        success = false;
+                    }
+                }
+            };
+
+            std::vector<std::thread> threads;
+            for (size_t i = 1; i < thread_count; ++i)
+                threads.push_back(std::thread(worker, i));
+
+            worker(0);
+
+            for (size_t i = 0, e = threads.size(); i < e; ++i)
+                threads[i].join();
+
+            // Merge the per thread buffers.
+            m_primitives = XGenPrimitiveBuffer();
+            m_primitives.append(patch_primitives);
+
+            for (size_t i = 0; i < thread_count; ++i)
+            {
+                m_primitives.append(thread_primitives[i]);
+                thread_primitives[i] = XGenPrimitiveBuffer();
             }
 
+            RENDERER_LOG_DEBUG(
+                "XGen procedural: expanded %s faces into %s splines using %s threads",
+                asf::pretty_uint(face_ids.size()).c_str(),
+                asf::pretty_uint(m_primitives.spline_count()).c_str(),
+                asf::pretty_uint(thread_count).c_str());
+
             return success;
         }
     };
@@ -472,6 +1353,62 @@ namespace
         {
             asf::DictionaryArray metadata;
 
+            metadata.push_back(
+                asf::Dictionary()
+                    .insert("name", "lod_frustum_culling")
+                    .insert("label", "Frustum Culling")
+                    .insert("type", "boolean")
+                    .insert("use", "optional")
+                    .insert("default", "false"));
+
+            metadata.push_back(
+                asf::Dictionary()
+                    .insert("name", "lod_frustum_margin")
+                    .insert("label", "Frustum Margin")
+                    .insert("type", "numeric")
+                    .insert("min",
+                        asf::Dictionary()
+                            .insert("value", "0.0")
+                            .insert("type", "hard"))
+                    .insert("max",
+                        asf::Dictionary()
+                            .insert("value", "1.0")
+                            .insert("type", "soft"))
+                    .insert("use", "optional")
+                    .insert("default", "0.1"));
+
+            metadata.push_back(
+                asf::Dictionary()
+                    .insert("name", "lod_full_density_pixels")
+                    .insert("label", "Full Density Size In Pixels")
+                    .insert("type", "numeric")
+                    .insert("min",
+                        asf::Dictionary()
+                            .insert("value", "0.0")
+                            .insert("type", "hard"))
+                    .insert("max",
+                        asf::Dictionary()
+                            .insert("value", "100.0")
+                            .insert("type", "soft"))
+                    .insert("use", "optional")
+                    .insert("default", "0.0"));
+
+            metadata.push_back(
+                asf::Dictionary()
+                    .insert("name", "lod_min_density")
+                    .insert("label", "Minimum Density")
+                    .insert("type", "numeric")
+                    .insert("min",
+                        asf::Dictionary()
+                            .insert("value", "0.0")
+                            .insert("type", "hard"))
+                    .insert("max",
+                        asf::Dictionary()
+                            .insert("value", "1.0")
+                            .insert("type", "hard"))
+                    .insert("use", "optional")
+                    .insert("default", "0.01"));
+
             return metadata;
         }
 